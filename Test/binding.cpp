@@ -0,0 +1,106 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+struct Vertex
+{
+	float position[3];
+	int32_t id;
+};
+
+struct Mesh
+{
+	string name;
+	bool visible;
+	double scale;
+	vector<uint16_t> indices;
+	vector<string> tags;
+	Vertex pivot;
+	vector<Vertex> vertices;
+};
+
+JO_BINDING_BEGIN( Vertex )
+	JO_FIELD( position )
+	JO_FIELD( id )
+JO_BINDING_END()
+
+JO_BINDING_BEGIN( Mesh )
+	JO_FIELD( name )
+	JO_FIELD( visible )
+	JO_FIELD( scale )
+	JO_FIELD( indices )
+	JO_FIELD( tags )
+	JO_FIELD( pivot )
+	JO_FIELD( vertices )
+JO_BINDING_END()
+
+static bool Equal( const Vertex& _a, const Vertex& _b )
+{
+	return _a.position[0] == _b.position[0] && _a.position[1] == _b.position[1]
+		&& _a.position[2] == _b.position[2] && _a.id == _b.id;
+}
+
+static bool Equal( const Mesh& _a, const Mesh& _b )
+{
+	if( _a.name != _b.name || _a.visible != _b.visible || _a.scale != _b.scale
+		|| _a.indices != _b.indices || _a.tags != _b.tags || !Equal( _a.pivot, _b.pivot )
+		|| _a.vertices.size() != _b.vertices.size() )
+		return false;
+	for( size_t i=0; i<_a.vertices.size(); ++i )
+		if( !Equal( _a.vertices[i], _b.vertices[i] ) ) return false;
+	return true;
+}
+
+void TestBinding()
+{
+	typedef Jo::Files::MetaFileWrapper MFW;
+
+	Mesh mesh;
+	mesh.name = "Quad \"1\"";
+	mesh.visible = true;
+	mesh.scale = 0.1;
+	for( int i=0; i<3000; ++i ) mesh.indices.push_back( uint16_t(i * 7) );
+	mesh.tags.push_back( "static" );
+	mesh.tags.push_back( "" );
+	Vertex pivot = { { 0.5f, -1.0f, 1e-3f }, -1 };
+	mesh.pivot = pivot;
+	for( int i=0; i<4; ++i )
+	{
+		Vertex vertex = { { i * 0.25f, 1.0f / (i + 1), 3.0f }, i };
+		mesh.vertices.push_back( vertex );
+	}
+
+	Jo::Files::Format formats[2] = { Jo::Files::Format::SRAW, Jo::Files::Format::JSON };
+	for( int f=0; f<2; ++f )
+	{
+		Jo::Files::MemFile file;
+		Jo::Files::WriteStruct( file, formats[f], mesh, MFW::COMPRESS );
+		file.Seek( 0 );
+		Mesh read;
+		Jo::Files::ReadStruct( file, Jo::Files::Format::AUTO_DETECT, read );
+		assert( Equal( mesh, read ) );
+
+		// The same file through the generic wrapper
+		file.Seek( 0 );
+		const MFW wrapper( file );
+		assert( (string)wrapper[string("tags")][0] == "static" );
+		assert( (int32_t)wrapper[string("vertices")][3][string("id")] == 3 );
+	}
+
+	// Unknown nodes are skipped and numbers are converted
+	MFW wrapper;
+	wrapper[string("id")] = int8_t(42);
+	wrapper[string("extra")][string("x")] = 1.5;
+	auto& position = wrapper.RootNode.Add( string("position"), MFW::ElementType::DOUBLE, 3 );
+	for( int i=0; i<3; ++i ) position[i] = i + 0.5;
+	Jo::Files::MemFile file;
+	wrapper.Write( file, Jo::Files::Format::SRAW, MFW::CHILD_DIRECTORY );
+	file.Seek( 0 );
+	Vertex vertex;
+	Jo::Files::ReadStruct( file, Jo::Files::Format::SRAW, vertex );
+	Vertex expected = { { 0.5f, 1.5f, 2.5f }, 42 };
+	assert( Equal( vertex, expected ) );
+
+	std::cout << "Binding test OK\n";
+}
@@ -0,0 +1,88 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+void TestCbor()
+{
+	MFW wrapper;
+	auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 1000 );
+	for( int i=0; i<1000; ++i ) positions[i] = float(i) * 0.5f;
+	auto& counts = wrapper.RootNode.Add( string("counts"), MFW::ElementType::UINT8, 300 );
+	for( int i=0; i<300; ++i ) counts[i] = uint8_t(i);
+	auto& ids = wrapper.RootNode.Add( string("ids"), MFW::ElementType::UINT64, 50 );
+	for( int i=0; i<50; ++i ) ids[i] = uint64_t(i) << 40;
+	auto& names = wrapper.RootNode.Add( string("names"), MFW::ElementType::STRING, 3 );
+	names[0] = string("alpha"); names[2] = string("a longer name");
+	wrapper[string("settings")][string("steps")] = int32_t(-4);
+	wrapper[string("settings")][string("large")] = int64_t(-5000000000ll);
+	wrapper[string("settings")][string("scale")] = 0.25;
+	auto& flags = wrapper[string("settings")].Add( string("flags"), MFW::ElementType::BIT, 10 );
+	for( int i=0; i<10; ++i ) flags[i] = i % 3 == 0;
+	auto& meshes = wrapper.RootNode.Add( string("meshes"), MFW::ElementType::NODE, 2 );
+	meshes[0][string("name")] = string("cube");
+	meshes[1][string("name")] = string("plane");
+
+	// Typed arrays keep their types
+	Jo::Files::MemFile cbor;
+	wrapper.Write( cbor, Jo::Files::Format::CBOR );
+	const uint8_t* buffer = (const uint8_t*)cbor.GetBuffer();
+	assert( buffer[0] == 0xd9 );
+	assert( buffer[1] == 0xd9 );
+	assert( buffer[2] == 0xf7 );
+	cbor.Seek( 0 );
+	MFW read( cbor );
+	assert( read.RootNode.Equals( wrapper.RootNode ) );
+	assert( cbor.IsEof() );
+
+	// Large typed arrays are aligned and can be used in place
+	cbor.Seek( 0 );
+	const MFW mapped( cbor, Jo::Files::Format::CBOR, MFW::IN_PLACE );
+	const uint8_t* data = (const uint8_t*)mapped[string("positions")].GetData();
+	const uint8_t* idData = (const uint8_t*)mapped[string("ids")].GetData();
+	assert( data > buffer && data < buffer + cbor.GetSize() );
+	assert( idData > buffer && idData < buffer + cbor.GetSize() );
+	assert( mapped.RootNode.Equals( wrapper.RootNode ) );
+	cbor.Seek( 0 );
+	MFW patched( cbor, Jo::Files::Format::CBOR, MFW::WRITE_THROUGH );
+	patched[string("positions")][3] = -1.0f;
+	cbor.Seek( 0 );
+	MFW reread( cbor );
+	assert( patched[string("positions")].IsWrittenThrough() );
+	assert( (float)reread[string("positions")][3] == -1.0f );
+
+	// A document of an other encoder with big-endian and half precision
+	// typed arrays and indefinite lengths
+	const uint8_t foreign[] = { 0xbf,
+		0x61, 'a', 0xd8, 0x42, 0x48, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00,
+		0x61, 'h', 0x82, 0xf9, 0x3e, 0x00, 0xf9, 0xc0, 0x00,
+		0x61, 's', 0x7f, 0x62, 'a', 'b', 0x61, 'c', 0xff,
+		0x61, 'n', 0x9f, 0x01, 0x20, 0xff,
+		0x61, 'f', 0xd8, 0x54, 0x44, 0x00, 0x3c, 0x00, 0xc0,
+		0xff };
+	Jo::Files::MemFile foreignFile( foreign, sizeof(foreign) );
+	MFW other( foreignFile );
+	assert( other.RootNode.Size() == 5 );
+	assert( other[string("a")].GetType() == MFW::ElementType::UINT32 );
+	assert( (uint32_t)other[string("a")][1] == 256 );
+	assert( other[string("h")].GetType() == MFW::ElementType::FLOAT );
+	assert( (float)other[string("h")][0] == 1.5f );
+	assert( (float)other[string("h")][1] == -2.0f );
+	assert( (string)other[string("s")] == "abc" );
+	assert( other[string("n")].GetType() == MFW::ElementType::INT32 );
+	assert( (int32_t)other[string("n")][1] == -1 );
+	assert( other[string("f")].GetType() == MFW::ElementType::FLOAT );
+	assert( (float)other[string("f")][1] == -2.0f );
+
+	// Truncated documents are rejected
+	Jo::Files::MemFile truncated( foreign, sizeof(foreign) - 1 );
+	bool rejected = false;
+	try {
+		MFW broken( truncated, Jo::Files::Format::CBOR );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	std::cout << "CBOR test OK\n";
+}
@@ -0,0 +1,42 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+using namespace std;
+
+void TestCompression()
+{
+	typedef Jo::Files::MetaFileWrapper MFW;
+	typedef MFW::ElementType ET;
+
+	// A smooth field, increasing ids, a bit mask and a small array which
+	// stays uncompressed.
+	MFW wrapper;
+	auto& field = wrapper.RootNode.Add( string("Field"), ET::FLOAT, 20000 );
+	for( int i=0; i<20000; ++i ) field[i] = float(sin( i * 0.001 ));
+	auto& ids = wrapper[string("Mesh")].Add( string("Ids"), ET::INT64, 5000 );
+	for( int i=0; i<5000; ++i ) ids[i] = int64_t(1000000 + i * 3);
+	auto& mask = wrapper.RootNode.Add( string("Mask"), ET::BIT, 40000 );
+	for( int i=0; i<40000; ++i ) mask[i] = (i % 7) == 0;
+	auto& small = wrapper.RootNode.Add( string("Small"), ET::DOUBLE, 10 );
+	for( int i=0; i<10; ++i ) small[i] = i * 0.5;
+
+	Jo::Files::MemFile raw, compressed;
+	wrapper.Write( raw, Jo::Files::Format::SRAW );
+	wrapper.Write( compressed, Jo::Files::Format::SRAW, MFW::COMPRESS );
+	assert( compressed.GetSize() * 2 < raw.GetSize() );
+
+	MFW::ReadFlags readFlags[2] = { 0, MFW::LAZY };
+	for( int r=0; r<2; ++r )
+	{
+		compressed.Seek( 0 );
+		const MFW read( compressed, Jo::Files::Format::AUTO_DETECT, readFlags[r] );
+		assert( (float)read[string("Field")][12345] == float(sin( 12345 * 0.001 )) );
+		assert( (int64_t)read[string("Mesh")][string("Ids")][4999] == 1000000 + 4999 * 3 );
+		assert( (bool)read[string("Mask")][700] );
+		assert( !(bool)read[string("Mask")][701] );
+		assert( (double)read[string("Small")][9] == 4.5 );
+	}
+
+	std::cout << "Compression test OK\n";
+}
@@ -0,0 +1,103 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <type_traits>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+// 37 elements: no multiple of any vector width
+static const uint64_t NUM_ELEMENTS = 37;
+
+// Compare CopyTo() with static_casts for each start and count, so every
+// kernel runs with and without its scalar tail.
+template<typename S, typename D> static void CheckCopy( const MFW::Node& _node )
+{
+	MFW::Span<const S> source = _node.AsSpan<S>();
+	for( uint64_t first = 0; first < 5; ++first )
+		for( uint64_t count = 0; first + count <= NUM_ELEMENTS; ++count )
+		{
+			// One more element which must not be changed
+			vector<D> target( size_t(count + 1), D(99) );
+			_node.CopyTo( target.data(), first, count );
+			for( uint64_t i = 0; i < count; ++i )
+				assert( target[size_t(i)] == D(source[first + i]) );
+			assert( target[size_t(count)] == D(99) );
+		}
+}
+
+template<typename S> static MFW::Node& AddArray( MFW& _wrapper, const char* _name, MFW::ElementType _type )
+{
+	MFW::Node& node = _wrapper.RootNode.Add( string(_name), _type, NUM_ELEMENTS );
+	MFW::Span<S> span = node.AsSpan<S>();
+	// Negative, large unsigned and fractional values. Integers wrap around.
+	for( uint64_t i = 0; i < NUM_ELEMENTS; ++i )
+	{
+		double value = double(i) * 1237.25 - 20000.5;
+		span[i] = std::is_floating_point<S>::value ? S(value) : S(int64_t(value));
+	}
+	return node;
+}
+
+void TestConversion()
+{
+	MFW wrapper;
+	MFW::Node& i8 = AddArray<int8_t>( wrapper, "i8", MFW::ElementType::INT8 );
+	MFW::Node& u8 = AddArray<uint8_t>( wrapper, "u8", MFW::ElementType::UINT8 );
+	MFW::Node& i16 = AddArray<int16_t>( wrapper, "i16", MFW::ElementType::INT16 );
+	MFW::Node& u16 = AddArray<uint16_t>( wrapper, "u16", MFW::ElementType::UINT16 );
+	MFW::Node& i32 = AddArray<int32_t>( wrapper, "i32", MFW::ElementType::INT32 );
+	MFW::Node& f32 = AddArray<float>( wrapper, "f32", MFW::ElementType::FLOAT );
+	MFW::Node& f64 = AddArray<double>( wrapper, "f64", MFW::ElementType::DOUBLE );
+
+	// The vectorized conversions
+	CheckCopy<int8_t, float>( i8 );
+	CheckCopy<uint8_t, float>( u8 );
+	CheckCopy<int16_t, float>( i16 );
+	CheckCopy<uint16_t, float>( u16 );
+	CheckCopy<int16_t, int32_t>( i16 );
+	CheckCopy<uint16_t, int32_t>( u16 );
+	CheckCopy<uint16_t, uint32_t>( u16 );
+	CheckCopy<int32_t, float>( i32 );
+	CheckCopy<float, double>( f32 );
+	CheckCopy<double, float>( f64 );
+	// Generic ones and plain copies
+	CheckCopy<int8_t, int64_t>( i8 );
+	CheckCopy<int32_t, double>( i32 );
+	CheckCopy<float, float>( f32 );
+	CheckCopy<double, int32_t>( f64 );
+
+	// Spans require the exact type
+	const MFW::Node& constI16 = i16;
+	assert( constI16.AsSpan<int16_t>().size == NUM_ELEMENTS );
+	bool rejected = false;
+	try {
+		i16.AsSpan<uint16_t>();
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+	rejected = false;
+	try {
+		constI16.AsSpan<int32_t>();
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+	rejected = false;
+	try {
+		f32.AsSpan<double>();
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+	// Out of range copies and non-numeric targets fail
+	float target[2];
+	rejected = false;
+	try {
+		f32.CopyTo( target, NUM_ELEMENTS - 1, 2 );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+	rejected = false;
+	try {
+		f32.CopyTo( target, MFW::ElementType::STRING, 0, 1 );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	std::cout << "Conversion test OK\n";
+}
@@ -0,0 +1,111 @@
+// The converters of the tools are file-static
+#define JO_CONVERT_NO_MAIN
+#include "../Tools/convert.cpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef MetaFileWrapper MFW;
+
+// Converts with the streamed json2sraw and with MetaFileWrapper (--tree).
+// Returns the number of modes which rejected the document.
+static int ConvertBoth( const string& _json, MemFile& _streamed, MemFile& _tree )
+{
+	int rejected = 0;
+	try {
+		MemFile in( _json.data(), _json.size() );
+		Statistics stats = { 0, 0, 0 };
+		JsonToSraw( in, _streamed, 0, stats );
+	} catch( const string& ) { ++rejected; }
+	try {
+		MemFile in( _json.data(), _json.size() );
+		MFW wrapper( in, Format::JSON );
+		wrapper.Write( _tree, Format::SRAW );
+	} catch( const string& ) { ++rejected; }
+	return rejected;
+}
+
+static void AssertSameDocument( MemFile& _streamed, MemFile& _tree )
+{
+	_streamed.Seek( 0 );
+	_tree.Seek( 0 );
+	MFW a( _streamed, Format::SRAW );
+	MFW b( _tree, Format::SRAW );
+	assert( a.RootNode.Size() == b.RootNode.Size() );
+	for( uint64_t i=0; i<a.RootNode.Size(); ++i )
+	{
+		assert( a.RootNode[i].GetName() == b.RootNode[i].GetName() );
+		assert( a.RootNode[i].Equals( b.RootNode[i] ) );
+	}
+}
+
+void TestConvert()
+{
+	const string json = "{\"a\":[1,2,3],\"b\":[1,2.5],\"c\":[4000000000,1],\"d\":null,"
+		"\"e\":4000000000,\"f\":-7,\"g\":[{\"x\":1},null],\"h\":[],\"i\":[\"s\",\"t\"],"
+		"\"j\":[true,false,true],\"k\":\"text\",\"l\":{\"m\":1e3,\"n\":[[1,2],[0.5]]},\"o\":010}";
+	MemFile streamed, tree;
+	int rejected = ConvertBoth( json, streamed, tree );
+	assert( rejected == 0 );
+	AssertSameDocument( streamed, tree );
+
+	// Types after the round trip
+	tree.Seek( 0 );
+	MFW wrapper( tree, Format::SRAW );
+	const MFW::Node& root = wrapper.RootNode;
+	assert( root[string("a")].GetType() == ElementType::INT32 );
+	assert( root[string("b")].GetType() == ElementType::DOUBLE );
+	assert( (double)root[string("b")][0] == 1.0 );
+	assert( root[string("c")].GetType() == ElementType::INT64 );
+	assert( (int64_t)root[string("c")][0] == 4000000000ll );
+	assert( root[string("d")].GetType() == ElementType::NODE );
+	assert( root[string("d")].Size() == 0 );
+	assert( root[string("e")].GetType() == ElementType::INT64 );
+	assert( (int64_t)root[string("e")] == 4000000000ll );
+	assert( root[string("g")][1].GetType() == ElementType::NODE );
+	assert( root[string("g")][1].Size() == 0 );
+	assert( root[string("l")][string("m")].GetType() == ElementType::DOUBLE );
+	// Decimal, not octal
+	assert( (int)root[string("o")] == 10 );
+
+	// Back to JSON with the streamed sraw2json and again to SRAW. Both
+	// count the same.
+	MemFile streamedJson, again, againTree;
+	Statistics stats = { 0, 0, 0 }, counted = { 0, 0, 0 };
+	tree.Seek( 0 );
+	SrawToJson( tree, streamedJson, stats );
+	CountNodes( root, counted );
+	assert( stats.nodes == counted.nodes );
+	assert( stats.arrays == counted.arrays );
+	assert( stats.elements == counted.elements );
+	rejected = ConvertBoth( string((const char*)streamedJson.GetBuffer(), size_t(streamedJson.GetSize())), again, againTree );
+	assert( rejected == 0 );
+	// The unused bits of BIT arrays are 0, so the output is the same
+	assert( againTree.GetSize() == tree.GetSize() );
+	assert( memcmp( againTree.GetBuffer(), tree.GetBuffer(), size_t(tree.GetSize()) ) == 0 );
+
+	// Resizing a BIT array clears the bits behind the last element
+	MFW bitWrapper;
+	MFW::Node& flags = bitWrapper.RootNode.Add( string("flags"), ElementType::BIT, 16 );
+	for( int i=0; i<16; ++i ) flags[i] = true;
+	flags.Resize( 3 );
+	const uint8_t* bits = (const uint8_t*)((const MFW::Node&)flags).GetData();
+	assert( bits[0] == 0x07 );
+	flags.Resize( 12 );
+	bits = (const uint8_t*)((const MFW::Node&)flags).GetData();
+	assert( bits[0] == 0x07 );
+	assert( bits[1] == 0x00 );
+
+	// null is only allowed in arrays of objects or arrays. Both modes
+	// reject it.
+	const char* INVALID[] = { "{\"a\":[1,null,3]}", "{\"a\":[null]}", "{\"a\":[null,1]}",
+		"{\"a\":[true,null]}", "{\"a\":[\"s\",null]}" };
+	for( const char* invalid : INVALID )
+	{
+		MemFile invalidStreamed, invalidTree;
+		rejected = ConvertBoth( invalid, invalidStreamed, invalidTree );
+		assert( rejected == 2 );
+	}
+
+	cout << "Converter modes test OK\n";
+}
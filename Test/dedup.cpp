@@ -0,0 +1,148 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+typedef MFW::ElementType ET;
+
+struct MaterialParams
+{
+	double roughness;
+	vector<uint16_t> lut;
+};
+
+struct Material
+{
+	float color[3];
+	string name;
+	MaterialParams params;
+};
+
+struct Scene
+{
+	vector<Material> materials;
+};
+
+JO_BINDING_BEGIN( MaterialParams )
+	JO_FIELD( roughness )
+	JO_FIELD( lut )
+JO_BINDING_END()
+
+JO_BINDING_BEGIN( Material )
+	JO_FIELD( color )
+	JO_FIELD( name )
+	JO_FIELD( params )
+JO_BINDING_END()
+
+JO_BINDING_BEGIN( Scene )
+	JO_FIELD( materials )
+JO_BINDING_END()
+
+static void FillMaterial( MFW::Node& _material, float _red )
+{
+	auto& color = _material.Add( string("color"), ET::FLOAT, 3 );
+	color[0] = _red; color[1] = 0.5f; color[2] = 0.25f;
+	_material[string("name")] = string("steel");
+	_material[string("params")][string("roughness")] = 0.75;
+	auto& lut = _material[string("params")].Add( string("lut"), ET::UINT16, 256 );
+	for( int i=0; i<256; ++i ) lut[i] = uint16_t(i * 3);
+}
+
+static void CheckValues( const MFW& _wrapper )
+{
+	const MFW::Node& materials = _wrapper[string("materials")];
+	assert( materials.Size() == 100 );
+	assert( (float)materials[99][string("color")][0] == 1.0f );
+	assert( (float)materials[17][string("color")][0] == 0.0f );
+	assert( (string)materials[42][string("name")] == "steel" );
+	assert( (double)materials[3][string("params")][string("roughness")] == 0.75 );
+	assert( (uint16_t)materials[8][string("params")][string("lut")][255] == 765 );
+	assert( (double)_wrapper[string("left")][string("roughness")] == 0.75 );
+	assert( (double)_wrapper[string("right")][string("roughness")] == 0.75 );
+}
+
+void TestDeduplication()
+{
+	// 99 equal materials, one different and two equal nodes with
+	// different names
+	MFW wrapper;
+	auto& materials = wrapper.RootNode.Add( string("materials"), ET::NODE, 100 );
+	for( int i=0; i<100; ++i ) FillMaterial( materials[i], i == 99 ? 1.0f : 0.0f );
+	wrapper[string("left")][string("roughness")] = 0.75;
+	wrapper[string("right")][string("roughness")] = 0.75;
+	wrapper[string("left")].Add( string("lut"), ET::INT32, 20 );
+	wrapper[string("right")].Add( string("lut"), ET::INT32, 20 );
+
+	Jo::Files::MemFile plain, deduplicated;
+	wrapper.Write( plain, Jo::Files::Format::SRAW );
+	wrapper.Write( deduplicated, Jo::Files::Format::SRAW, MFW::DEDUPLICATE );
+	assert( deduplicated.GetSize() * 20 < plain.GetSize() );
+
+	{
+		// Equal subtrees with the same name are shared
+		deduplicated.Seek( 0 );
+		MFW shared( deduplicated );
+		CheckValues( shared );
+		MFW::Node& sharedMaterials = shared[string("materials")];
+		assert( &sharedMaterials[3] == &sharedMaterials[98] );
+		assert( sharedMaterials[3].IsReadOnly() );
+		assert( sharedMaterials[3][string("params")].IsReadOnly() );
+		assert( &sharedMaterials[99] != &sharedMaterials[98] );
+		assert( !sharedMaterials[99].IsReadOnly() );
+		assert( !sharedMaterials.IsReadOnly() );
+		assert( &shared[string("left")] != &shared[string("right")] );
+		assert( !shared[string("right")].IsReadOnly() );
+		bool rejected = false;
+		try {
+			sharedMaterials[5][string("color")][0] = 2.0f;
+		} catch( const std::string& ) { rejected = true; }
+		assert( rejected );
+		rejected = false;
+		try {
+			sharedMaterials[5][string("added")] = 1;
+		} catch( const std::string& ) { rejected = true; }
+		assert( rejected );
+		assert( (float)sharedMaterials[4][string("color")][0] == 0.0f );
+
+		// Writing the shared document gives the same file
+		Jo::Files::MemFile rewritten;
+		shared.Write( rewritten, Jo::Files::Format::SRAW, MFW::DEDUPLICATE );
+		assert( rewritten.GetSize() == deduplicated.GetSize() );
+		Jo::Files::MemFile expanded;
+		shared.Write( expanded, Jo::Files::Format::SRAW );
+		assert( expanded.GetSize() == plain.GetSize() );
+
+		// Parents can still remove shared children
+		sharedMaterials.Resize( 50 );
+		assert( sharedMaterials.Size() == 50 );
+	}
+
+	// Bound structs read references like the original blocks
+	Scene scene;
+	deduplicated.Seek( 0 );
+	Jo::Files::ReadStruct( deduplicated, Jo::Files::Format::SRAW, scene );
+	assert( scene.materials.size() == 100 );
+	assert( scene.materials[50].params.lut[255] == 765 );
+	assert( scene.materials[50].name == "steel" );
+	assert( scene.materials[99].color[0] == 1.0f );
+
+	// Other reads decode each reference into own nodes
+	MFW::WriteFlags flags[2] = { MFW::DEDUPLICATE, MFW::DEDUPLICATE | MFW::VARINT_SIZES | MFW::CHILD_DIRECTORY | MFW::COMPRESS };
+	for( int f=0; f<2; ++f )
+	{
+		Jo::Files::MemFile file;
+		wrapper.Write( file, Jo::Files::Format::SRAW, flags[f] );
+		file.Seek( 0 );
+		MFW lazy( file, Jo::Files::Format::SRAW, MFW::LAZY );
+		CheckValues( lazy );
+		assert( !lazy[string("materials")][5].IsReadOnly() );
+		lazy[string("materials")][5][string("color")][0] = 2.0f;
+		assert( (float)lazy[string("materials")][6][string("color")][0] == 0.0f );
+		file.Seek( 0 );
+		MFW read( file );
+		CheckValues( read );
+	}
+
+	std::cout << "Deduplication test OK\n";
+}
@@ -0,0 +1,78 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+typedef MFW::Difference::Kind Kind;
+
+static bool HasDifference( const std::vector<MFW::Difference>& _differences, Kind _kind, const std::string& _path )
+{
+	for( size_t i=0; i<_differences.size(); ++i )
+		if( _differences[i].kind == _kind && _differences[i].path == _path ) return true;
+	return false;
+}
+
+void TestDiff()
+{
+	Jo::Files::MemFile snapshot;
+	{
+		MFW wrapper;
+		auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 100000 );
+		for( int i=0; i<100000; ++i ) positions[i] = float(i);
+		wrapper[string("settings")][string("steps")] = int32_t(4);
+		wrapper[string("settings")][string("title")] = string("draft");
+		auto& meshes = wrapper.RootNode.Add( string("meshes"), MFW::ElementType::NODE, 2 );
+		meshes[0][string("name")] = string("cube");
+		meshes[1][string("name")] = string("plane");
+		wrapper.Write( snapshot, Jo::Files::Format::SRAW );
+	}
+
+	snapshot.Seek( 0 );
+	MFW original( snapshot );
+	snapshot.Seek( 0 );
+	MFW edited( snapshot, Jo::Files::Format::SRAW, MFW::LAZY );
+	assert( original.RootNode.Equals( edited.RootNode ) );
+	assert( original.Diff( edited ).empty() );
+
+	// Changes invalidate the cached hashes up to the root
+	uint64_t hash = edited.RootNode.GetHash();
+	uint64_t settingsHash = edited[string("settings")].GetHash();
+	edited[string("positions")][5] = -1.0f;
+	assert( edited.RootNode.GetHash() != hash );
+	assert( edited[string("settings")].GetHash() == settingsHash );
+	edited[string("positions")][5] = 5.0f;
+	assert( edited.RootNode.GetHash() == hash );
+
+	edited[string("settings")][string("steps")] = int32_t(8);
+	edited[string("meshes")][1][string("name")].SetName( string("label") );
+	edited[string("tools/~x")] = 1.5;
+	auto differences = original.Diff( edited );
+	assert( differences.size() == 3 );
+	assert( HasDifference( differences, Kind::CHANGED, "/settings/steps" ) );
+	assert( HasDifference( differences, Kind::RENAMED, "/meshes/1/label" ) );
+	assert( HasDifference( differences, Kind::ADDED, "/tools~1~0x" ) );
+	assert( differences[2].indices.size() == 1 );
+	assert( differences[2].indices[0] == 3 );
+
+	// A patch contains the changed subtrees only
+	Jo::Files::MemFile patch;
+	original.WritePatch( edited, patch );
+	assert( patch.GetSize() < 1000 );
+	original.ReplayJournal( patch );
+	assert( original.RootNode.Equals( edited.RootNode ) );
+	assert( original.Diff( edited ).empty() );
+
+	// The reverse patch removes children
+	snapshot.Seek( 0 );
+	MFW unchanged( snapshot );
+	Jo::Files::MemFile reverse;
+	edited.WritePatch( unchanged, reverse );
+	edited.ReplayJournal( reverse );
+	differences = original.Diff( edited );
+	assert( differences.size() == 3 );
+	assert( HasDifference( differences, Kind::REMOVED, "/tools~1~0x" ) );
+	assert( edited.RootNode.Size() == 3 );
+
+	std::cout << "Diff test OK\n";
+}
@@ -0,0 +1,74 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// Append an unsigned integer with _size bytes in big-endian order.
+static void PushBigEndian( vector<uint8_t>& _out, uint64_t _value, int _size )
+{
+	for( int i=_size-1; i>=0; --i )
+		_out.push_back( uint8_t(_value >> (i * 8)) );
+}
+
+static void PushName( vector<uint8_t>& _out, const char* _name )
+{
+	string name( _name );
+	_out.push_back( uint8_t(name.length()) );
+	_out.insert( _out.end(), name.begin(), name.end() );
+}
+
+void TestEndianness()
+{
+	// Build the file of a big-endian host by hand
+	vector<uint8_t> children;
+	// UINT32 "A" with 5 elements
+	children.push_back( 0x0c );
+	PushName( children, "A" );
+	PushBigEndian( children, 5, 1 );
+	for( int i=0; i<5; ++i ) PushBigEndian( children, 0x01020304 + i, 4 );
+	// INT16 "B" with 10 elements
+	children.push_back( 0x07 );
+	PushName( children, "B" );
+	PushBigEndian( children, 10, 1 );
+	for( int i=0; i<10; ++i ) PushBigEndian( children, uint16_t(-i * 300), 2 );
+	// DOUBLE "C" with 3 elements and 2 byte NELEMS
+	children.push_back( 0x1f );
+	PushName( children, "C" );
+	PushBigEndian( children, 3, 2 );
+	double values[3] = { 1.5, -2.25, 1e100 };
+	for( int i=0; i<3; ++i )
+	{
+		uint64_t bits;
+		memcpy( &bits, &values[i], 8 );
+		PushBigEndian( children, bits, 8 );
+	}
+	// STRING16 "S"
+	children.push_back( 0x02 );
+	PushName( children, "S" );
+	PushBigEndian( children, 1, 1 );
+	PushBigEndian( children, 2 + 3, 8 );
+	PushBigEndian( children, 3, 2 );
+	children.push_back( 'a' ); children.push_back( 'b' ); children.push_back( 'c' );
+
+	vector<uint8_t> data;
+	data.push_back( 'S' );
+	data.push_back( 2 );
+	data.push_back( uint8_t(Jo::Files::MetaFileWrapper::BIG_ENDIAN_FILE) );
+	data.push_back( 0x00 );
+	PushName( data, "Root" );
+	PushBigEndian( data, 4, 1 );
+	PushBigEndian( data, children.size(), 8 );
+	data.insert( data.end(), children.begin(), children.end() );
+
+	Jo::Files::MemFile file( data.data(), data.size() );
+	const Jo::Files::MetaFileWrapper wrapper( file );
+	assert( (uint32_t)wrapper[string("A")][4] == 0x01020308 );
+	assert( (int16_t)wrapper[string("B")][9] == -2700 );
+	assert( (double)wrapper[string("C")][1] == -2.25 );
+	assert( (double)wrapper[string("C")][2] == 1e100 );
+	assert( (string)wrapper[string("S")] == "abc" );
+
+	std::cout << "Endianness test OK\n";
+}
@@ -0,0 +1,83 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+static void CheckDocument( const Jo::Files::FrozenDocument& _document )
+{
+	assert( _document.Root().Size() == 5 );
+	auto positions = _document[string("positions")];
+	assert( positions.GetType() == MFW::ElementType::FLOAT );
+	assert( positions.Size() == 1000 );
+	assert( (float)positions[999] == 999.0f );
+	assert( positions.AsSpan<float>()[10] == 10.0f );
+	double converted[2];
+	positions.CopyTo( converted, 998, 2 );
+	assert( converted[0] == 998.0 );
+	assert( converted[1] == 999.0 );
+
+	auto meshes = _document[string("meshes")];
+	assert( meshes.Size() == 2 );
+	assert( (string)meshes[1][string("name")] == "plane" );
+	assert( meshes[0].GetName().empty() );
+	assert( meshes[0][string("name")].GetName() == "name" );
+	auto names = _document[string("names")];
+	assert( names.Size() == 3 );
+	assert( (string)names.GetStringView(0) == "" );
+	assert( (string)names[2] == "gamma" );
+
+	auto settings = _document[string("settings")];
+	assert( (int32_t)settings[string("steps")] == 4 );
+	assert( settings[string("steps")].Get(int64_t(0)) == 4 );
+	assert( settings[string("steps")].Get(0.5f) == 0.5f );
+	assert( (bool)settings[string("flags")][9] );
+	assert( !(bool)settings[string("flags")][8] );
+
+	// Missing children are UNKNOWN like in the wrapper
+	assert( _document[string("missing")].GetType() == MFW::ElementType::UNKNOWN );
+	assert( !settings.HasChild( string("positions") ) );
+	assert( _document[string("empty")].Size() == 0 );
+}
+
+void TestFrozenDocument()
+{
+	MFW wrapper;
+	auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 1000 );
+	for( int i=0; i<1000; ++i ) positions[i] = float(i);
+	auto& meshes = wrapper.RootNode.Add( string("meshes"), MFW::ElementType::NODE, 2 );
+	meshes[0][string("name")] = string("cube");
+	meshes[1][string("name")] = string("plane");
+	auto& names = wrapper.RootNode.Add( string("names"), MFW::ElementType::STRING, 3 );
+	names[1] = string("beta"); names[2] = string("gamma");
+	wrapper[string("settings")][string("steps")] = int32_t(4);
+	auto& flags = wrapper[string("settings")].Add( string("flags"), MFW::ElementType::BIT, 10 );
+	for( int i=0; i<10; ++i ) flags[i] = i == 9;
+	wrapper.RootNode.Add( string("empty"), MFW::ElementType::INT8, 0 );
+
+	auto frozen = wrapper.Freeze();
+	CheckDocument( *frozen );
+
+	// Writing and mapping back does not change the tape
+	Jo::Files::MemFile tape;
+	frozen->Write( tape );
+	assert( tape.GetSize() == frozen->GetSize() );
+	tape.Seek( 0 );
+	Jo::Files::FrozenDocument mapped( tape );
+	CheckDocument( mapped );
+	Jo::Files::MemFile rewritten;
+	mapped.Write( rewritten );
+	assert( memcmp( rewritten.GetBuffer(), tape.GetBuffer(), size_t(tape.GetSize()) ) == 0 );
+
+	// Corrupted tapes are rejected
+	Jo::Files::MemFile truncated( tape.GetBuffer(), tape.GetSize() - 8 );
+	bool rejected = false;
+	try {
+		Jo::Files::FrozenDocument broken( truncated );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	std::cout << "Frozen document test OK\n";
+}
@@ -0,0 +1,67 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+void TestIterators()
+{
+	MFW wrapper;
+	auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 1000 );
+	for( int i=0; i<1000; ++i ) positions[i] = float(i);
+	auto& flags = wrapper.RootNode.Add( string("flags"), MFW::ElementType::BIT, 20 );
+	for( int i=0; i<20; ++i ) flags[i] = i % 3 == 0;
+	auto& names = wrapper.RootNode.Add( string("names"), MFW::ElementType::STRING, 3 );
+	names[0] = string("alpha"); names[2] = string("gamma");
+	auto& meshes = wrapper.RootNode.Add( string("meshes"), MFW::ElementType::NODE, 2 );
+	meshes[0][string("name")] = string("cube");
+	meshes[1][string("name")] = string("plane");
+
+	// Children in order with their names, changeable through the entry
+	string order;
+	for( auto child : wrapper.RootNode.Children() )
+		order += child.name + ",";
+	assert( order == "positions,flags,names,meshes," );
+	int index = 0;
+	for( auto mesh : meshes.Children() )
+		mesh.node[string("index")] = index++;
+	assert( index == 2 );
+	assert( (int)meshes[1][string("index")] == 1 );
+	assert( meshes[0].GetName().empty() );
+
+	// Data nodes have no children
+	assert( positions.Children().begin() == positions.Children().end() );
+
+	// Typed elements
+	float sum = 0.0f;
+	for( float x : positions.AsSpan<float>() ) sum += x;
+	int numSet = 0, numBits = 0;
+	for( bool bit : flags.AsBits() ) { numSet += bit ? 1 : 0; ++numBits; }
+	string joined;
+	for( auto name : names.AsStrings() ) joined += string(name) + ";";
+	assert( sum == 499500.0f );
+	assert( numSet == 7 );
+	assert( numBits == 20 );
+	assert( joined == "alpha;;gamma;" );
+	bool rejected = false;
+	try {
+		positions.AsBits();
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	// Lazy children are decoded during the iteration
+	Jo::Files::MemFile file;
+	wrapper.Write( file, Jo::Files::Format::SRAW, MFW::CHILD_DIRECTORY );
+	file.Seek( 0 );
+	const MFW lazy( file, Jo::Files::Format::SRAW, MFW::LAZY );
+	uint64_t numChildren = 0;
+	for( auto child : lazy.RootNode.Children() )
+	{
+		assert( child.node.Equals( wrapper[child.name] ) );
+		++numChildren;
+	}
+	assert( numChildren == 4 );
+
+	std::cout << "Iterator test OK\n";
+}
@@ -0,0 +1,81 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+static bool EqualDocuments( const MFW& _a, const MFW& _b )
+{
+	Jo::Files::MemFile a, b;
+	_a.Write( a, Jo::Files::Format::SRAW );
+	_b.Write( b, Jo::Files::Format::SRAW );
+	return a.GetSize() == b.GetSize() && memcmp( a.GetBuffer(), b.GetBuffer(), size_t(a.GetSize()) ) == 0;
+}
+
+void TestJournal()
+{
+	// A snapshot with a large array and a few small nodes
+	Jo::Files::MemFile snapshot;
+	{
+		MFW wrapper;
+		auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 100000 );
+		for( int i=0; i<100000; ++i ) positions[i] = float(i);
+		wrapper[string("settings")][string("steps")] = int32_t(4);
+		wrapper[string("settings")][string("title")] = string("draft");
+		auto& meshes = wrapper.RootNode.Add( string("meshes"), MFW::ElementType::NODE, 2 );
+		meshes[0][string("name")] = string("cube");
+		meshes[1][string("name")] = string("plane");
+		wrapper.Write( snapshot, Jo::Files::Format::SRAW, MFW::CHILD_DIRECTORY );
+	}
+
+	snapshot.Seek( 0 );
+	MFW edited( snapshot, Jo::Files::Format::SRAW, MFW::LAZY );
+	assert( !edited[string("settings")].IsDirty() );
+
+	// First autosave: a changed value, a new child and a renamed node
+	Jo::Files::MemFile journal;
+	edited[string("settings")][string("steps")] = int32_t(8);
+	edited[string("settings")].Add( string("scale"), MFW::ElementType::DOUBLE, 2 )[1] = 0.5;
+	edited[string("meshes")][1][string("name")].SetName( string("label") );
+	assert( edited[string("settings")].IsDirty() );
+	assert( !edited[string("meshes")].IsDirty() );
+	edited.WriteJournal( journal );
+	assert( !edited[string("settings")].IsDirty() );
+	uint64_t firstSave = journal.GetSize();
+
+	// Second autosave: strings and removed children
+	edited[string("settings")][string("title")] = string("final");
+	edited[string("meshes")].Resize( 1 );
+	edited[string("meshes")][0][string("name")] = string("box");
+	edited.WriteJournal( journal );
+	// Small edits do not write the large array
+	assert( journal.GetSize() < 1000 );
+	assert( journal.GetSize() > firstSave );
+
+	snapshot.Seek( 0 );
+	MFW replayed( snapshot, Jo::Files::Format::SRAW, MFW::LAZY );
+	replayed.ReplayJournal( journal );
+	assert( EqualDocuments( edited, replayed ) );
+	assert( !replayed[string("settings")].IsDirty() );
+
+	// An interrupted save loses its last record only
+	Jo::Files::MemFile torn( journal.GetBuffer(), journal.GetSize() - 3 );
+	snapshot.Seek( 0 );
+	MFW recovered( snapshot );
+	recovered.ReplayJournal( torn );
+	assert( (string)recovered[string("settings")][string("title")] == "final" );
+	assert( (string)recovered[string("meshes")][0][string("name")] == "cube" );
+
+	// Compaction starts a new snapshot
+	Jo::Files::MemFile compacted;
+	edited[string("positions")][7] = -1.0f;
+	edited.Compact( compacted );
+	assert( !edited[string("positions")].IsDirty() );
+	compacted.Seek( 0 );
+	MFW reloaded( compacted );
+	assert( EqualDocuments( edited, reloaded ) );
+
+	std::cout << "Journal test OK\n";
+}
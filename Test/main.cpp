@@ -20,6 +20,28 @@ void TestPngLoad();
 void TestRndAccessHDDFile();
 void TestStreamReader();
 void TestUtilities();
+void TestConcurrentRead();
+void TestParallelRead();
+void TestSrawWriter();
+void TestCompression();
+void TestEndianness();
+void TestBinding();
+void TestMappedFile();
+void TestJournal();
+void TestSnapshot();
+void TestFrozenDocument();
+void TestNarrowing();
+void TestDeduplication();
+void TestDiff();
+void TestMsgpack();
+void TestCbor();
+void TestIterators();
+void TestSplice();
+void TestNames();
+void TestStrings();
+void TestConversion();
+void TestNodeSizes();
+void TestConvert();
 
 int main()
 {
@@ -130,6 +152,13 @@ int main()
 		std::cout << (string)Wrap3[string("ObjectArray")][0][string("Name")] << '\n';
 		std::cout << (bool)Wrap3[string("ObjectArray")][1][string("Extra")] << '\n';
 
+		// Untyped values (null, []) keep their place in sraw files
+		Jo::Files::MemFile sraw;
+		Wrap3.Write( sraw, Jo::Files::Format::SRAW );
+		sraw.Seek( 0 );
+		const Jo::Files::MetaFileWrapper Wrap4( sraw );
+		std::cout << (string)Wrap4[string("ObjectArray")][1][string("Name")] << '\n';
+
 	} catch( std::string e )
 	{
 		std::cout << e;
@@ -137,6 +166,28 @@ int main()
 
 	TestRndAccessHDDFile();
 	TestPngLoad();
+	TestConcurrentRead();
+	TestParallelRead();
+	TestSrawWriter();
+	TestCompression();
+	TestEndianness();
+	TestBinding();
+	TestMappedFile();
+	TestJournal();
+	TestSnapshot();
+	TestFrozenDocument();
+	TestNarrowing();
+	TestDeduplication();
+	TestDiff();
+	TestMsgpack();
+	TestCbor();
+	TestIterators();
+	TestSplice();
+	TestNames();
+	TestStrings();
+	TestConversion();
+	TestNodeSizes();
+	TestConvert();
 }
 
 
@@ -0,0 +1,82 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+void TestMappedFile()
+{
+	typedef Jo::Files::MetaFileWrapper MFW;
+
+	// Aligned arrays can be patched in the file
+	{
+		MFW wrapper;
+		auto& values = wrapper.RootNode.Add( string("values"), MFW::ElementType::FLOAT, 5000 );
+		for( int i=0; i<5000; ++i ) values[i] = float(i);
+		auto& flags = wrapper.RootNode.Add( string("flags"), MFW::ElementType::BIT, 100 );
+		for( int i=0; i<100; ++i ) flags[i] = false;
+		wrapper[string("iterations")] = int32_t(10);
+		wrapper[string("name")] = string("mesh");
+		Jo::Files::HDDFile file( "mapped.sraw", Jo::Files::HDDFile::OVERWRITE );
+		wrapper.Write( file, Jo::Files::Format::SRAW, MFW::ALIGN_16 );
+	}
+
+	{
+		Jo::Files::MappedFile file( "mapped.sraw", Jo::Files::MappedFile::WRITE );
+		MFW wrapper( file, Jo::Files::Format::SRAW, MFW::WRITE_THROUGH );
+		assert( wrapper[string("values")].IsWrittenThrough() );
+		assert( wrapper[string("flags")].IsWrittenThrough() );
+		assert( !wrapper[string("name")].IsWrittenThrough() );
+		wrapper[string("values")][4321] = 0.5f;
+		wrapper[string("flags")][17] = true;
+		wrapper[string("iterations")] = int32_t(250);
+		// Structural changes stay in the wrapper
+		wrapper[string("name")] = string("patched mesh");
+		wrapper[string("values")].Resize( 10 );
+		wrapper[string("values")][0] = 42.0f;
+		assert( !wrapper[string("values")].IsWrittenThrough() );
+		file.Flush();
+	}
+
+	{
+		Jo::Files::HDDFile file( "mapped.sraw" );
+		const MFW wrapper( file );
+		assert( (float)wrapper[string("values")][4321] == 0.5f );
+		assert( (float)wrapper[string("values")][0] == 0.0f );
+		assert( wrapper[string("values")].Size() == 5000 );
+		assert( (bool)wrapper[string("flags")][17] );
+		assert( !(bool)wrapper[string("flags")][16] );
+		assert( (int32_t)wrapper[string("iterations")] == 250 );
+		assert( (string)wrapper[string("name")] == "mesh" );
+	}
+
+	// An int32 assignment to a narrowed element writes the narrow element
+	// only. Values which do not fit are rejected before anything changes.
+	{
+		MFW wrapper;
+		wrapper[string("iterations")] = int32_t(10);
+		wrapper[string("name")] = string("mesh");
+		Jo::Files::HDDFile file( "mapped.sraw", Jo::Files::HDDFile::OVERWRITE );
+		wrapper.Write( file, Jo::Files::Format::SRAW, MFW::NARROW_INTEGERS );
+	}
+	{
+		Jo::Files::MappedFile file( "mapped.sraw", Jo::Files::MappedFile::WRITE );
+		MFW wrapper( file, Jo::Files::Format::SRAW, MFW::WRITE_THROUGH );
+		assert( wrapper[string("iterations")].GetType() == MFW::ElementType::INT8 );
+		assert( wrapper[string("iterations")].IsWrittenThrough() );
+		wrapper[string("iterations")] = int32_t(-100);
+		bool rejected = false;
+		try {
+			wrapper[string("iterations")] = int32_t(250);
+		} catch( const std::string& ) { rejected = true; }
+		assert( rejected );
+		file.Flush();
+	}
+	{
+		Jo::Files::HDDFile file( "mapped.sraw" );
+		const MFW wrapper( file );
+		assert( wrapper[string("iterations")].Get( int32_t(0) ) == -100 );
+		assert( (string)wrapper[string("name")] == "mesh" );
+	}
+
+	std::cout << "Mapped file test OK\n";
+}
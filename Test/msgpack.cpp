@@ -0,0 +1,78 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+void TestMsgpack()
+{
+	MFW wrapper;
+	auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 1000 );
+	for( int i=0; i<1000; ++i ) positions[i] = float(i) * 0.5f;
+	auto& counts = wrapper.RootNode.Add( string("counts"), MFW::ElementType::UINT8, 300 );
+	for( int i=0; i<300; ++i ) counts[i] = uint8_t(i);
+	auto& names = wrapper.RootNode.Add( string("names"), MFW::ElementType::STRING, 3 );
+	names[0] = string("alpha"); names[2] = string("a longer name which needs a str8 header");
+	wrapper[string("settings")][string("steps")] = int32_t(-4);
+	wrapper[string("settings")][string("large")] = int64_t(5000000000ll);
+	wrapper[string("settings")][string("scale")] = 0.25;
+	auto& flags = wrapper[string("settings")].Add( string("flags"), MFW::ElementType::BIT, 10 );
+	for( int i=0; i<10; ++i ) flags[i] = i % 3 == 0;
+	auto& meshes = wrapper.RootNode.Add( string("meshes"), MFW::ElementType::NODE, 2 );
+	meshes[0][string("name")] = string("cube");
+	meshes[1][string("name")] = string("plane");
+
+	Jo::Files::MemFile plain;
+	wrapper.Write( plain, Jo::Files::Format::MSGPACK );
+	plain.Seek( 0 );
+	MFW read( plain );
+	assert( read.RootNode.Size() == 5 );
+	assert( plain.IsEof() );
+	assert( read[string("positions")].GetType() == MFW::ElementType::FLOAT );
+	assert( read[string("positions")].Equals( positions ) );
+	// Plain arrays do not know the integer type
+	assert( read[string("counts")].GetType() == MFW::ElementType::INT32 );
+	assert( (int32_t)read[string("counts")][299] == 43 );
+	assert( read[string("names")].Equals( names ) );
+	assert( (int32_t)read[string("settings")][string("steps")] == -4 );
+	assert( (int64_t)read[string("settings")][string("large")] == 5000000000ll );
+	assert( (double)read[string("settings")][string("scale")] == 0.25 );
+	assert( read[string("settings")][string("flags")].Equals( flags ) );
+	assert( read[string("meshes")].Equals( meshes ) );
+
+	// Packed arrays keep their types and are smaller
+	Jo::Files::MemFile packed;
+	wrapper.Write( packed, Jo::Files::Format::MSGPACK, MFW::PACKED_ARRAYS );
+	packed.Seek( 0 );
+	MFW unpacked( packed, Jo::Files::Format::MSGPACK );
+	assert( unpacked.RootNode.Equals( wrapper.RootNode ) );
+	assert( packed.GetSize() < plain.GetSize() );
+
+	// A document of an other encoder with binary data, nil and mixed numbers
+	const uint8_t foreign[] = { 0x84,
+		0xa1, 'a', 0x92, 0x01, 0xcb, 0x40, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xa1, 'b', 0xc4, 0x03, 0x07, 0x08, 0x09,
+		0xa1, 'c', 0xc0,
+		0xa1, 'd', 0xdc, 0x00, 0x03, 0xc3, 0xc2, 0xc3 };
+	Jo::Files::MemFile foreignFile( foreign, sizeof(foreign) );
+	MFW other( foreignFile );
+	assert( other[string("a")].GetType() == MFW::ElementType::DOUBLE );
+	assert( (double)other[string("a")][1] == 2.5 );
+	assert( other[string("b")].GetType() == MFW::ElementType::UINT8 );
+	assert( (uint8_t)other[string("b")][2] == 9 );
+	assert( other[string("c")].GetType() == MFW::ElementType::UNKNOWN );
+	assert( other[string("d")].GetType() == MFW::ElementType::BIT );
+	assert( (bool)other[string("d")][2] );
+	assert( !(bool)other[string("d")][1] );
+
+	// Truncated documents are rejected
+	Jo::Files::MemFile truncated( foreign, sizeof(foreign) - 1 );
+	bool rejected = false;
+	try {
+		MFW broken( truncated, Jo::Files::Format::MSGPACK );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	std::cout << "MessagePack test OK\n";
+}
@@ -0,0 +1,60 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+void TestNames()
+{
+	MFW wrapper;
+	wrapper[string("alpha")] = 1;
+	wrapper[string("group")][string("alpha")] = 2;
+	MFW other;
+	other[string("beta")] = 3;
+
+	// Names of other wrappers are not known here and lookups do not add them
+	size_t numNames = wrapper.GetNumNames();
+	const MFW& constWrapper = wrapper;
+	const string& beta = other.RootNode[0].GetName();
+	assert( !wrapper.RootNode.HasChild( beta ) );
+	assert( constWrapper[beta].GetType() == MFW::ElementType::UNKNOWN );
+	assert( !constWrapper[string("group")].HasChild( beta ) );
+	assert( wrapper.GetNumNames() == numNames );
+	// Equal names share one entry
+	assert( &wrapper[string("alpha")].GetName() == &wrapper[string("group")][string("alpha")].GetName() );
+
+	// Renamed nodes are found by their new name only
+	MFW::Node* group = &wrapper[string("group")];
+	group->SetName( string("beta") );
+	assert( &wrapper[string("beta")] == group );
+	assert( !wrapper.RootNode.HasChild( string("group") ) );
+	assert( wrapper.RootNode.Size() == 2 );
+	assert( wrapper.GetNumNames() == numNames + 1 );
+	group->SetName( string("alpha") );
+	assert( &wrapper.RootNode[0] == &wrapper[string("alpha")] );
+	assert( wrapper.RootNode[1].GetName() == "alpha" );
+
+	// The readers intern each name once
+	const char json[] = "{\"a\":{\"x\":1,\"y\":[{\"x\":2},{\"x\":3}]},\"b\":{\"x\":4}}";
+	Jo::Files::MemFile jsonFile( json, sizeof(json) - 1 );
+	MFW parsed( jsonFile, Jo::Files::Format::JSON );
+	const MFW::Node& a = parsed[string("a")];
+	assert( parsed.GetNumNames() == 4 );
+	assert( &a[string("x")].GetName() == &parsed[string("b")][string("x")].GetName() );
+	assert( &a[string("y")][1][string("x")].GetName() == &a[string("x")].GetName() );
+	Jo::Files::MemFile sraw;
+	parsed.Write( sraw, Jo::Files::Format::SRAW );
+	for( int flags = 0; flags <= MFW::LAZY; flags += MFW::LAZY )
+	{
+		sraw.Seek( 0 );
+		MFW read( sraw, Jo::Files::Format::SRAW, flags );
+		MFW::Node& x = read[string("b")][string("x")];
+		assert( &read[string("a")][string("y")][0][string("x")].GetName() == &x.GetName() );
+		assert( &read[string("a")][string("x")].GetName() == &x.GetName() );
+		assert( read.GetNumNames() == 4 );
+		assert( read.RootNode.Equals( parsed.RootNode ) );
+	}
+
+	std::cout << "Name test OK\n";
+}
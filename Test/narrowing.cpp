@@ -0,0 +1,103 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+void TestNarrowing()
+{
+	typedef Jo::Files::MetaFileWrapper MFW;
+	typedef MFW::ElementType ET;
+
+	MFW wrapper;
+	auto& small = wrapper.RootNode.Add( string("Small"), ET::INT32, 201 );
+	for( int i=0; i<=200; ++i ) small[i] = int32_t(i);
+	auto& negative = wrapper[string("Mesh")].Add( string("Offsets"), ET::INT64, 5000 );
+	for( int i=0; i<5000; ++i ) negative[i] = int64_t(i % 300 - 150);
+	auto& large = wrapper[string("Mesh")].Add( string("Ids"), ET::UINT64, 3 );
+	large[0] = uint64_t(1); large[1] = uint64_t(70000); large[2] = uint64_t(5);
+	auto& wide = wrapper.RootNode.Add( string("Wide"), ET::INT64, 2 );
+	wide[0] = int64_t(-1); wide[1] = int64_t(0x7fffffffffffll);
+	auto& codes = wrapper.RootNode.Add( string("Codes"), ET::UINT16, 1000 );
+	for( int i=0; i<1000; ++i ) codes[i] = uint16_t(i % 256);
+	auto& signedCodes = wrapper.RootNode.Add( string("SignedCodes"), ET::INT32, 1000 );
+	for( int i=0; i<1000; ++i ) signedCodes[i] = int32_t(i % 201 - 100);
+	wrapper[string("Mesh")][string("Name")] = string("cube");
+
+	Jo::Files::MemFile raw, narrow;
+	wrapper.Write( raw, Jo::Files::Format::SRAW );
+	wrapper.Write( narrow, Jo::Files::Format::SRAW, MFW::NARROW_INTEGERS );
+	assert( narrow.GetSize() * 3 < raw.GetSize() );
+
+	// The reader sees the narrow types and the same values
+	narrow.Seek( 0 );
+	MFW read( narrow );
+	assert( read[string("Small")].GetType() == ET::UINT8 );
+	assert( read[string("Small")][200].Get( int32_t(0) ) == 200 );
+	assert( read[string("Mesh")][string("Offsets")].GetType() == ET::INT16 );
+	assert( (int16_t)read[string("Mesh")][string("Offsets")][4999] == 4999 % 300 - 150 );
+	assert( read[string("Mesh")][string("Ids")].GetType() == ET::UINT32 );
+	assert( (uint32_t)read[string("Mesh")][string("Ids")][1] == 70000 );
+	assert( read[string("Wide")].GetType() == ET::INT64 );
+	assert( read[string("Codes")].GetType() == ET::UINT8 );
+	assert( (uint8_t)read[string("Codes")][255] == 255 );
+	assert( read[string("SignedCodes")].GetType() == ET::INT8 );
+	assert( (int8_t)read[string("SignedCodes")][200] == 100 );
+
+	// Casts to the declared types convert the narrow elements
+	assert( (int32_t)read[string("Small")][200] == 200 );
+	assert( (int64_t)read[string("Mesh")][string("Offsets")][4999] == 4999 % 300 - 150 );
+	assert( (uint64_t)read[string("Mesh")][string("Ids")][1] == 70000 );
+	assert( (int32_t)read[string("SignedCodes")][0] == -100 );
+	assert( (double)read[string("SignedCodes")][0] == -100.0 );
+	assert( (int32_t)read[string("SignedCodes")].At( 200 ) == 100 );
+	// Assignments of the declared types are converted if they fit
+	read[string("Small")][3] = int32_t(250);
+	read[string("Mesh")][string("Offsets")][7] = int64_t(-3000);
+	read[string("SignedCodes")][5] = int32_t(-128);
+	assert( read[string("Small")].GetType() == ET::UINT8 );
+	assert( (int32_t)read[string("Small")][3] == 250 );
+	assert( (int32_t)read[string("Small")][4] == 4 );
+	assert( (int64_t)read[string("Mesh")][string("Offsets")][7] == -3000 );
+	assert( (int64_t)read[string("Mesh")][string("Offsets")][8] == 8 % 300 - 150 );
+	assert( (int32_t)read[string("SignedCodes")][5] == -128 );
+	bool rejected = false;
+	try {
+		read[string("Small")][3] = int32_t(-1);
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+	assert( (int32_t)read[string("Small")][3] == 250 );
+	rejected = false;
+	try {
+		read[string("SignedCodes")][5] = int32_t(1000);
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	// Variable length sizes with all other compatible options
+	MFW::WriteFlags flags[3] = { 0, MFW::COMPRESS, MFW::CHILD_DIRECTORY | MFW::NARROW_INTEGERS };
+	for( int f=0; f<3; ++f )
+	{
+		Jo::Files::MemFile fixed, varint;
+		wrapper.Write( fixed, Jo::Files::Format::SRAW, flags[f] );
+		wrapper.Write( varint, Jo::Files::Format::SRAW, flags[f] | MFW::VARINT_SIZES );
+		assert( varint.GetSize() < fixed.GetSize() );
+		MFW::ReadFlags readFlags[2] = { 0, MFW::LAZY };
+		for( int r=0; r<2; ++r )
+		{
+			varint.Seek( 0 );
+			const MFW reread( varint, Jo::Files::Format::AUTO_DETECT, readFlags[r] );
+			assert( reread[string("Mesh")][string("Offsets")][4000].Get( int64_t(0) ) == 4000 % 300 - 150 );
+			assert( (string)reread[string("Mesh")][string("Name")] == "cube" );
+			assert( reread[string("Wide")][1].Get( int64_t(0) ) == 0x7fffffffffffll );
+		}
+	}
+
+	// Alignment padding would depend on the sizes
+	rejected = false;
+	try {
+		Jo::Files::MemFile aligned;
+		wrapper.Write( aligned, Jo::Files::Format::SRAW, MFW::ALIGN_16 | MFW::VARINT_SIZES );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	std::cout << "Narrowing test OK\n";
+}
@@ -0,0 +1,68 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+// A chain of nested nodes. Each level has arrays and strings before the
+// next level and a string after it, so reading "after" requires the
+// SIZE of "next".
+static void AddLevel( MFW::Node& _node, int _depth )
+{
+	auto& values = _node.Add( string("values"), MFW::ElementType::FLOAT, _depth * 7 + 1 );
+	for( int i=0; i<_depth * 7 + 1; ++i ) values[i] = float(i * _depth);
+	auto& ids = _node.Add( string("ids"), MFW::ElementType::INT32, 1100 );
+	for( int i=0; i<1100; ++i ) ids[i] = i % (_depth + 2);
+	auto& names = _node.Add( string("names"), MFW::ElementType::STRING, _depth % 4 );
+	for( int i=0; i<_depth % 4; ++i ) names[i] = string( _depth + i, 'n' );
+	_node[string("flag")] = _depth % 2 == 0;
+	if( _depth > 1 ) AddLevel( _node[string("next")], _depth - 1 );
+	_node[string("after")] = std::to_string( _depth );
+}
+
+void TestNodeSizes()
+{
+	const int DEPTH = 50;
+	MFW wrapper;
+	AddLevel( wrapper.RootNode, DEPTH );
+
+	const MFW::WriteFlags FLAGS[] = { 0, MFW::CHILD_DIRECTORY, MFW::ALIGN_16, MFW::CHILD_DIRECTORY | MFW::ALIGN_64,
+		MFW::COMPRESS, MFW::VARINT_SIZES, MFW::VARINT_SIZES | MFW::CHILD_DIRECTORY };
+	for( MFW::WriteFlags flags : FLAGS )
+	{
+		Jo::Files::MemFile file;
+		wrapper.Write( file, Jo::Files::Format::SRAW, flags );
+
+		// The SIZE of the root block covers the rest of the file. Revision
+		// 2 files start with 3 bytes, the root header with CodeNType, the
+		// name and NELEMS.
+		if( !(flags & MFW::VARINT_SIZES) )
+		{
+			const uint8_t* bytes = (const uint8_t*)file.GetBuffer();
+			uint64_t header = flags ? 3 : 0;
+			uint64_t sizePosition = header + 2 + bytes[header + 1] + (1 << ((bytes[header] & 0x30) >> 4));
+			uint64_t rootSize;
+			memcpy( &rootSize, bytes + sizePosition, 8 );
+			assert( sizePosition + 8 + rootSize == file.GetSize() );
+		}
+
+		// A lazy reader skips all siblings by their SIZE. Start with the
+		// deepest node.
+		file.Seek( 0 );
+		MFW lazy( file, Jo::Files::Format::SRAW, MFW::LAZY );
+		const MFW::Node* node = &lazy.RootNode;
+		for( int i=1; i<DEPTH; ++i ) node = &(*node)[string("next")];
+		assert( (string)(*node)[string("after")] == "1" );
+		assert( (float)(*node)[string("values")][7] == 7.0f );
+		assert( lazy.RootNode.Equals( wrapper.RootNode ) );
+
+		file.Seek( 0 );
+		MFW eager( file );
+		assert( eager.RootNode.Equals( wrapper.RootNode ) );
+		assert( file.IsEof() );
+	}
+
+	std::cout << "Node size test OK\n";
+}
@@ -0,0 +1,59 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <atomic>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+void TestSnapshot()
+{
+	MFW wrapper;
+	auto& positions = wrapper.RootNode.Add( string("positions"), MFW::ElementType::FLOAT, 200000 );
+	for( int i=0; i<200000; ++i ) positions[i] = float(i);
+	auto& names = wrapper.RootNode.Add( string("names"), MFW::ElementType::STRING, 3 );
+	names[0] = string("alpha"); names[1] = string("beta"); names[2] = string("gamma");
+	wrapper[string("settings")][string("steps")] = int32_t(4);
+	wrapper[string("removed")][string("data")] = string("still in the file");
+
+	// The expected content is the state when the save starts
+	Jo::Files::MemFile expected;
+	wrapper.Write( expected, Jo::Files::Format::SRAW );
+
+	std::atomic<bool> completed( false );
+	Jo::Files::MemFile saved;
+	auto save = wrapper.SaveInBackground( saved, Jo::Files::Format::SRAW, 0,
+		[&completed]( const std::string& _error ) { completed = _error.empty(); } );
+
+	// Continue editing while the file is written
+	wrapper[string("positions")][17] = -1.0f;
+	wrapper[string("positions")].Resize( 10 );
+	wrapper[string("names")][1] = string("changed");
+	wrapper[string("settings")][string("steps")] = int32_t(8);
+	wrapper.RootNode.Resize( 3 );
+	wrapper[string("added")] = 1.5;
+
+	save->Wait();
+	assert( completed );
+	assert( save->IsDone() );
+	assert( save->GetError().empty() );
+	assert( save->GetProgress() == 1.0f );
+	assert( saved.GetSize() == expected.GetSize() );
+	assert( memcmp( saved.GetBuffer(), expected.GetBuffer(), size_t(expected.GetSize()) ) == 0 );
+	// The document kept its changes
+	assert( wrapper[string("positions")].Size() == 10 );
+	assert( (float)wrapper[string("positions")][9] == 9.0f );
+	assert( (string)wrapper[string("names")][1] == "changed" );
+	assert( (int32_t)wrapper[string("settings")][string("steps")] == 8 );
+
+	// A second save writes the edited document
+	Jo::Files::MemFile second;
+	wrapper.SaveInBackground( second, Jo::Files::Format::JSON )->Wait();
+	second.Seek( 0 );
+	MFW reloaded( second, Jo::Files::Format::JSON );
+	assert( (string)reloaded[string("names")][1] == "changed" );
+	assert( reloaded.RootNode.Size() == 4 );
+
+	std::cout << "Snapshot test OK\n";
+}
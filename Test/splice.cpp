@@ -0,0 +1,102 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+static void FillMesh( MFW::Node& _mesh, float _offset )
+{
+	auto& positions = _mesh.Add( string("positions"), MFW::ElementType::FLOAT, 1000 );
+	for( int i=0; i<1000; ++i ) positions[i] = float(i) + _offset;
+	auto& names = _mesh.Add( string("materials"), MFW::ElementType::STRING, 3 );
+	names[0] = string("stone"); names[2] = string("wood");
+	_mesh[string("scale")] = 0.5;
+}
+
+void TestSplice()
+{
+	// A snapshot with two meshes and a scene
+	Jo::Files::MemFile snapshot;
+	{
+		MFW wrapper;
+		FillMesh( wrapper[string("cube")], 0.0f );
+		FillMesh( wrapper[string("plane")], 1.0f );
+		wrapper[string("scene")][string("title")] = string("draft");
+		wrapper.Write( snapshot, Jo::Files::Format::SRAW, MFW::CHILD_DIRECTORY );
+	}
+
+	// Moves within a document keep the nodes and buffers
+	snapshot.Seek( 0 );
+	MFW edited( snapshot, Jo::Files::Format::SRAW, MFW::LAZY );
+	uint64_t planeHash = edited[string("plane")].GetHash();
+	uint64_t rootHash = edited.RootNode.GetHash();
+	MFW::Node* cube = &edited[string("cube")];
+	const void* positions = ((const MFW::Node&)(*cube)[string("positions")]).GetData();
+	MFW::Node& moved = edited[string("scene")].Splice( *cube );
+	assert( &moved == cube );
+	assert( edited.RootNode.Size() == 2 );
+	assert( edited[string("scene")].Size() == 2 );
+	assert( ((const MFW::Node&)moved[string("positions")]).GetData() == positions );
+	assert( edited[string("plane")].GetHash() == planeHash );
+	assert( edited.RootNode.GetHash() != rootHash );
+	edited[string("scene")].Splice( edited[string("plane")] );
+	assert( edited.RootNode.Size() == 1 );
+	assert( (float)edited[string("scene")][string("plane")][string("positions")][5] == 6.0f );
+
+	// A node cannot move into its own subtree
+	bool rejected = false;
+	try {
+		edited[string("scene")][string("cube")].Splice( edited[string("scene")] );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	// Journals replay the moves
+	Jo::Files::MemFile journal;
+	edited.WriteJournal( journal );
+	snapshot.Seek( 0 );
+	MFW replayed( snapshot, Jo::Files::Format::SRAW, MFW::LAZY );
+	replayed.ReplayJournal( journal );
+	assert( replayed.RootNode.Equals( edited.RootNode ) );
+
+	// Deep copies are equal but independent
+	MFW merged;
+	merged[string("copy")].CopyFrom( edited[string("scene")][string("cube")] );
+	assert( merged[string("copy")].Equals( edited[string("scene")][string("cube")] ) );
+	assert( merged[string("copy")][string("materials")].GetStringView( 2 ).length == 4 );
+	merged[string("copy")][string("positions")][0] = -1.0f;
+	assert( (float)edited[string("scene")][string("cube")][string("positions")][0] == 0.0f );
+	rejected = false;
+	try {
+		merged[string("copy")][string("positions")].CopyFrom( merged.RootNode );
+	} catch( const std::string& ) { rejected = true; }
+	assert( rejected );
+
+	// Moves between documents take the arrays over
+	uint64_t cubeHash = edited[string("scene")][string("cube")].GetHash();
+	MFW::Node& adopted = merged.RootNode.Splice( edited[string("scene")][string("cube")] );
+	assert( adopted.GetName() == "cube" );
+	assert( ((const MFW::Node&)adopted[string("positions")]).GetData() == positions );
+	assert( adopted.GetHash() == cubeHash );
+	assert( edited[string("scene")].Size() == 2 );
+	assert( merged.RootNode.Size() == 2 );
+
+	// Arrays which are used IN_PLACE are copied
+	Jo::Files::MemFile aligned;
+	replayed.Write( aligned, Jo::Files::Format::SRAW, MFW::ALIGN_16 );
+	aligned.Seek( 0 );
+	MFW mapped( aligned, Jo::Files::Format::SRAW, MFW::IN_PLACE );
+	const void* mappedPositions = ((const MFW::Node&)mapped[string("scene")][string("plane")][string("positions")]).GetData();
+	MFW::Node& plane = merged.RootNode.Splice( mapped[string("scene")][string("plane")] );
+	assert( ((const MFW::Node&)plane[string("positions")]).GetData() != mappedPositions );
+	assert( plane.Equals( replayed[string("scene")][string("plane")] ) );
+
+	// Roots of other documents leave an empty root behind
+	MFW& source = replayed;
+	MFW::Node& root = merged[string("all")].Splice( source.RootNode );
+	assert( source.RootNode.GetType() == MFW::ElementType::UNKNOWN );
+	assert( root.GetType() == MFW::ElementType::NODE );
+	assert( root.Size() == 1 );
+
+	std::cout << "Splice test OK\n";
+}
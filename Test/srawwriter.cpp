@@ -0,0 +1,40 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+void TestSrawWriter()
+{
+	typedef Jo::Files::MetaFileWrapper::ElementType ET;
+	Jo::Files::MemFile file;
+	{
+		Jo::Files::SrawWriter writer( file, Jo::Files::MetaFileWrapper::ALIGN_16 );
+		int32_t frames = 3;
+		writer.WriteArray( "NumFrames", ET::INT32, &frames, 1 );
+		writer.WriteString( "Name", "Simulation" );
+		for( int f=0; f<frames; ++f )
+		{
+			writer.BeginNode( "Frame" );
+			// Append the samples in chunks like a simulation would do
+			writer.BeginArray( "Samples", ET::FLOAT );
+			float chunk[100];
+			for( int c=0; c<10; ++c )
+			{
+				for( int i=0; i<100; ++i ) chunk[i] = float(f * 1000 + c * 100 + i);
+				writer.AppendArray( chunk, 100 );
+			}
+			writer.EndArray();
+			writer.EndNode();
+		}
+		writer.Finish();
+	}
+
+	file.Seek( 0 );
+	const Jo::Files::MetaFileWrapper wrapper( file );
+	assert( (int32_t)wrapper[string("NumFrames")] == 3 );
+	assert( (string)wrapper[string("Name")] == "Simulation" );
+	assert( wrapper.RootNode.Size() == 5 );
+	assert( wrapper.RootNode[4][string("Samples")].Size() == 1000 );
+	assert( (float)wrapper.RootNode[4][string("Samples")][999] == 2999.0f );
+	std::cout << "Streaming writer test OK\n";
+}
@@ -0,0 +1,83 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+typedef Jo::Files::MetaFileWrapper MFW;
+
+static bool HasStrings( const MFW::Node& _node, const string* _expected, uint64_t _num )
+{
+	if( _node.Size() != _num ) return false;
+	for( uint64_t i=0; i<_num; ++i )
+	{
+		MFW::StringView view = _node.GetStringView( i );
+		if( string(view.data, size_t(view.length)) != _expected[i] ) return false;
+	}
+	return true;
+}
+
+void TestStrings()
+{
+	MFW wrapper;
+	auto& names = wrapper.RootNode.Add( string("names"), MFW::ElementType::STRING, 3 );
+	names[0] = string("alpha"); names[1] = string("beta"); names[2] = string("gamma");
+
+	// Assignments in the middle shift the later strings
+	names[1] = string("a much longer second element");
+	string expected[6] = { "alpha", "a much longer second element", "gamma" };
+	assert( HasStrings( names, expected, 3 ) );
+	names[1] = string("b");
+	expected[1] = "b";
+	assert( HasStrings( names, expected, 3 ) );
+	names[0] = string();
+	expected[0] = "";
+	assert( HasStrings( names, expected, 3 ) );
+	assert( (string)names[2] == "gamma" );
+
+	// Many appended strings grow the character block several times
+	auto& many = wrapper.RootNode.Add( string("many"), MFW::ElementType::STRING, 0 );
+	for( int i=0; i<500; ++i )
+		many[i] = string( i % 37, char('a' + i % 26) );
+	many[250] = string( 1000, '!' );
+	for( int i=0; i<500; ++i )
+	{
+		assert( many.GetStringView( i ).length == uint64_t(i == 250 ? 1000 : i % 37) );
+		assert( i % 37 == 0 || many.GetStringView( i ).data[0] == (i == 250 ? '!' : char('a' + i % 26)) );
+	}
+
+	// Shrinking keeps the prefix, growing adds empty strings
+	names.Resize( 2 );
+	names.Resize( 5 );
+	names[4] = string("tail");
+	expected[2] = ""; expected[3] = ""; expected[4] = "tail";
+	assert( HasStrings( names, expected, 5 ) );
+
+	// SRAW and JSON round trips of all length prefix sizes
+	const uint64_t LENGTHS[3] = { 200, 300, 70000 };
+	const uint8_t SRAW_TYPES[3] = { 0x1, 0x2, 0x3 };
+	for( int i=0; i<3; ++i )
+	{
+		MFW document;
+		string values[4] = { string(size_t(LENGTHS[i]), 'x'), "", "with spaces", "" };
+		auto& node = document.RootNode.Add( string("values"), MFW::ElementType::STRING, 4 );
+		for( int j=0; j<4; ++j ) node[j] = values[j];
+
+		// The CodeNType precedes the name length and the name
+		Jo::Files::MemFile sraw;
+		document.Write( sraw, Jo::Files::Format::SRAW );
+		string bytes( (const char*)sraw.GetBuffer(), size_t(sraw.GetSize()) );
+		size_t header = bytes.find( "\x06values" );
+		assert( header != string::npos );
+		assert( (bytes[header - 1] & 0x0f) == SRAW_TYPES[i] );
+		sraw.Seek( 0 );
+		MFW fromSraw( sraw, Jo::Files::Format::SRAW );
+		Jo::Files::MemFile json;
+		fromSraw.Write( json, Jo::Files::Format::JSON );
+		json.Seek( 0 );
+		MFW fromJson( json, Jo::Files::Format::JSON );
+		assert( HasStrings( fromSraw[string("values")], values, 4 ) );
+		assert( HasStrings( fromJson[string("values")], values, 4 ) );
+	}
+
+	std::cout << "String test OK\n";
+}
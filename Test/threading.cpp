@@ -0,0 +1,116 @@
+#include "../include/jofilelib.hpp"
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+using namespace std;
+
+void TestConcurrentRead()
+{
+	// Build a document with arrays of different types and sizes
+	Jo::Files::MetaFileWrapper source;
+	auto& ints = source.RootNode.Add(string("Ints"), Jo::Files::MetaFileWrapper::ElementType::INT32, 1000);
+	auto& floats = source.RootNode.Add(string("Floats"), Jo::Files::MetaFileWrapper::ElementType::FLOAT, 3);
+	auto& bits = source.RootNode.Add(string("Bits"), Jo::Files::MetaFileWrapper::ElementType::BIT, 100);
+	auto& names = source.RootNode.Add(string("Names"), Jo::Files::MetaFileWrapper::ElementType::STRING, 0);
+	for( int i=0; i<1000; ++i ) ints[i] = i * 3;
+	for( int i=0; i<3; ++i ) floats[i] = i + 0.5f;
+	for( int i=0; i<100; ++i ) bits[i] = (i % 3) == 0;
+	for( int i=0; i<50; ++i ) names[i] = std::to_string(i);
+
+	Jo::Files::MemFile file;
+	source.Write( file, Jo::Files::Format::SRAW );
+	file.Seek( 0 );
+	// One shared read only document, decoded completely or on demand
+	const Jo::Files::MetaFileWrapper eager( file );
+	file.Seek( 0 );
+	const Jo::Files::MetaFileWrapper lazy( file, Jo::Files::Format::SRAW, Jo::Files::MetaFileWrapper::LAZY );
+	// Revision 2 with child directories and arrays used in place
+	Jo::Files::MemFile directoryFile;
+	source.Write( directoryFile, Jo::Files::Format::SRAW, Jo::Files::MetaFileWrapper::CHILD_DIRECTORY | Jo::Files::MetaFileWrapper::ALIGN_16 );
+	directoryFile.Seek( 0 );
+	const Jo::Files::MetaFileWrapper lazyDirectory( directoryFile, Jo::Files::Format::AUTO_DETECT, Jo::Files::MetaFileWrapper::LAZY | Jo::Files::MetaFileWrapper::IN_PLACE );
+
+	const Jo::Files::MetaFileWrapper* documents[] = { &eager, &lazy, &lazyDirectory };
+	for( int d=0; d<3; ++d )
+	{
+		const Jo::Files::MetaFileWrapper& shared = *documents[d];
+		std::vector<std::thread> threads;
+		for( int t=0; t<16; ++t )
+			threads.push_back( std::thread( [&shared, t]()
+			{
+				const auto& rInts = shared[string("Ints")];
+				const auto& rFloats = shared[string("Floats")];
+				const auto& rBits = shared[string("Bits")];
+				const auto& rNames = shared[string("Names")];
+				for( int k=0; k<20000; ++k )
+				{
+					int i = (k * 7 + t * 13) % 1000;
+					// Index operator + cast
+					assert( (int)rInts[i] == i * 3 );
+					assert( (float)rFloats[i%3] == (i%3) + 0.5f );
+					assert( (bool)rBits[i%100] == ((i%100) % 3 == 0) );
+					// Element references
+					assert( rInts.At(i).Get(int64_t(-1)) == i * 3 );
+					assert( (std::string)rNames.At(i%50) == std::to_string(i%50) );
+					// Name lookup
+					assert( shared.RootNode.HasChild(string("Names")) );
+				}
+			} ) );
+		for( auto& thread : threads )
+			thread.join();
+	}
+
+	// Constant index views: loops over one array reuse the latest view,
+	// other views stay valid and changes of the array are visible
+	const auto& cInts = eager[string("Ints")];
+	const auto& floatView = eager[string("Floats")][1];
+	const auto& view5 = cInts[5];
+	const auto& view6 = cInts[6];
+	assert( &view5 == &view6 );
+	assert( (int)view5 == 18 );
+	for( int i=0; i<1000; ++i )
+		assert( (int)cInts[i] == i * 3 );
+	assert( (float)floatView == 1.5f );
+	const auto& cSourceInts = ints;
+	assert( (int)cSourceInts[999] == 2997 );
+	ints.Resize( 5000 );
+	ints[4999] = 7;
+	assert( (int)cSourceInts[4999] == 7 );
+	assert( cSourceInts[4999].Size() == 5000 );
+
+	std::cout << "Concurrent read test OK\n";
+}
+
+void TestParallelRead()
+{
+	typedef Jo::Files::MetaFileWrapper MFW;
+	// Many large siblings with repeated names, one large array and a
+	// deep node which has to be split
+	MFW source;
+	auto& chunks = source.RootNode.Add( string("Chunks"), MFW::ElementType::NODE, 32 );
+	for( int c=0; c<32; ++c )
+	{
+		auto& chunk = chunks[c];
+		chunk[string("Id")] = c;
+		auto& values = chunk.Add( string("Values"), MFW::ElementType::DOUBLE, 20000 );
+		for( int i=0; i<20000; ++i ) values[i] = c * 100000.0 + i;
+	}
+	auto& large = source.RootNode.Add( string("Large"), MFW::ElementType::INT32, 100000 );
+	for( int i=0; i<100000; ++i ) large[i] = i;
+
+	Jo::Files::MemFile file;
+	source.Write( file, Jo::Files::Format::SRAW, MFW::ALIGN_16 );
+	file.Seek( 0 );
+	const MFW parallel( file, Jo::Files::Format::AUTO_DETECT, MFW::PARALLEL );
+
+	assert( parallel[string("Chunks")].Size() == 32 );
+	assert( (int)parallel[string("Large")][99999] == 99999 );
+	for( int c=0; c<32; ++c )
+	{
+		assert( (int)parallel[string("Chunks")][c][string("Id")] == c );
+		assert( (double)parallel[string("Chunks")][c][string("Values")][19999] == c * 100000.0 + 19999 );
+	}
+
+	std::cout << "Parallel read test OK\n";
+}
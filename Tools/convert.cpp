@@ -0,0 +1,418 @@
+/**************************************************************************//**
+ * \file	convert.cpp
+ * \brief	Command line converters between SRAW and JSON.
+ * \details	Built twice: as sraw2json and with JO_JSON2SRAW defined as
+ *			json2sraw. By default the documents are streamed: only the
+ *			array which is converted at the moment is kept in memory.
+ *			With --tree the input is read into a MetaFileWrapper and
+ *			written with MetaFileWrapper::Write, which makes the tool a
+ *			benchmark of the wrapper as well.
+ *
+ *			Afterwards the throughput, the peak memory and the number of
+ *			nodes, arrays and elements are printed.
+ *
+ *			With JO_CONVERT_NO_MAIN defined only the converters are compiled
+ *			(used by Test/convert.cpp).
+ *****************************************************************************/
+#include "../include/jofilelib.hpp"
+#include "../include/platform.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef JO_WINDOWS
+#	include <windows.h>
+#	include <psapi.h>
+#	pragma comment(lib, "psapi.lib")
+#else
+#	include <sys/resource.h>
+#endif
+
+using namespace Jo::Files;
+typedef MetaFileWrapper::ElementType ElementType;
+
+/// \brief What was converted.
+struct Statistics
+{
+	uint64_t nodes;
+	uint64_t arrays;
+	uint64_t elements;
+};
+
+// ************************************************************************* //
+static void WriteText( IFile& _file, const char* _text )
+{
+	_file.Write( _text, strlen(_text) );
+}
+
+static void WriteIndent( IFile& _file, int _indent )
+{
+	for( int i=0; i<_indent; ++i ) _file.Write( " ", 1 );
+}
+
+// ************************************************************************* //
+// SRAW -> JSON. The layout is the one of MetaFileWrapper::Node::SaveAsJson.
+static void BlockToJson( StructReader& _reader, StructWriter& _values, IFile& _out, const StructReader::Block& _block, int _indent, Statistics& _stats )
+{
+	WriteIndent( _out, _indent );
+	// Not for root node or unnamed nodes
+	if( _indent != 0 && !_block.name.empty() )
+	{
+		WriteText( _out, "\"" );
+		WriteText( _out, _block.name.c_str() );
+		WriteText( _out, "\": " );
+	}
+
+	if( _block.type == ElementType::NODE )
+	{
+		++_stats.nodes;
+		// Node arrays have unnamed children
+		StructReader::Block child;
+		bool nodeArray = true;
+		if( _block.numElements > 0 )
+		{
+			_reader.ReadHeader( child );
+			nodeArray = child.name.empty();
+		}
+		WriteText( _out, nodeArray ? "[\n" : "{\n" );
+		for( uint64_t i=0; i<_block.numElements; ++i )
+		{
+			if( i > 0 ) _reader.ReadHeader( child );
+			BlockToJson( _reader, _values, _out, child, _indent + 2, _stats );
+			_reader.Skip( child );
+			WriteText( _out, i+1 < _block.numElements ? ",\n" : "\n" );
+		}
+		WriteIndent( _out, _indent );
+		WriteText( _out, nodeArray ? "]" : "}" );
+		return;
+	}
+
+	++_stats.arrays;
+	_stats.elements += _block.numElements;
+	bool isArray = _block.name.empty() || _block.numElements != 1;
+	if( _block.type == ElementType::STRING )
+	{
+		std::vector<std::string> strings;
+		_reader.ReadStrings( _block, strings );
+		_values.JsonStrings( strings.data(), strings.size(), isArray );
+	} else if( _block.type == ElementType::BIT ) {
+		std::vector<uint8_t> bits( size_t(MetaFileWrapper::ArraySize( _block.numElements, ElementType::BIT )) );
+		_reader.ReadElements( _block, ElementType::BIT, bits.data(), _block.numElements );
+		if( isArray ) WriteText( _out, "[" );
+		for( uint64_t i=0; i<_block.numElements; ++i )
+		{
+			_values.JsonBool( (bits[size_t(i/8)] & (1 << (i & 7))) != 0 );
+			if( i+1 < _block.numElements ) WriteText( _out, ", " );
+		}
+		if( isArray ) WriteText( _out, "]" );
+	} else {
+		std::vector<uint8_t> data( size_t(MetaFileWrapper::ArraySize( _block.numElements, _block.type )) );
+		_reader.ReadElements( _block, _block.type, data.data(), _block.numElements );
+		_values.JsonNumbers( _block.type, data.data(), _block.numElements, isArray );
+	}
+}
+
+// ************************************************************************* //
+static void SrawToJson( const IFile& _in, IFile& _out, Statistics& _stats )
+{
+	StructReader reader( _in, Format::SRAW );
+	StructWriter values( _out, Format::JSON, 0 );
+	StructReader::Block root;
+	reader.ReadHeader( root );
+	BlockToJson( reader, values, _out, root, 0, _stats );
+}
+
+// ************************************************************************* //
+// JSON -> SRAW. Values are converted like MetaFileWrapper does: integers
+// become INT32 (INT64 if necessary), other numbers DOUBLE. null becomes an
+// empty node and is not allowed in arrays of values.
+static bool IsFloat( const std::string& _number )
+{
+	return _number.find_first_of( ".eE" ) != std::string::npos;
+}
+
+static void JsonValueToSraw( StructReader& _reader, SrawWriter& _writer, const std::string& _name, char _first, Statistics& _stats );
+
+// A null element would silently become a default value.
+static void RejectNull( char _first )
+{
+	if( _first == 'n' ) throw std::string("[json2sraw] null is only allowed in arrays of objects or arrays.");
+}
+
+// Members of an object whose { was consumed.
+static void JsonMembersToSraw( StructReader& _reader, SrawWriter& _writer, Statistics& _stats )
+{
+	char charBuffer = _reader.NextToken();
+	while( charBuffer != '}' )
+	{
+		if( charBuffer != '"' ) throw std::string("Syntax error in json file. Expected \"");
+		std::string name = _reader.ReadJsonString();
+		if( _reader.NextToken() != ':' ) throw std::string("Syntax error in json file. Expected :");
+		JsonValueToSraw( _reader, _writer, name, _reader.NextToken(), _stats );
+		charBuffer = _reader.NextToken();
+		if( charBuffer == ',' ) charBuffer = _reader.NextToken();
+		else if( charBuffer != '}' ) throw std::string("Syntax error in json file. Object must end with }");
+	}
+}
+
+// One array is collected at a time because its type is known at the end.
+static void JsonArrayToSraw( StructReader& _reader, SrawWriter& _writer, const std::string& _name, Statistics& _stats )
+{
+	char c = _reader.BeginJsonArray( '[' );
+	if( c == ']' || c == '{' || c == '[' )
+	{
+		// Arrays of objects or arrays (and empty arrays) are nodes
+		++_stats.nodes;
+		_writer.BeginNode( _name );
+		for( ; c != ']'; c = _reader.NextJsonElement() )
+			JsonValueToSraw( _reader, _writer, "", c, _stats );
+		_writer.EndNode();
+		return;
+	}
+
+	++_stats.arrays;
+	if( c == '"' )
+	{
+		std::vector<std::string> strings;
+		for( ; c != ']'; c = _reader.NextJsonElement() )
+		{
+			RejectNull( c );
+			if( c != '"' ) throw std::string("[json2sraw] Arrays must have the same type everywhere!");
+			strings.push_back( _reader.ReadJsonString() );
+		}
+		_stats.elements += strings.size();
+		_writer.WriteStrings( _name, strings.data(), strings.size() );
+	} else if( c == 't' || c == 'f' ) {
+		std::vector<uint8_t> bits;
+		uint64_t num = 0;
+		for( ; c != ']'; c = _reader.NextJsonElement(), ++num )
+		{
+			RejectNull( c );
+			if( (num & 7) == 0 ) bits.push_back( 0 );
+			if( _reader.ReadJsonBool( c ) ) bits.back() |= uint8_t(1 << (num & 7));
+		}
+		_stats.elements += num;
+		_writer.WriteArray( _name, ElementType::BIT, bits.data(), num );
+	} else {
+		std::vector<int64_t> integers;
+		std::vector<double> floats;
+		bool isFloat = false;
+		for( ; c != ']'; c = _reader.NextJsonElement() )
+		{
+			RejectNull( c );
+			if( (c < '0' || c > '9') && c != '-' ) throw std::string("[json2sraw] Arrays must have the same type everywhere!");
+			std::string number = _reader.ReadJsonToken( c );
+			if( !isFloat && IsFloat( number ) )
+			{
+				// Switch to DOUBLE for all elements
+				isFloat = true;
+				floats.assign( integers.begin(), integers.end() );
+				std::vector<int64_t>().swap( integers );
+			}
+			if( isFloat ) floats.push_back( atof( number.c_str() ) );
+			else integers.push_back( strtoll( number.c_str(), nullptr, 10 ) );
+		}
+		if( isFloat )
+		{
+			_stats.elements += floats.size();
+			_writer.WriteArray( _name, ElementType::DOUBLE, floats.data(), floats.size() );
+		} else {
+			_stats.elements += integers.size();
+			bool fits = true;
+			for( size_t i=0; i<integers.size() && fits; ++i )
+				fits = integers[i] == int32_t(integers[i]);
+			if( fits ) {
+				std::vector<int32_t> narrow( integers.begin(), integers.end() );
+				_writer.WriteArray( _name, ElementType::INT32, narrow.data(), narrow.size() );
+			} else _writer.WriteArray( _name, ElementType::INT64, integers.data(), integers.size() );
+		}
+	}
+}
+
+static void JsonValueToSraw( StructReader& _reader, SrawWriter& _writer, const std::string& _name, char _first, Statistics& _stats )
+{
+	switch( _first )
+	{
+	case '{':
+		++_stats.nodes;
+		_writer.BeginNode( _name );
+		JsonMembersToSraw( _reader, _writer, _stats );
+		_writer.EndNode();
+		return;
+	case '[':
+		JsonArrayToSraw( _reader, _writer, _name, _stats );
+		return;
+	case '"':
+		_writer.WriteString( _name, _reader.ReadJsonString() );
+		break;
+	case 't':
+	case 'f': {
+		uint8_t bit = _reader.ReadJsonBool( _first ) ? 1 : 0;
+		_writer.WriteArray( _name, ElementType::BIT, &bit, 1 );
+		} break;
+	case 'n':
+		// null -> empty node, as MetaFileWrapper writes untyped nodes
+		_reader.ReadJsonToken( _first );
+		++_stats.nodes;
+		_writer.BeginNode( _name );
+		_writer.EndNode();
+		return;
+	default: {
+		std::string number = _reader.ReadJsonToken( _first );
+		if( IsFloat( number ) )
+		{
+			double value = atof( number.c_str() );
+			_writer.WriteArray( _name, ElementType::DOUBLE, &value, 1 );
+		} else {
+			int64_t value = strtoll( number.c_str(), nullptr, 10 );
+			int32_t narrow = int32_t(value);
+			if( narrow == value ) _writer.WriteArray( _name, ElementType::INT32, &narrow, 1 );
+			else _writer.WriteArray( _name, ElementType::INT64, &value, 1 );
+		}
+		} break;
+	}
+	++_stats.arrays;
+	++_stats.elements;
+}
+
+// ************************************************************************* //
+static void JsonToSraw( const IFile& _in, IFile& _out, MetaFileWrapper::WriteFlags _flags, Statistics& _stats )
+{
+	StructReader reader( _in, Format::JSON );
+	SrawWriter writer( _out, _flags );
+	if( reader.NextToken() != '{' ) throw std::string("Syntax error in json file. Expected {");
+	++_stats.nodes;
+	JsonMembersToSraw( reader, writer, _stats );
+	writer.Finish();
+}
+
+// ************************************************************************* //
+static void CountNodes( const MetaFileWrapper::Node& _node, Statistics& _stats )
+{
+	if( _node.GetType() == ElementType::NODE )
+	{
+		++_stats.nodes;
+		for( uint64_t i=0; i<_node.Size(); ++i )
+			CountNodes( _node[i], _stats );
+	} else if( _node.GetType() == ElementType::UNKNOWN ) {
+		// Written as an empty node
+		++_stats.nodes;
+	} else {
+		++_stats.arrays;
+		_stats.elements += _node.Size();
+	}
+}
+
+#ifndef JO_CONVERT_NO_MAIN
+// ************************************************************************* //
+// Maximum resident set size of the process in bytes.
+static uint64_t PeakMemory()
+{
+#ifdef JO_WINDOWS
+	PROCESS_MEMORY_COUNTERS counters;
+	if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof(counters) ) )
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+#	ifdef JO_IOS
+	return uint64_t(usage.ru_maxrss);
+#	else
+	return uint64_t(usage.ru_maxrss) * 1024;
+#	endif
+#endif
+}
+
+// ************************************************************************* //
+int main( int _argc, char** _argv )
+{
+#ifdef JO_JSON2SRAW
+	const char* tool = "json2sraw";
+	const Format inFormat = Format::JSON, outFormat = Format::SRAW;
+#else
+	const char* tool = "sraw2json";
+	const Format inFormat = Format::SRAW, outFormat = Format::JSON;
+#endif
+
+	std::vector<std::string> files;
+	bool tree = false;
+	MetaFileWrapper::ReadFlags readFlags = 0;
+	MetaFileWrapper::WriteFlags writeFlags = 0;
+	for( int i=1; i<_argc; ++i )
+	{
+		std::string argument( _argv[i] );
+		if( argument == "--tree" ) tree = true;
+		else if( argument == "--parallel" ) readFlags |= MetaFileWrapper::PARALLEL;
+		else if( argument == "--compress" ) writeFlags |= MetaFileWrapper::COMPRESS;
+		else if( argument == "--align16" ) writeFlags |= MetaFileWrapper::ALIGN_16;
+		else if( argument == "--align64" ) writeFlags |= MetaFileWrapper::ALIGN_64;
+		else if( argument == "--directory" ) writeFlags |= MetaFileWrapper::CHILD_DIRECTORY;
+		else if( argument == "--narrow" ) writeFlags |= MetaFileWrapper::NARROW_INTEGERS;
+		else if( argument == "--varint" ) writeFlags |= MetaFileWrapper::VARINT_SIZES;
+		else if( argument == "--dedup" ) writeFlags |= MetaFileWrapper::DEDUPLICATE;
+		else files.push_back( argument );
+	}
+	if( files.size() != 2 )
+	{
+		printf( "Usage: %s <input> <output> [options]\n", tool );
+		printf( "  --tree       Read the whole document into a MetaFileWrapper\n" );
+		printf( "  --parallel   Read with several threads (--tree, SRAW input only)\n" );
+		printf( "  --compress   Compress large arrays (SRAW output only)\n" );
+		printf( "  --align16    Align arrays to 16 bytes (SRAW output only)\n" );
+		printf( "  --align64    Align arrays to 64 bytes (SRAW output only)\n" );
+		printf( "  --directory  Write child directories (--tree, SRAW output only)\n" );
+		printf( "  --narrow     Store integers with the smallest type (SRAW output only)\n" );
+		printf( "  --varint     Write variable length block sizes (--tree, SRAW output only)\n" );
+		printf( "  --dedup      Write repeated subtrees once (--tree, SRAW output only)\n" );
+		return 1;
+	}
+
+	try {
+		Statistics stats = { 0, 0, 0 };
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		HDDFile in( files[0] );
+		HDDFile out( files[1], HDDFile::OVERWRITE );
+		uint64_t inSize = in.GetSize();
+		if( tree )
+		{
+			if( readFlags & MetaFileWrapper::PARALLEL )
+			{
+				// Parallel reads require the whole file in memory. A mapping
+				// loads it without a copy.
+				MappedFile mapped( files[0] );
+				MetaFileWrapper wrapper( mapped, inFormat, readFlags );
+				wrapper.Write( out, outFormat, writeFlags );
+				CountNodes( wrapper.RootNode, stats );
+			} else {
+				MetaFileWrapper wrapper( in, inFormat, readFlags );
+				wrapper.Write( out, outFormat, writeFlags );
+				CountNodes( wrapper.RootNode, stats );
+			}
+		} else {
+			if( inFormat == Format::JSON ) JsonToSraw( in, out, writeFlags, stats );
+			else SrawToJson( in, out, stats );
+		}
+		out.Flush();
+		uint64_t outSize = out.GetSize();
+		double seconds = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - start ).count();
+
+		printf( "%s: %s -> %s (%s)\n", tool, files[0].c_str(), files[1].c_str(), tree ? "tree" : "streamed" );
+		printf( "  input     %.2f MB\n", inSize / 1e6 );
+		printf( "  output    %.2f MB\n", outSize / 1e6 );
+		printf( "  time      %.3f s\n", seconds );
+		printf( "  speed     %.2f MB/s\n", seconds > 0.0 ? inSize / 1e6 / seconds : 0.0 );
+		printf( "  peak RSS  %.2f MB\n", PeakMemory() / 1e6 );
+		printf( "  nodes     %llu\n", (unsigned long long)stats.nodes );
+		printf( "  arrays    %llu\n", (unsigned long long)stats.arrays );
+		printf( "  elements  %llu\n", (unsigned long long)stats.elements );
+	} catch( const std::string& _message ) {
+		printf( "%s: %s\n", tool, _message.c_str() );
+		return 1;
+	}
+	return 0;
+}
+#endif // JO_CONVERT_NO_MAIN
@@ -0,0 +1,507 @@
+#pragma once
+
+#include "filewrapper.hpp"
+#include "srawwriter.hpp"
+#include "platform.hpp"
+#include <string>
+#include <vector>
+#include <type_traits>
+
+namespace Jo {
+namespace Files {
+
+	struct FieldInfo;
+
+	/// \brief FNV-1a hash of a field name.
+	/// \details The names of a binding are hashed by the compiler. The
+	///		readers hash the names from the file at run time.
+	inline JO_CONSTEXPR uint32_t HashKey( const char* _name, uint32_t _hash = 2166136261u )
+	{
+		return *_name ? HashKey( _name + 1, (_hash ^ uint8_t(*_name)) * 16777619u ) : _hash;
+	}
+
+	/// \brief The field table of a struct. Specialized by the
+	///		JO_BINDING_BEGIN/JO_FIELD/JO_BINDING_END macros.
+	template<typename T> struct StructBinding
+	{
+		static const bool BOUND = false;
+	};
+
+	/**************************************************************************//**
+	 * \class	Jo::Files::StructReader
+	 * \brief	Reads SRAW or JSON directly into bound structs.
+	 * \details	Used by ReadStruct(). No Node is created: numeric arrays are
+	 *			read or converted into the target memory and unknown fields
+	 *			are skipped.
+	 *****************************************************************************/
+	class StructReader
+	{
+	public:
+		typedef MetaFileWrapper::ElementType ElementType;
+
+		/// \brief A SRAW block whose header was read.
+		struct Block
+		{
+			std::string name;
+			uint32_t hash;			///< HashKey() of the name
+			MetaFileWrapper::ElementType type;
+			uint64_t numElements;
+			uint64_t end;			///< Position after the data block
+		private:
+			friend class StructReader;
+			MetaFileWrapper::BlockHeader header;
+		};
+
+		/// \brief Detect the format and read the SRAW preamble.
+		/// \throws std::string
+		StructReader( const IFile& _file, Format _format );
+
+		/// \brief Read the root object into a struct with the given fields.
+		void ReadRoot( const FieldInfo* _fields, size_t _numFields, void* _object );
+
+		// ***** SRAW ***** //
+		/// \brief Read the next block header. The cursor is at the first
+		///		child or element afterwards.
+		void ReadHeader( Block& _block );
+
+		/// \brief Continue after the data block.
+		void Skip( const Block& _block )	{ m_file.Seek( _block.end ); }
+
+		/// \brief Read the first _num elements of a numeric or BIT block.
+		/// \details Numeric elements are converted like a static_cast.
+		/// \throws std::string if the block is too small or the types are
+		///		not compatible.
+		void ReadElements( const Block& _block, ElementType _type, void* _dst, uint64_t _num );
+
+		/// \brief Read all elements of a STRING block.
+		void ReadStrings( const Block& _block, std::vector<std::string>& _values );
+
+		/// \brief Read the children of a NODE block into the fields of a
+		///		struct. Unknown children are skipped.
+		void ReadNode( const Block& _block, const FieldInfo* _fields, size_t _numFields, void* _object );
+
+		// ***** JSON ***** //
+		/// \brief The next non-whitespace character.
+		char NextToken();
+
+		/// \brief Read a string whose opening " was consumed already.
+		std::string ReadJsonString();
+
+		/// \brief Characters of a number or literal up to the delimiter.
+		std::string ReadJsonToken( char _first );
+
+		/// \brief Parse a number and convert it to _type.
+		void ReadJsonNumber( char _first, ElementType _type, void* _dst );
+
+		/// \brief Parse true or false.
+		bool ReadJsonBool( char _first );
+
+		/// \brief Skip a value of any type.
+		void SkipJsonValue( char _first );
+
+		/// \brief Iterate over the elements of an array:
+		///		for( char c = BeginJsonArray(first); c != ']'; c = NextJsonElement() )
+		/// \return The first character of the next element or ']'.
+		char BeginJsonArray( char _first );
+		char NextJsonElement();
+
+		/// \brief Read an object into the fields of a struct. Unknown keys
+		///		are skipped.
+		void ReadObject( char _first, const FieldInfo* _fields, size_t _numFields, void* _object );
+
+	private:
+		const IFile& m_file;
+		Format m_format;
+		int m_srawFlags;
+		std::vector<uint8_t> m_scratch;		///< Payloads which must be converted
+
+		/// \brief Find the field with the given name. Files written from
+		///		the same binding have the fields in table order, so the
+		///		search starts after the previous match.
+		static const FieldInfo* FindField( const FieldInfo* _fields, size_t _numFields, uint32_t _hash, const std::string& _name, size_t& _next );
+
+		// Copying readers not allowed.
+		StructReader( const StructReader& );
+		void operator = ( const StructReader& );
+	};
+
+	/**************************************************************************//**
+	 * \class	Jo::Files::StructWriter
+	 * \brief	Writes bound structs as SRAW or JSON.
+	 * \details	Used by WriteStruct(). SRAW is streamed through a
+	 *			SrawWriter, JSON uses the layout of MetaFileWrapper::Write.
+	 *****************************************************************************/
+	class StructWriter
+	{
+	public:
+		typedef MetaFileWrapper::ElementType ElementType;
+
+		/// \param [in] _flags Options for the SRAW writer. Ignored for JSON.
+		StructWriter( IFile& _file, Format _format, MetaFileWrapper::WriteFlags _flags );
+		~StructWriter();
+
+		/// \brief Write the root object and finish the file.
+		void WriteRoot( const FieldInfo* _fields, size_t _numFields, const void* _object );
+
+		// ***** SRAW ***** //
+		SrawWriter& Sraw()			{ return *m_sraw; }
+
+		/// \brief Write all fields as children of the current node.
+		void WriteFields( const FieldInfo* _fields, size_t _numFields, const void* _object );
+
+		// ***** JSON ***** //
+		/// \brief Write one number or a [] array of numbers.
+		void JsonNumbers( ElementType _type, const void* _values, uint64_t _num, bool _asArray );
+		void JsonBool( bool _value );
+		void JsonStrings( const std::string* _values, uint64_t _num, bool _asArray );
+
+		/// \brief Write all fields as an object.
+		void JsonObject( const FieldInfo* _fields, size_t _numFields, const void* _object );
+
+		/// \brief Write an array of objects.
+		/// \details Call JsonListItem() before each element.
+		void JsonBeginList( uint64_t _num );
+		void JsonListItem( uint64_t _index );
+		void JsonEndList( uint64_t _num );
+
+	private:
+		IFile& m_file;
+		SrawWriter* m_sraw;		///< nullptr for JSON
+		int m_indent;
+
+		void Write( const char* _text );
+		void Indent();
+
+		// Copying writers not allowed.
+		StructWriter( const StructWriter& );
+		void operator = ( const StructWriter& );
+	};
+
+	/// \brief One entry of the field table of a bound struct.
+	/// \details The functions take a pointer to the whole struct.
+	struct FieldInfo
+	{
+		const char* name;
+		uint32_t hash;		///< HashKey( name )
+		void (*readSraw)( StructReader& _reader, const StructReader::Block& _block, void* _object );
+		void (*readJson)( StructReader& _reader, char _first, void* _object );
+		void (*writeSraw)( StructWriter& _writer, const char* _name, const void* _object );
+		void (*writeJson)( StructWriter& _writer, const void* _object );
+	};
+
+	// ********************************************************************* //
+	// Codecs of the supported field types. Unsupported types fail to compile.
+	template<typename T, typename Enable = void> struct FieldCodec;
+
+	/// \brief Numbers are arrays with one element.
+	template<typename T> struct FieldCodec<T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, T& _value )
+		{
+			_reader.ReadElements( _block, MetaFileWrapper::TypeOf(&_value), &_value, 1 );
+		}
+		static void ReadJson( StructReader& _reader, char _first, T& _value )
+		{
+			_reader.ReadJsonNumber( _first, MetaFileWrapper::TypeOf(&_value), &_value );
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const T& _value )
+		{
+			_writer.Sraw().WriteArray( _name, MetaFileWrapper::TypeOf(&_value), &_value, 1 );
+		}
+		static void WriteJson( StructWriter& _writer, const T& _value )
+		{
+			_writer.JsonNumbers( MetaFileWrapper::TypeOf(&_value), &_value, 1, false );
+		}
+	};
+
+	/// \brief Booleans are BIT blocks. Numbers are accepted as well.
+	template<> struct FieldCodec<bool>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, bool& _value )
+		{
+			uint8_t value;
+			if( _block.type == MetaFileWrapper::ElementType::BIT )
+			{
+				_reader.ReadElements( _block, _block.type, &value, 1 );
+				value &= 1;
+			} else _reader.ReadElements( _block, MetaFileWrapper::ElementType::UINT8, &value, 1 );
+			_value = value != 0;
+		}
+		static void ReadJson( StructReader& _reader, char _first, bool& _value )
+		{
+			_value = _reader.ReadJsonBool( _first );
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const bool& _value )
+		{
+			uint8_t value = _value ? 1 : 0;
+			_writer.Sraw().WriteArray( _name, MetaFileWrapper::ElementType::BIT, &value, 1 );
+		}
+		static void WriteJson( StructWriter& _writer, const bool& _value )
+		{
+			_writer.JsonBool( _value );
+		}
+	};
+
+	template<> struct FieldCodec<std::string>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, std::string& _value )
+		{
+			std::vector<std::string> values;
+			_reader.ReadStrings( _block, values );
+			if( values.empty() ) throw "[ReadStruct] The string '" + _block.name + "' has no elements.";
+			_value.swap( values[0] );
+		}
+		static void ReadJson( StructReader& _reader, char _first, std::string& _value )
+		{
+			if( _first != '"' ) throw std::string("Syntax error in json file. Expected \"");
+			_value = _reader.ReadJsonString();
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const std::string& _value )
+		{
+			_writer.Sraw().WriteString( _name, _value );
+		}
+		static void WriteJson( StructWriter& _writer, const std::string& _value )
+		{
+			_writer.JsonStrings( &_value, 1, false );
+		}
+	};
+
+	/// \brief Fixed size arrays of numbers.
+	template<typename T, size_t N> struct FieldCodec<T[N], typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, T (&_values)[N] )
+		{
+			_reader.ReadElements( _block, MetaFileWrapper::TypeOf(_values), _values, N );
+		}
+		static void ReadJson( StructReader& _reader, char _first, T (&_values)[N] )
+		{
+			size_t i = 0;
+			for( char c = _reader.BeginJsonArray( _first ); c != ']'; c = _reader.NextJsonElement() )
+			{
+				if( i == N ) throw std::string("[ReadStruct] Too many elements for a fixed size array.");
+				_reader.ReadJsonNumber( c, MetaFileWrapper::TypeOf(_values), &_values[i++] );
+			}
+			if( i != N ) throw std::string("[ReadStruct] Too few elements for a fixed size array.");
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const T (&_values)[N] )
+		{
+			_writer.Sraw().WriteArray( _name, MetaFileWrapper::TypeOf(_values), _values, N );
+		}
+		static void WriteJson( StructWriter& _writer, const T (&_values)[N] )
+		{
+			_writer.JsonNumbers( MetaFileWrapper::TypeOf(_values), _values, N, true );
+		}
+	};
+
+	/// \brief Dynamic arrays of numbers.
+	template<typename T> struct FieldCodec<std::vector<T>, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, std::vector<T>& _values )
+		{
+			_values.resize( (size_t)_block.numElements );
+			_reader.ReadElements( _block, MetaFileWrapper::TypeOf(_values.data()), _values.data(), _values.size() );
+		}
+		static void ReadJson( StructReader& _reader, char _first, std::vector<T>& _values )
+		{
+			_values.clear();
+			for( char c = _reader.BeginJsonArray( _first ); c != ']'; c = _reader.NextJsonElement() )
+			{
+				_values.push_back( T() );
+				_reader.ReadJsonNumber( c, MetaFileWrapper::TypeOf(_values.data()), &_values.back() );
+			}
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const std::vector<T>& _values )
+		{
+			_writer.Sraw().WriteArray( _name, MetaFileWrapper::TypeOf(_values.data()), _values.data(), _values.size() );
+		}
+		static void WriteJson( StructWriter& _writer, const std::vector<T>& _values )
+		{
+			_writer.JsonNumbers( MetaFileWrapper::TypeOf(_values.data()), _values.data(), _values.size(), true );
+		}
+	};
+
+	template<> struct FieldCodec<std::vector<std::string>>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, std::vector<std::string>& _values )
+		{
+			_reader.ReadStrings( _block, _values );
+		}
+		static void ReadJson( StructReader& _reader, char _first, std::vector<std::string>& _values )
+		{
+			_values.clear();
+			for( char c = _reader.BeginJsonArray( _first ); c != ']'; c = _reader.NextJsonElement() )
+			{
+				if( c != '"' ) throw std::string("Syntax error in json file. Expected \"");
+				_values.push_back( _reader.ReadJsonString() );
+			}
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const std::vector<std::string>& _values )
+		{
+			_writer.Sraw().WriteStrings( _name, _values.data(), _values.size() );
+		}
+		static void WriteJson( StructWriter& _writer, const std::vector<std::string>& _values )
+		{
+			_writer.JsonStrings( _values.data(), _values.size(), true );
+		}
+	};
+
+	/// \brief Bound structs are nodes.
+	template<typename T> struct FieldCodec<T, typename std::enable_if<StructBinding<T>::BOUND>::type>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, T& _value )
+		{
+			size_t numFields;
+			const FieldInfo* fields = StructBinding<T>::Fields( numFields );
+			_reader.ReadNode( _block, fields, numFields, &_value );
+		}
+		static void ReadJson( StructReader& _reader, char _first, T& _value )
+		{
+			size_t numFields;
+			const FieldInfo* fields = StructBinding<T>::Fields( numFields );
+			_reader.ReadObject( _first, fields, numFields, &_value );
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const T& _value )
+		{
+			size_t numFields;
+			const FieldInfo* fields = StructBinding<T>::Fields( numFields );
+			_writer.Sraw().BeginNode( _name );
+			_writer.WriteFields( fields, numFields, &_value );
+			_writer.Sraw().EndNode();
+		}
+		static void WriteJson( StructWriter& _writer, const T& _value )
+		{
+			size_t numFields;
+			const FieldInfo* fields = StructBinding<T>::Fields( numFields );
+			_writer.JsonObject( fields, numFields, &_value );
+		}
+	};
+
+	/// \brief Arrays of bound structs are nodes with unnamed children.
+	template<typename T> struct FieldCodec<std::vector<T>, typename std::enable_if<StructBinding<T>::BOUND>::type>
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, std::vector<T>& _values )
+		{
+			if( _block.type != MetaFileWrapper::ElementType::NODE ) throw "[ReadStruct] '" + _block.name + "' is not a node.";
+			_values.resize( (size_t)_block.numElements );
+			StructReader::Block element;
+			for( size_t i=0; i<_values.size(); ++i )
+			{
+				_reader.ReadHeader( element );
+				FieldCodec<T>::ReadSraw( _reader, element, _values[i] );
+				_reader.Skip( element );
+			}
+		}
+		static void ReadJson( StructReader& _reader, char _first, std::vector<T>& _values )
+		{
+			_values.clear();
+			for( char c = _reader.BeginJsonArray( _first ); c != ']'; c = _reader.NextJsonElement() )
+			{
+				_values.push_back( T() );
+				FieldCodec<T>::ReadJson( _reader, c, _values.back() );
+			}
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const std::vector<T>& _values )
+		{
+			_writer.Sraw().BeginNode( _name );
+			for( size_t i=0; i<_values.size(); ++i )
+				FieldCodec<T>::WriteSraw( _writer, "", _values[i] );
+			_writer.Sraw().EndNode();
+		}
+		static void WriteJson( StructWriter& _writer, const std::vector<T>& _values )
+		{
+			_writer.JsonBeginList( _values.size() );
+			for( size_t i=0; i<_values.size(); ++i )
+			{
+				_writer.JsonListItem( i );
+				FieldCodec<T>::WriteJson( _writer, _values[i] );
+			}
+			_writer.JsonEndList( _values.size() );
+		}
+	};
+
+	/// \brief The type erased functions of one field.
+	template<typename S, typename T, T S::*M> struct FieldAccess
+	{
+		static void ReadSraw( StructReader& _reader, const StructReader::Block& _block, void* _object )
+		{
+			FieldCodec<T>::ReadSraw( _reader, _block, ((S*)_object)->*M );
+		}
+		static void ReadJson( StructReader& _reader, char _first, void* _object )
+		{
+			FieldCodec<T>::ReadJson( _reader, _first, ((S*)_object)->*M );
+		}
+		static void WriteSraw( StructWriter& _writer, const char* _name, const void* _object )
+		{
+			FieldCodec<T>::WriteSraw( _writer, _name, ((const S*)_object)->*M );
+		}
+		static void WriteJson( StructWriter& _writer, const void* _object )
+		{
+			FieldCodec<T>::WriteJson( _writer, ((const S*)_object)->*M );
+		}
+	};
+
+	/// \brief Read a bound struct from a SRAW or JSON file.
+	/// \details Fields missing in the file keep their value. Blocks and
+	///		keys without a field are skipped.
+	/// \throws std::string
+	template<typename T> void ReadStruct( const IFile& _file, Format _format, T& _object )
+	{
+		static_assert( StructBinding<T>::BOUND, "The type has no binding (JO_BINDING_BEGIN)." );
+		size_t numFields;
+		const FieldInfo* fields = StructBinding<T>::Fields( numFields );
+		StructReader reader( _file, _format );
+		reader.ReadRoot( fields, numFields, &_object );
+	}
+
+	/// \brief Write a bound struct as SRAW or JSON file.
+	/// \details The result is also readable by MetaFileWrapper.
+	/// \param [in] _flags Options for the SRAW writer. CHILD_DIRECTORY is
+	///		not supported.
+	/// \throws std::string
+	template<typename T> void WriteStruct( IFile& _file, Format _format, const T& _object, MetaFileWrapper::WriteFlags _flags = 0 )
+	{
+		static_assert( StructBinding<T>::BOUND, "The type has no binding (JO_BINDING_BEGIN)." );
+		size_t numFields;
+		const FieldInfo* fields = StructBinding<T>::Fields( numFields );
+		StructWriter writer( _file, _format, _flags );
+		writer.WriteRoot( fields, numFields, &_object );
+	}
+
+} // namespace Files
+} // namespace Jo
+
+/// \brief Declare the fields of a struct once to read and write it with
+///		ReadStruct() and WriteStruct(). Use at global scope:
+///
+///		JO_BINDING_BEGIN( Vertex )
+///			JO_FIELD( position )
+///			JO_FIELD( normal )
+///		JO_BINDING_END()
+///
+///		Supported field types are numbers, bool, std::string, fixed size
+///		arrays of numbers, std::vectors of numbers, strings and bound
+///		structs and bound structs themselves.
+#define JO_BINDING_BEGIN(TYPE)														\
+	namespace Jo { namespace Files {												\
+	template<> struct StructBinding<TYPE>											\
+	{																				\
+		static const bool BOUND = true;												\
+		typedef TYPE Self;															\
+		static const FieldInfo* Fields( size_t& _num )								\
+		{																			\
+			static const FieldInfo FIELDS[] = {
+
+#define JO_FIELD(MEMBER)															\
+				{ #MEMBER, ::Jo::Files::HashKey(#MEMBER),							\
+				  &FieldAccess<Self, decltype(((Self*)nullptr)->MEMBER), &Self::MEMBER>::ReadSraw,	\
+				  &FieldAccess<Self, decltype(((Self*)nullptr)->MEMBER), &Self::MEMBER>::ReadJson,	\
+				  &FieldAccess<Self, decltype(((Self*)nullptr)->MEMBER), &Self::MEMBER>::WriteSraw,	\
+				  &FieldAccess<Self, decltype(((Self*)nullptr)->MEMBER), &Self::MEMBER>::WriteJson },
+
+#define JO_BINDING_END()															\
+			};																		\
+			_num = sizeof(FIELDS) / sizeof(FIELDS[0]);								\
+			return FIELDS;															\
+		}																			\
+	};																				\
+	} }
@@ -45,6 +45,12 @@ namespace Files {
 		/// \brief Return something to identify the file
 		virtual std::string Name() const = 0;
 
+		/// \brief Direct access to the content of files which are
+		///		completely in memory.
+		/// \return The address of the first byte or nullptr if the file
+		///		content is not accessible this way.
+		virtual const void* GetBuffer() const	{ return nullptr; }
+
 		/// \brief Returns the cursor position within the file.
 		/// \return A cursor position with large file support.
 		uint64_t GetCursor() const		{ return m_cursor; }
@@ -2,6 +2,15 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <functional>
 #include <poolallocator.hpp>
 
 namespace Jo {
@@ -9,6 +18,8 @@ namespace Files {
 
 	enum struct Format;
 	class IFile;
+	class BackgroundSave;
+	class FrozenDocument;
 
 	/**************************************************************************//**
 	 * \class	Jo::Files::MetaFileWrapper
@@ -19,21 +30,220 @@ namespace Files {
 	 *			specification: Arrays [] must have values of the same type. The
 	 *			usual specification allows different types. The type can still be
 	 *			object and each object can contain different values.
+	 *			Integers are read as INT32 or INT64 if they do not fit. A
+	 *			float turns the whole array into DOUBLE. null is only allowed
+	 *			for members and in arrays of objects or arrays. It is written
+	 *			to SRAW as an empty node.
 	 *
 	 *			MetaFileWrapper Wrapper( someFile, Jo::Files::Format::SRAW )
+	 *
+	 *			All const methods of the wrapper and its nodes can be called from
+	 *			many threads at once as long as no thread changes the wrapper.
 	 *****************************************************************************/
 	class MetaFileWrapper
 	{
+	public:
+		class Node;
+	private:
 		//Format m_Format;
 		//const IFile* m_file;
 		Memory::PoolAllocator m_nodePool;
 
+		/// \brief All node names of this wrapper. Each name is stored once and
+		///		nodes only reference the entry.
+		std::unordered_set<std::string> m_names;
+
+		/// \brief Identifier of an interned node name.
+		/// \details Two nodes of the same wrapper have the same name if and
+		///		only if the pointers are equal.
+		typedef const std::string* NameId;
+
+		/// \brief The shared identifier for unnamed nodes (array elements).
+		static const std::string EmptyName;
+
+		/// \brief Get the identifier of a name and add it to the table if
+		///		necessary.
+		NameId InternName( const std::string& _name );
+
+		/// \brief Get the identifier of a name without changing the table.
+		/// \return nullptr if no node in this wrapper has this name.
+		NameId FindName( const std::string& _name ) const;
+
+		/// \brief The file of a lazy loaded wrapper or nullptr.
+		const IFile* m_source;
+		/// \brief Serializes the decoding of lazy nodes and the access to
+		///		the name table while lazy nodes are decoded.
+		mutable std::mutex m_sourceMutex;
+		/// \brief Number of nodes which are HEADER_ONLY or CHILDREN_PENDING.
+		/// \details Only decoding them changes the name table of a const
+		///		wrapper, so lookups need m_sourceMutex while this is not 0.
+		std::atomic<uint64_t> m_numLazyNodes;
+		/// \brief The WriteFlags stored in the header of the SRAW file
+		///		which was read (0 for revision 1 files).
+		int m_srawFlags;
+		/// \brief Content of the source file for IN_PLACE reads or nullptr.
+		const uint8_t* m_sourceMemory;
+		/// \brief Element assignments of IN_PLACE arrays change
+		///		m_sourceMemory (WRITE_THROUGH).
+		bool m_writeThrough;
+		/// \brief Node memory which was taken from m_nodePool by the
+		///		workers of a parallel read but not used.
+		std::vector<void*> m_spareNodes;
+		/// \brief Roots of the subtrees which have several parents and
+		///		their number of parents (DEDUPLICATE).
+		std::unordered_map<Node*, uint32_t> m_sharedNodes;
+		/// \brief NODE blocks of the running read by their header
+		///		position if references can share them, nullptr otherwise.
+		std::unordered_map<uint64_t, Node*>* m_referenceTargets;
+
+		/// \brief Buffers which the running background save shares with
+		///		the nodes (see SaveInBackground()).
+		struct SnapshotShare;
+		std::shared_ptr<SnapshotShare> m_share;
+		/// \brief Increased with each snapshot. Nodes which share buffers
+		///		with the current snapshot carry the same number.
+		uint32_t m_snapshotGeneration;
+		friend class BackgroundSave;
+		friend class FrozenDocument;
+
+		/// \brief Get the memory for a new node from the pool.
+		/// \details Workers of a parallel read take the memory in batches.
+		void* AllocNode();
+
+		/// \brief Remove a child from one of its parents. Shared subtrees
+		///		are destroyed with their last parent.
+		void DeleteNode( Node* _node );
+
+		/// \brief Register an additional parent of _node and make the
+		///		subtree read-only.
+		void ShareNode( Node* _node );
+
+	public:
+		/// \brief Determine how a file should be read.
+		/// \details The flags can be used in any combination.
+		typedef int ReadFlags;
+		/// \brief Only read the headers of the children of a SRAW node and
+		///		decode a subtree when it is accessed first.
+		/// \details The file must stay valid and unchanged as long as the
+		///		wrapper exists.
+		static const int LAZY = 1;
+		/// \brief Numeric arrays point into the buffer of the file
+		///		(IFile::GetBuffer()) instead of being copied. This works for
+		///		MemFiles, including ones which wrap mapped memory. SRAW
+		///		arrays and CBOR typed arrays in host byte order are read
+		///		IN_PLACE.
+		/// \details The file must stay valid and unchanged as long as the
+		///		wrapper exists. The arrays are read-only: changing one of
+		///		them copies it first. Arrays which are not aligned to their
+		///		element size are copied as well, so write SRAW with ALIGN_16
+		///		or ALIGN_64 to avoid copies. The CBOR writer always aligns
+		///		typed arrays.
+		static const int IN_PLACE = 2;
+		/// \brief Large subtrees and arrays of a SRAW file are read by
+		///		several threads. This requires a file with a buffer
+		///		(IFile::GetBuffer()), otherwise the file is read by one
+		///		thread. Ignored together with LAZY.
+		static const int PARALLEL = 4;
+		/// \brief IN_PLACE read where assigning elements of an array in the
+		///		file buffer changes the file itself. Together with a
+		///		MappedFile opened with MappedFile::WRITE single values of a
+		///		large file are patched without rewriting it.
+		/// \details Implies IN_PLACE and requires a file with write access.
+		///		Only elements of numeric and BIT arrays are written through
+		///		(operator =, GetData() and AsSpan()). Structural changes
+		///		(Resize, Add, strings) copy the array into the wrapper and
+		///		need a Write as before. Arrays which cannot be read IN_PLACE
+		///		(compressed, unaligned or of foreign byte order) are copies
+		///		from the beginning. Node::IsWrittenThrough() tells which
+		///		arrays are patched.
+		static const int WRITE_THROUGH = 8;
+
+		/// \brief Options for the SRAW writer.
+		/// \details If any flag is set a revision 2 file is written. Such
+		///		a file starts with a version byte and the flags. Readers
+		///		detect the revision automatically.
+		typedef int WriteFlags;
+		/// \brief Each NODE block starts with a directory of its children
+		///		sorted by name. A LAZY reader uses it to find a child with
+		///		O(log n) reads without decoding the siblings.
+		static const int CHILD_DIRECTORY = 1;
+		/// \brief The payloads of numeric arrays start at a multiple of 16
+		///		or 64 bytes from the file start. Arrays smaller than the
+		///		alignment are not padded.
+		static const int ALIGN_16 = 2;
+		static const int ALIGN_64 = 4;
+		/// \brief Numeric and BIT arrays with at least
+		///		COMPRESSION_THRESHOLD bytes are compressed. Integer arrays
+		///		use a delta/zig-zag varint code, all others byte-shuffle +
+		///		deflate. Arrays which do not get smaller are stored raw.
+		/// \details Compressed arrays are never aligned or read IN_PLACE.
+		static const int COMPRESS = 8;
+		/// \brief Minimum payload size in bytes of a compressed array.
+		static const uint64_t COMPRESSION_THRESHOLD = 4096;
+		/// \brief All numbers in the file are big-endian.
+		/// \details The writers set or clear this flag depending on the
+		///		host. Files without the flag are little-endian. Readers swap
+		///		the bytes of files from hosts with the other byte order.
+		static const int BIG_ENDIAN_FILE = 16;
+		/// \brief Integer arrays are stored with the smallest INT or UINT
+		///		type which holds all their values, e.g. an INT32 array with
+		///		values from 0 to 200 as UINT8. The signedness is kept if
+		///		possible.
+		/// \details A reader gets the narrow type. Casts, Get() and CopyTo()
+		///		convert the elements and integer assignments are converted
+		///		if the value fits. This flag is not stored in the file,
+		///		which stays readable for all readers.
+		static const int NARROW_INTEGERS = 32;
+		/// \brief The SIZE fields of NODE and STRING blocks and of
+		///		compressed arrays are LEB128 varints instead of 8 bytes.
+		/// \details Cannot be combined with ALIGN_16 or ALIGN_64 because
+		///		the padding would depend on the sizes.
+		static const int VARINT_SIZES = 64;
+		/// \brief Repeated NODE subtrees are written once. Later copies
+		///		are stored as references to the first one.
+		/// \details Subtrees are compared by a content hash without the
+		///		name of their root and verified before they are merged.
+		///		A non-LAZY, non-PARALLEL read shares the subtree between
+		///		all references with the same name. Shared subtrees are
+		///		read-only (see Node::IsReadOnly()). All other reads decode
+		///		each reference into its own nodes.
+		static const int DEDUPLICATE = 128;
+		/// \brief MSGPACK: numeric and BIT arrays are written as ext
+		///		values with the raw little-endian elements instead of
+		///		arrays of single numbers. The ext type is the ElementType.
+		/// \details Much smaller and faster to read, but only readers
+		///		which know these ext types understand them. The SRAW
+		///		writers ignore this flag.
+		static const int PACKED_ARRAYS = 256;
+
+	private:
+		friend class SrawWriter;
+		/// \brief First byte and version of a SRAW revision 2 file.
+		static const uint8_t SRAW_V2_MARKER = 'S';
+		static const uint8_t SRAW_VERSION = 2;
+		/// \brief Bit in the CodeNType of an array with COMPRESS.
+		static const uint8_t SRAW_COMPRESSED = 0x40;
+		/// \brief Bit in the CodeNType of a reference (DEDUPLICATE).
+		static const uint8_t SRAW_REFERENCE = 0x80;
+
+		/// \brief Number of zero bytes between the PAD byte at _position
+		///		and an array payload of the given size.
+		static uint8_t PaddingSize( WriteFlags _flags, uint64_t _position, uint64_t _payloadSize );
+
+		struct ReadBatch;
+		struct BlockHeader;
+		struct SrawWriteState;
+		struct MsgpackWriter;
+		struct CborWriter;
+
 	public:
+
 		/// \brief Use a wrapped file to read from.
 		/// \details Changing the MetaFileWrapper will not change the input file.
 		///		You have to call Write to do that.
 		/// \param _format [in] How should the input be interpreted.
-		MetaFileWrapper( const IFile& _file, Format _format = Format::AUTO_DETECT );
+		/// \param _flags [in] Options for the SRAW reader.
+		MetaFileWrapper( const IFile& _file, Format _format = Format::AUTO_DETECT, ReadFlags _flags = 0 );
 
 		/// \brief Clears the old data and loads content from file.
 		/// \param _file [in] An opened file which is read. This can also be a
@@ -41,7 +251,8 @@ namespace Files {
 		///		meta file of the specified format. The file is not necessarily
 		///		read to the end.
 		/// \param _format [in] How should the input be interpreted.
-		void Read( const IFile& _file, Format _format = Format::AUTO_DETECT );
+		/// \param _flags [in] Options for the SRAW reader.
+		void Read( const IFile& _file, Format _format = Format::AUTO_DETECT, ReadFlags _flags = 0 );
 
 		/// \brief Create an empty wrapper for writing new files.
 		/// \details After adding all the data into the wrapper use Write to
@@ -51,7 +262,98 @@ namespace Files {
 		/// \brief Writes the wrapped data into a file.
 		/// \param _file [in] A file opened with write access.
 		/// \param _format [in] Format as which the data should be saved.
-		void Write( IFile& _file, Format _format ) const;
+		/// \param _flags [in] Options for the SRAW writer. MSGPACK only uses
+		///		PACKED_ARRAYS. Ignored for JSON and CBOR.
+		void Write( IFile& _file, Format _format, WriteFlags _flags = 0 ) const;
+
+		/// \brief Append all changes since the last read, journal or
+		///		compaction to a journal file.
+		/// \details A journal belongs to the SRAW snapshot the wrapper was
+		///		read from. It only contains the changed subtrees (see
+		///		Node::IsDirty()), so saving small edits of a large document
+		///		is cheap. Records are appended at the end of _journal, an
+		///		empty file gets the journal header first. A record which
+		///		was not written completely (crash) is ignored on replay.
+		/// \param [in] _flags Options for the SRAW blocks of the records.
+		void WriteJournal( IFile& _journal, WriteFlags _flags = 0 );
+
+		/// \brief Apply all records of a journal to the snapshot which was
+		///		read.
+		/// \details Afterwards the wrapper has no changes. The journal
+		///		must be the one written for the current snapshot.
+		/// \throws std::string if the journal does not fit the document.
+		void ReplayJournal( const IFile& _journal );
+
+		/// \brief Write a new SRAW snapshot which includes all changes.
+		/// \details The journals of the old snapshot are obsolete
+		///		afterwards: continue with an empty journal.
+		void Compact( IFile& _snapshot, WriteFlags _flags = 0 );
+
+		/// \brief A change between two documents found by Diff().
+		struct Difference
+		{
+			enum struct Kind
+			{
+				CHANGED,	///< Other type or elements. NODEs are not CHANGED themselves, their children are compared.
+				ADDED,		///< Only in the other document
+				REMOVED,	///< Only in this document
+				RENAMED		///< Other name at the same position (the content is compared independently)
+			};
+			Kind kind;
+			/// \brief JSON pointer (RFC 6901) of the node. The steps are the
+			///		names of the children or their index if they have no
+			///		name. The names are those of the other document except
+			///		for REMOVED nodes.
+			std::string path;
+			std::vector<uint64_t> indices;	///< Child indices from the root
+		};
+
+		/// \brief List the nodes which differ between this and an other
+		///		document.
+		/// \details Children are compared by their position. Subtrees with
+		///		the same hash (Node::GetHash()) are skipped, so once the
+		///		hashes are known the costs depend on the changes and not
+		///		on the size of the documents.
+		std::vector<Difference> Diff( const MetaFileWrapper& _other ) const;
+
+		/// \brief Write a patch which turns this document into _other.
+		/// \details The patch is a journal with the records of Diff(): only
+		///		the changed subtrees are stored. Apply it with
+		///		ReplayJournal() to a document equal to this one. Records
+		///		are appended like with WriteJournal().
+		/// \param [in] _flags Options for the SRAW blocks of the records.
+		void WritePatch( const MetaFileWrapper& _other, IFile& _patch, WriteFlags _flags = 0 ) const;
+
+		/// \brief Write the current state of the document on a background
+		///		thread while the document can still be changed.
+		/// \details The snapshot copies the tree structure but shares the
+		///		arrays and strings with the document. A node copies its
+		///		buffers when it is changed first (copy-on-write), so the
+		///		calling thread only pays for the nodes it touches during
+		///		the save. Only one save shares memory with a document at a
+		///		time: a second call waits until the previous save is done.
+		///
+		///		Pointers from GetData() or AsSpan() which were taken before
+		///		the call must not be used for writing afterwards. Arrays of
+		///		a WRITE_THROUGH read stop being written through on their
+		///		first change during the save.
+		/// \param [in] _file Must stay valid and must not be used by other
+		///		threads until the save is done.
+		/// \param [in] _onComplete Called on the background thread after
+		///		the file was written. The argument is empty on success or
+		///		the error message.
+		/// \return Handle to poll the progress and to wait for the result.
+		///		Destroying it waits for the save.
+		std::unique_ptr<BackgroundSave> SaveInBackground( IFile& _file, Format _format, WriteFlags _flags = 0,
+			std::function<void(const std::string&)> _onComplete = nullptr );
+
+		/// \brief Convert the document into an immutable tape for fast
+		///		read-only access. See FrozenDocument.
+		std::unique_ptr<FrozenDocument> Freeze() const;
+
+		/// \brief Number of distinct node names in this wrapper.
+		/// \details Looking up a name which no node has does not add it.
+		size_t GetNumNames() const;
 
 		enum struct ElementType
 		{
@@ -76,6 +378,100 @@ namespace Files {
 
 		static const int64_t ELEMENT_TYPE_SIZE[];
 
+		/// \brief Number of bytes of _numElements elements of a numeric or
+		///		BIT array. Bits are packed into bytes.
+		static uint64_t ArraySize( uint64_t _numElements, ElementType _type )	{ return (_numElements * ELEMENT_TYPE_SIZE[(int)_type] + 7) / 8; }
+
+		/// \brief A non-owning reference to the characters of one string
+		///		element.
+		/// \details The characters are not 0-terminated. The view becomes
+		///		invalid if the node is changed.
+		struct StringView
+		{
+			const char* data;
+			uint64_t length;
+
+			operator std::string() const		{ return std::string(data, size_t(length)); }
+		};
+
+		/// \brief A non-owning typed view of the elements of an array node.
+		/// \details The view becomes invalid if the node is resized.
+		template<typename T> struct Span
+		{
+			T* data;
+			uint64_t size;
+
+			T* begin() const					{ return data; }
+			T* end() const						{ return data + size; }
+			T& operator[]( uint64_t _index ) const	{ return data[_index]; }
+		};
+
+		/// \brief A pair of iterators for range-based for loops.
+		template<typename Iterator> struct Range
+		{
+			Iterator first;
+			Iterator last;
+
+			Iterator begin() const				{ return first; }
+			Iterator end() const				{ return last; }
+		};
+
+		/// \brief Iterates the elements of a BIT array as bool.
+		class BitIterator
+		{
+			const uint8_t* m_bits;
+			uint64_t m_index;
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef bool value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const bool* pointer;
+			typedef bool reference;
+
+			BitIterator( const void* _bits, uint64_t _index ) : m_bits((const uint8_t*)_bits), m_index(_index)	{}
+
+			bool operator*() const				{ return ((m_bits[m_index / 8] >> (m_index & 0x7)) & 1) != 0; }
+			BitIterator& operator++()			{ ++m_index; return *this; }
+			BitIterator operator++(int)			{ BitIterator old = *this; ++m_index; return old; }
+			bool operator==( const BitIterator& _other ) const	{ return m_index == _other.m_index; }
+			bool operator!=( const BitIterator& _other ) const	{ return m_index != _other.m_index; }
+		};
+
+		/// \brief Iterates the elements of a STRING array as StringView.
+		class StringIterator
+		{
+			const char* m_strings;
+			const uint64_t* m_end;				///< End offset of the current element
+			uint64_t m_begin;					///< Begin offset of the current element
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef StringView value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const StringView* pointer;
+			typedef StringView reference;
+
+			StringIterator( const char* _strings, const uint64_t* _end, uint64_t _begin ) : m_strings(_strings), m_end(_end), m_begin(_begin)	{}
+
+			StringView operator*() const		{ StringView view = { m_strings + m_begin, *m_end - m_begin }; return view; }
+			StringIterator& operator++()		{ m_begin = *m_end++; return *this; }
+			StringIterator operator++(int)		{ StringIterator old = *this; ++*this; return old; }
+			bool operator==( const StringIterator& _other ) const	{ return m_end == _other.m_end; }
+			bool operator!=( const StringIterator& _other ) const	{ return m_end != _other.m_end; }
+		};
+
+		/// \brief Map a C++ type to the element type with the same memory
+		///		layout.
+		static ElementType TypeOf( const int8_t* )		{ return ElementType::INT8; }
+		static ElementType TypeOf( const int16_t* )		{ return ElementType::INT16; }
+		static ElementType TypeOf( const int32_t* )		{ return ElementType::INT32; }
+		static ElementType TypeOf( const int64_t* )		{ return ElementType::INT64; }
+		static ElementType TypeOf( const uint8_t* )		{ return ElementType::UINT8; }
+		static ElementType TypeOf( const uint16_t* )	{ return ElementType::UINT16; }
+		static ElementType TypeOf( const uint32_t* )	{ return ElementType::UINT32; }
+		static ElementType TypeOf( const uint64_t* )	{ return ElementType::UINT64; }
+		static ElementType TypeOf( const float* )		{ return ElementType::FLOAT; }
+		static ElementType TypeOf( const double* )		{ return ElementType::DOUBLE; }
+
 		/// Nodes build a leave oriented tree. Every leave either contains data or
 		/// a reference to the file where the data is written.
 		class Node
@@ -83,15 +479,165 @@ namespace Files {
 			MetaFileWrapper* m_file;
 			void* m_bufferArray;				///< Array data is buffered in its own memory block or m_buffer
 			uint8_t m_buffer[64];				///< Primitive non-array data is buffered in that 8 bytes
-			mutable uint64_t m_lastAccessed;	///< Array index last used in operator[int] for optimizations
+			uint64_t m_lastAccessed;			///< Array index last used in the non-const operator[int]
 			uint64_t m_numElements;				///< How many elements are in this array?
 			ElementType m_type;					///< Deduced type for this node.
-			std::string m_name;					///< Identifier of the node
+			NameId m_name;						///< Identifier of the node (interned in m_file)
+			char* m_strings;					///< Packed characters of all elements of a STRING node. m_bufferArray contains the end offset of each element.
+			uint64_t m_stringCapacity;			///< Allocated size of m_strings
+			uint64_t m_fileOffset;				///< Position of the SRAW header of a lazy node or of its child directory in m_file->m_source
+			mutable std::atomic<uint8_t> m_lazy;	///< Decoding state of a lazy node (LazyState)
+			bool m_inPlace;						///< m_bufferArray points into m_file->m_sourceMemory and is not owned
+			uint8_t m_dirty;					///< What changed since the last read, journal or compaction (DirtyFlags)
+			uint32_t m_shareGeneration;			///< m_bufferArray and m_strings are shared with the snapshot of this generation
+			bool m_readOnly;					///< Part of a subtree with several parents (DEDUPLICATE)
+			Node* m_parent;						///< The (first) parent or nullptr for the root
+			mutable std::atomic<uint64_t> m_hash;	///< Cached GetHash() or 0 if it is not known
+
+			/// \brief How much of a lazy node is decoded.
+			enum LazyState
+			{
+				DECODED,			///< Everything is in memory (children may still be HEADER_ONLY)
+				HEADER_ONLY,		///< Type, name and size are valid. The node owns no memory.
+				CHILDREN_PENDING	///< Child slots are nullptr until found in the directory.
+			};
+
+			/// \brief Changes which must be journaled.
+			enum DirtyFlags
+			{
+				DIRTY_SUBTREE = 1,		///< Type or content changed -> the whole subtree is recorded
+				DIRTY_CHILD_COUNT = 2,	///< Children were added to or removed from a NODE
+				DIRTY_NAME = 4			///< SetName()
+			};
+
+			/// \brief Record a change: set the dirty flags and forget the
+			///		cached hashes of the node and its ancestors.
+			void MarkDirty( uint8_t _flags )		{ m_dirty |= _flags; InvalidateHash(); }
+			void InvalidateHash();
+
+			/// \brief Reset the dirty flags of all decoded nodes.
+			void ClearDirty();
+
+			/// \brief Append the records of all changes in this subtree.
+			/// \param [in] _path Child indices from the root to this node.
+			void WriteJournalRecords( IFile& _journal, WriteFlags _flags, std::vector<uint64_t>& _path ) const;
+
+			/// \brief Replace the node by a SRAW block of a journal.
+			void ReplaceFromSraw( const IFile& _journal, int _srawFlags );
+
+			/// \brief Does the running background save use the buffers of
+			///		this node?
+			bool IsShared() const				{ return m_shareGeneration != 0 && m_shareGeneration == m_file->m_snapshotGeneration; }
+
+			/// \brief Hand the shared buffers over to the background save.
+			/// \param [in] _keepContent Continue with copies of the buffers.
+			///		Otherwise the node forgets them (destruction).
+			void Unshare( bool _keepContent );
+
+			/// \brief Throws if the node is part of a shared subtree.
+			void CheckWritable() const			{ if( m_readOnly ) throw "Node '" + *m_name + "' is part of a shared subtree and read-only."; }
+
+			/// \brief Mark the whole subtree read-only.
+			void SetReadOnly();
+
+			/// \brief Replace a child slot by an already read subtree if the
+			///		next block is a reference to it.
+			/// \return false if the block must be read normally.
+			bool ShareReference( const IFile& _file, Node*& _child );
+
+			/// \brief Compare the content of two subtrees without the names
+			///		of their roots.
+			bool SameContent( const Node& _other ) const;
+
+			/// \brief Recursive part of MetaFileWrapper::Diff().
+			/// \param [inout] _indices, _path The position of this node.
+			void Diff( const Node& _other, std::vector<uint64_t>& _indices, std::string& _path, std::vector<Difference>& _differences ) const;
+
+			/// \brief Destroy the content but keep the name and the position
+			///		in the tree.
+			void Clear();
+
+			/// \brief Remove a child from this node without destroying it.
+			void RemoveChild( const Node* _child );
+
+			/// \brief Recursive part of CopyFrom() for an empty node.
+			void CopySubtree( const Node& _source );
+			/// \brief Copy the elements of a data node into an empty node.
+			void CopyData( const Node& _source );
+			/// \brief Recursive part of Splice() for a node of an other
+			///		wrapper: take the arrays and strings of _source over.
+			void AdoptFrom( Node& _source );
+
+			/// \brief Build the snapshot of this subtree in another wrapper.
+			/// \details Arrays and strings are shared instead of copied.
+			void ShareInto( Node& _copy, uint32_t _generation );
 
 			void ParseJsonValue( const IFile& _file, char _fistNonWhite );	///< Recursive function to parse a value
 			void ParseJsonArray( const IFile& _file );	///< Recursive function to parse an array
 			void ParseJson( const IFile& _file );		///< Recursive function to parse an object
-			void ReadSraw( const IFile& _file );
+
+			/// \brief Parse the document with _parse (ParseMsgpack or
+			///		ParseCbor) from the buffer of the file or from a copy
+			///		of the rest of the file.
+			void ReadBinary( const IFile& _file, const uint8_t* (Node::*_parse)( const uint8_t*, const uint8_t* ) );
+
+			/// \brief Recursive parser of one value.
+			/// \return The position after the value.
+			const uint8_t* ParseMsgpack( const uint8_t* _data, const uint8_t* _end );
+			/// \brief Parse the elements of an array whose header was read.
+			const uint8_t* ParseMsgpackArray( const uint8_t* _data, const uint8_t* _end, uint64_t _numElements );
+			/// \brief Recursive part of SaveAsMsgpack().
+			void WriteMsgpack( MsgpackWriter& _out, WriteFlags _flags ) const;
+
+			/// \brief Recursive parser of one data item.
+			/// \return The position after the item.
+			const uint8_t* ParseCbor( const uint8_t* _data, const uint8_t* _end );
+			/// \brief Parse the elements of an array whose head was read.
+			const uint8_t* ParseCborArray( const uint8_t* _data, const uint8_t* _end, uint64_t _numElements );
+			/// \brief Copy or reference the payload of a RFC 8746 typed
+			///		array.
+			/// \param [in] _inSource The payload is part of the file buffer
+			///		and can be used IN_PLACE.
+			void ReadCborTypedArray( uint64_t _tag, const uint8_t* _payload, uint64_t _size, bool _inSource );
+			/// \brief Recursive part of SaveAsCbor().
+			void WriteCbor( CborWriter& _out ) const;
+
+			/// \brief Read a SRAW node recursively.
+			/// \param [in] _batch If not nullptr compressed arrays are
+			///		allocated and appended to the batch instead of being
+			///		decoded immediately. Large subtrees are skipped and
+			///		appended as well if the batch has a grain size.
+			void ReadSraw( const IFile& _file, bool _lazy, ReadBatch* _batch = nullptr );
+
+			/// \brief Read type, name and dimension of a SRAW node.
+			/// \param [in] _setName Set the name or skip it.
+			void ReadSrawHeader( const IFile& _file, BlockHeader& _header, bool _setName );
+
+			/// \brief Read the data block of a SRAW node whose header was
+			///		read.
+			/// \param [in] _position The position of the header.
+			void ReadSrawData( const IFile& _file, const BlockHeader& _header, uint64_t _position, bool _lazy, ReadBatch* _batch );
+
+			/// \brief Read only the header and skip the data block.
+			void SkipSraw( const IFile& _file );
+
+			/// \brief Decode the node if it was skipped by a lazy read.
+			void Resolve() const				{ if( m_lazy.load(std::memory_order_acquire) == HEADER_ONLY ) DecodeLazy(); }
+			void DecodeLazy() const;
+
+			/// \brief Create all child slots which were not yet looked up in
+			///		the directory.
+			void ResolveChildren() const		{ if( m_lazy.load(std::memory_order_acquire) == CHILDREN_PENDING ) DecodeDirectory(); }
+			void DecodeDirectory() const;
+
+			/// \brief Binary search in the child directory of a
+			///		CHILDREN_PENDING node. Creates the slot of the child.
+			/// \return The undecoded child or nullptr.
+			const Node* FindInDirectory( const std::string& _name ) const;
+
+			/// \brief Access a child of an intermediate node. The child is
+			///		decoded if necessary.
+			Node* Child( uint64_t _index ) const	{ ResolveChildren(); Node* child = ((Node**)m_bufferArray)[_index]; child->Resolve(); return child; }
 
 			/// \brief A node which is returned in case of an access to an
 			///		unknown element.
@@ -101,38 +647,143 @@ namespace Files {
 			///
 			Node( MetaFileWrapper* _wrapper, const std::string& _name );
 
+			/// \brief Creates a flat read-only view of a single element.
+			/// \details The view shares the data of _array and is never
+			///		destroyed.
+			Node( const Node& _array, uint64_t _index );
+
 			/// \brief Read in a node from file recursively.
 			/// \param [in] _wrapper The wrapper with the node pool.
 			/// \param [in]
-			Node( MetaFileWrapper* _wrapper, const IFile& _file, Format _format );
-			void Read( const IFile& _file, Format _format );
+			Node( MetaFileWrapper* _wrapper, const IFile& _file, Format _format, ReadFlags _flags );
+			void Read( const IFile& _file, Format _format, ReadFlags _flags );
 			friend class MetaFileWrapper;
+			friend class FrozenDocument;
 
-			/// \brief No node assignment.
-			/// \details If added some time: must be deep copy with setting the
-			///		correct wrapper parent...
+			/// \brief No node assignment. Use CopyFrom() for deep copies.
 			void operator = (const Node&);
 
 			/// \brief Recursive calculation of the size occupied in a sraw file.
+			/// \details SaveAsSraw() only uses this for STRING nodes. The
+			///		size of a NODE block is patched after its children are
+			///		written.
 			/// \param [opt] [out] _stringSize Returns the minimum required size to
 			///		store the length of all strings contained in a single string
 			///		node. The parameter is undefined for recursive calls.
+			/// \param [in] _flags The options of the SRAW writer.
+			/// \param [in] _position The file position of the data block.
+			///		Padding depends on it if the flags request an alignment.
 			/// \return The new size of this node and all its children if saved to file.
-			uint64_t GetDataSize( int* _stringSize = nullptr ) const;
+			uint64_t GetDataSize( int* _stringSize = nullptr, WriteFlags _flags = 0, uint64_t _position = 0 ) const;
+
+			/// \brief Size of the SRAW header (type, name, NELEMS and SIZE).
+			uint64_t GetHeaderSize() const;
+
+			/// \brief Upper bounds of the NODE data sizes for VARINT_SIZES.
+			/// \param [out] _bounds The bound of each NODE block.
+			/// \return Upper bound of the size of the whole block.
+			uint64_t GetSizeBounds( WriteFlags _flags, std::unordered_map<const Node*, uint64_t>& _bounds ) const;
+
+			/// \brief Recursive part of SaveAsSraw().
+			void WriteSraw( IFile& _file, WriteFlags _flags, SrawWriteState& _state ) const;
+
+			/// \brief Copy an IN_PLACE or shared array into own memory
+			///		before it is changed.
+			void MakeWritable();
+
+			/// \brief Prepare an element write: arrays of a WRITE_THROUGH
+			///		read stay in the source file unless a snapshot uses them.
+			void MakeElementsWritable()			{ if( !IsWrittenThrough() || IsShared() || m_readOnly ) MakeWritable(); }
+
+			/// \brief Replace the characters of a single string element.
+			/// \details Moves the characters of all subsequent elements. This
+			///		is cheap if _index is the last element (appending).
+			void SetString( uint64_t _index, const char* _data, uint64_t _length );
+
+			/// \brief Unchecked element access without using m_lastAccessed.
+			template<typename T> T Element( uint64_t _index ) const	{ return reinterpret_cast<const T*>(m_bufferArray)[_index]; }
+			bool BitElement( uint64_t _index ) const	{ return (reinterpret_cast<const uint8_t*>(m_bufferArray)[_index/8] & (1 << (_index & 0x7))) != 0; }
+			/// \brief Element access which converts from an other numeric
+			///		type like a static_cast.
+			/// \throws std::string if the node is not numeric.
+			template<typename T> T ConvertedElement( uint64_t _index ) const
+			{
+				if( m_type == TypeOf((const T*)nullptr) ) return Element<T>(_index);
+				T value;
+				CopyTo( &value, _index, 1 );
+				return value;
+			}
+
+			/// \brief Implementation of the safe access methods Get() for an
+			///		arbitrary element.
+			float GetAt( uint64_t _index, float _default ) const;
+			double GetAt( uint64_t _index, double _default ) const;
+			int8_t GetAt( uint64_t _index, int8_t _default ) const;
+			uint8_t GetAt( uint64_t _index, uint8_t _default ) const;
+			int16_t GetAt( uint64_t _index, int16_t _default ) const;
+			uint16_t GetAt( uint64_t _index, uint16_t _default ) const;
+			int32_t GetAt( uint64_t _index, int32_t _default ) const;
+			uint32_t GetAt( uint64_t _index, uint32_t _default ) const;
+			int64_t GetAt( uint64_t _index, int64_t _default ) const;
+			uint64_t GetAt( uint64_t _index, uint64_t _default ) const;
+			bool GetAt( uint64_t _index, bool _default ) const	{ if(m_type == ElementType::BIT) return BitElement(_index); return _default; }
+
+			/// \brief Throws if the elements are not of type _type.
+			void CheckSpanType( ElementType _type ) const;
 
 			Node( const Node& );
 		public:
 			void SaveAsJson( IFile& _file, int _indent=0 ) const;
-			void SaveAsSraw( IFile& _file ) const;
+			void SaveAsSraw( IFile& _file, WriteFlags _flags = 0 ) const;
+			void SaveAsMsgpack( IFile& _file, WriteFlags _flags = 0 ) const;
+			void SaveAsCbor( IFile& _file ) const;
 
 			/// \brief Recursive destruction. Assumes all children in the NodePool.
 			///
 			~Node();
 
 			uint64_t Size() const				{ return m_numElements; }
-			std::string GetName() const			{ return m_name; }
+			const std::string& GetName() const	{ return *m_name; }
 			ElementType GetType() const			{ return m_type; }
 
+			/// \brief Do element assignments change the source file of a
+			///		WRITE_THROUGH read?
+			/// \details False for everything else and after a structural
+			///		change of the node.
+			bool IsWrittenThrough() const		{ return m_inPlace && m_file->m_writeThrough; }
+
+			/// \brief Is this node part of a subtree which several parents
+			///		share after reading a DEDUPLICATE file?
+			/// \details All changes of a read-only node throw. Navigating
+			///		into existing children is allowed.
+			bool IsReadOnly() const				{ return m_readOnly; }
+
+			/// \brief Was this node changed since the last read, journal or
+			///		compaction?
+			/// \details Set by assignments, Resize, Add, SetName and the
+			///		non-constant GetData(). Changes of children only mark the
+			///		children.
+			bool IsDirty() const				{ return m_dirty != 0; }
+
+			/// \brief Content hash of the subtree (Merkle tree).
+			/// \details Covers the types, the elements and the names of all
+			///		descendants but not the own name. Each node keeps its
+			///		hash until it or a descendant is changed, so hashing an
+			///		edited document only visits the changed nodes and their
+			///		ancestors. Lazy nodes are decoded. Hashes depend on the
+			///		byte order of the host.
+			///
+			///		Writes through a pointer from GetData() or AsSpan() are
+			///		not noticed once the hash is known. Call GetData()
+			///		again before such writes.
+			uint64_t GetHash() const;
+
+			/// \brief Compare two subtrees by their hashes.
+			/// \details The names of both roots are ignored. Two different
+			///		subtrees have the same 64 bit hash with a negligible
+			///		chance only.
+			bool Equals( const Node& _other ) const	{ return GetHash() == _other.GetHash(); }
+
 			/// \brief Set the nodes name. This might influence internal search structures.
 			void SetName( const std::string& _name );
 
@@ -152,35 +803,43 @@ namespace Files {
 			///		node is array data or an intermediate node the cast will
 			///		return the last indexed element.
 			///		
-			///		Make sure the node is of the assumed data type manually.
-			///		These methods are designed for fast access. Use Get() to
-			///		get implicit casting.
-			operator float() const				{ return reinterpret_cast<const float*>(m_bufferArray)[m_lastAccessed]; }
+			///		Elements of an other numeric type are converted like a
+			///		static_cast, e.g. integer arrays which were written with
+			///		NARROW_INTEGERS. Other node types throw. Use Get() for a
+			///		default value instead.
+			/// \throws std::string
+			operator float() const				{ return ConvertedElement<float>(m_lastAccessed); }
 
 			/// \brief Casts the node data into double.
 			/// \details \see{operator float()}
-			operator double() const				{ return reinterpret_cast<const double*>(m_bufferArray)[m_lastAccessed]; }
+			operator double() const				{ return ConvertedElement<double>(m_lastAccessed); }
 
 			/// \brief Casts the node data into signed byte.
 			/// \details \see{operator float()}
-			operator int8_t() const				{ return reinterpret_cast<const int8_t*>(m_bufferArray)[m_lastAccessed]; }
+			operator int8_t() const				{ return ConvertedElement<int8_t>(m_lastAccessed); }
 
 			/// \brief Casts the node data into unsigned byte.
 			/// \details \see{operator float()}
-			operator uint8_t() const			{ return reinterpret_cast<const uint8_t*>(m_bufferArray)[m_lastAccessed]; }
+			operator uint8_t() const			{ return ConvertedElement<uint8_t>(m_lastAccessed); }
 
-			operator int16_t() const			{ return reinterpret_cast<const int16_t*>(m_bufferArray)[m_lastAccessed]; }
-			operator uint16_t() const			{ return reinterpret_cast<const uint16_t*>(m_bufferArray)[m_lastAccessed]; }
-			operator int32_t() const			{ return reinterpret_cast<const int32_t*>(m_bufferArray)[m_lastAccessed]; }
-			operator uint32_t() const			{ return reinterpret_cast<const uint32_t*>(m_bufferArray)[m_lastAccessed]; }
-			operator int64_t() const			{ return reinterpret_cast<const int64_t*>(m_bufferArray)[m_lastAccessed]; }
-			operator uint64_t() const			{ return reinterpret_cast<const uint64_t*>(m_bufferArray)[m_lastAccessed]; }
-			operator bool() const				{ return (reinterpret_cast<const uint8_t*>(m_bufferArray)[m_lastAccessed/8] & (1 << (m_lastAccessed & 0x7))) != 0; }
+			operator int16_t() const			{ return ConvertedElement<int16_t>(m_lastAccessed); }
+			operator uint16_t() const			{ return ConvertedElement<uint16_t>(m_lastAccessed); }
+			operator int32_t() const			{ return ConvertedElement<int32_t>(m_lastAccessed); }
+			operator uint32_t() const			{ return ConvertedElement<uint32_t>(m_lastAccessed); }
+			operator int64_t() const			{ return ConvertedElement<int64_t>(m_lastAccessed); }
+			operator uint64_t() const			{ return ConvertedElement<uint64_t>(m_lastAccessed); }
+			operator bool() const				{ return BitElement(m_lastAccessed); }
 
 			/// \brief Casts the node data into string.
 			/// \details \see{operator float()}
 			operator std::string() const;
 
+			/// \brief Access a string element without copying it.
+			/// \details All elements of a string node are stored in one
+			///		contiguous block.
+			/// \throws std::string
+			StringView GetStringView( uint64_t _index ) const;
+
 			/// \brief Read in a single value/child node by name.
 			/// \details This method fails for data nodes
 			/// \throws std::string
@@ -193,6 +852,15 @@ namespace Files {
 			///
 			///		Accessing more than one time the same index will always
 			///		cause a reread - store the value somewhere!
+			///
+			///		For data nodes the constant variant only remains for
+			///		compatibility. Use At() instead, which returns the element
+			///		by value and has no lifetime rules. The returned node is a
+			///		temporary view of the element owned by the calling thread.
+			///		Like the node of the non-constant variant it shows the
+			///		element of the latest access as long as the thread keeps
+			///		accessing the same array. Otherwise it is valid for the
+			///		next 15 index accesses of that thread.
 			/// \throws std::string
 			Node& operator[]( uint64_t _index );
 			const Node& operator[]( uint64_t _index ) const;
@@ -200,13 +868,126 @@ namespace Files {
 			/// \brief Gives direct read / write access to the buffered data.
 			/// \details This fails if this is a data node (Type==NODE) or a
 			///		string node.
+			///		The constant variant of an IN_PLACE read node points
+			///		directly into the source file. The non-constant one as
+			///		well if IsWrittenThrough().
 			/// \throws std::string
 			void* GetData();
+			const void* GetData() const;
+
+			/// \brief Typed direct access to the elements without copying.
+			/// \details T must match the stored element type exactly. Use
+			///		CopyTo() for converting access.
+			/// \throws std::string
+			template<typename T> Span<T> AsSpan()
+			{
+				CheckSpanType( TypeOf((const T*)nullptr) );
+				Span<T> span = { (T*)GetData(), m_numElements };
+				return span;
+			}
+			template<typename T> Span<const T> AsSpan() const
+			{
+				CheckSpanType( TypeOf((const T*)nullptr) );
+				Span<const T> span = { (const T*)m_bufferArray, m_numElements };
+				return span;
+			}
+
+			/// \brief Iterate the elements of a BIT or STRING array.
+			/// \details Like AsSpan() for numeric arrays. The ranges become
+			///		invalid if the node is changed.
+			/// \throws std::string
+			Range<BitIterator> AsBits() const
+			{
+				CheckSpanType( ElementType::BIT );
+				Range<BitIterator> range = { BitIterator( m_bufferArray, 0 ), BitIterator( m_bufferArray, m_numElements ) };
+				return range;
+			}
+			Range<StringIterator> AsStrings() const
+			{
+				CheckSpanType( ElementType::STRING );
+				const uint64_t* ends = (const uint64_t*)m_bufferArray;
+				Range<StringIterator> range = { StringIterator( m_strings, ends, 0 ), StringIterator( m_strings, ends + m_numElements, 0 ) };
+				return range;
+			}
+
+			/// \brief One child during an iteration with Children().
+			template<typename N> struct ChildEntry
+			{
+				const std::string& name;
+				N& node;
+			};
+
+			/// \brief Iterates the children of a NODE without bounds checks.
+			template<typename N> class ChildIterator
+			{
+				N* const* m_child;
+			public:
+				typedef std::input_iterator_tag iterator_category;
+				typedef ChildEntry<N> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const ChildEntry<N>* pointer;
+				typedef ChildEntry<N> reference;
+
+				/// \param [in] _end Create the end instead of the begin.
+				ChildIterator( const Node& _parent, bool _end ) : m_child(nullptr)
+				{
+					// Data nodes have no children
+					if( _parent.m_type != ElementType::NODE ) return;
+					_parent.ResolveChildren();
+					m_child = (N* const*)_parent.m_bufferArray + (_end ? _parent.m_numElements : 0);
+				}
+
+				ChildEntry<N> operator*() const
+				{
+					N& child = **m_child;
+					child.Resolve();
+					ChildEntry<N> entry = { child.GetName(), child };
+					return entry;
+				}
+				ChildIterator& operator++()			{ ++m_child; return *this; }
+				ChildIterator operator++(int)		{ ChildIterator old = *this; ++m_child; return old; }
+				bool operator==( const ChildIterator& _other ) const	{ return m_child == _other.m_child; }
+				bool operator!=( const ChildIterator& _other ) const	{ return m_child != _other.m_child; }
+			};
+
+			/// \brief Range-based access to the children of a NODE:
+			///		for( auto child : node.Children() ) child.name, child.node
+			/// \details Lazy children are decoded on access like with the
+			///		index operator. The range is empty for data nodes and
+			///		becomes invalid if children are added or removed.
+			Range<ChildIterator<Node>> Children()
+			{
+				Range<ChildIterator<Node>> range = { ChildIterator<Node>( *this, false ), ChildIterator<Node>( *this, true ) };
+				return range;
+			}
+			Range<ChildIterator<const Node>> Children() const
+			{
+				Range<ChildIterator<const Node>> range = { ChildIterator<const Node>( *this, false ), ChildIterator<const Node>( *this, true ) };
+				return range;
+			}
+
+			/// \brief Convert a range of elements into an other numeric type.
+			/// \details Works for all INTx, UINTx, FLOAT and DOUBLE nodes. The
+			///		values are converted like a static_cast. Common widening
+			///		conversions (e.g. INT16 -> float) use SIMD kernels.
+			/// \param [out] _dst Target memory for _count elements of type T.
+			/// \param [in] _first Index of the first element to convert.
+			/// \param [in] _count Number of elements to convert.
+			/// \throws std::string
+			template<typename T> void CopyTo( T* _dst, uint64_t _first, uint64_t _count ) const
+			{
+				CopyTo( _dst, TypeOf((const T*)nullptr), _first, _count );
+			}
+			void CopyTo( void* _dst, ElementType _dstType, uint64_t _first, uint64_t _count ) const;
 
 			/// \brief Sets the node type if unknown and the new value.
-			/// \details The assignment fails if the type is incompatible. It
-			///		is only allowed to upcast values. so assigning an int8 to
-			///		an int16 or greater is perfectly valid.
+			/// \details The assignment fails if the type is incompatible.
+			///		Integers can be assigned to elements of any integer type
+			///		if the value fits into it, e.g. to arrays which were
+			///		written with NARROW_INTEGERS. The value is converted and
+			///		only the element itself is written.
+			/// \throws std::string if the type is incompatible or the value
+			///		does not fit.
 			float operator = (float _val);
 			double operator = (double _val);
 			int8_t operator = (int8_t _val);
@@ -237,23 +1018,71 @@ namespace Files {
 			bool HasChild( const std::string& _name, const Node** _child = nullptr ) const;
 			bool HasChild( const std::string& _name, Node** _child = nullptr );
 
+			/// \brief Move a subtree to the end of the children of this node.
+			/// \details _child is removed from its parent and keeps its name.
+			///		Within one wrapper only the pointer to _child moves, so the
+			///		cost does not depend on the size of the subtree. A child
+			///		of an other wrapper is rebuilt from new nodes which take
+			///		its arrays and strings over without copying them. Arrays
+			///		which are IN_PLACE, read-only or used by a background
+			///		save are copied. The root of an other wrapper can be
+			///		moved as well and leaves an empty root.
+			///
+			///		Removing other than the last child of a node records the
+			///		whole old parent in the next journal.
+			/// \return The moved node. Within one wrapper this is _child.
+			/// \throws std::string
+			Node& Splice( Node& _child );
+
+			/// \brief Replace the content of this node by a deep copy of
+			///		_source.
+			/// \details _source can belong to any wrapper. This node keeps
+			///		its name. Each array and string block is copied at once.
+			/// \throws std::string if one node contains the other.
+			void CopyFrom( const Node& _source );
+
 			/// \brief Safer access methods with user defined default values.
 			/// \details Following casts are silently accepted. Otherwise the
 			///		default value is returned.
 			///		float <-> double
 			///		uint <-> int
 			///		(u)intX -> (u)intY with X < Y
-			float Get( float _default ) const;
-			double Get( double _default ) const;
-			int8_t Get( int8_t _default ) const;
-			uint8_t Get( uint8_t _default ) const;
-			int16_t Get( int16_t _default ) const;
-			uint16_t Get( uint16_t _default ) const;
-			int32_t Get( int32_t _default ) const;
-			uint32_t Get( uint32_t _default ) const;
-			int64_t Get( int64_t _default ) const;
-			uint64_t Get( uint64_t _default ) const;
-			bool Get( bool _default ) const			{ if(m_type == ElementType::BIT) return *this; return _default; }
+			template<typename T> T Get( T _default ) const	{ return GetAt( m_lastAccessed, _default ); }
+
+			/// \brief A lightweight reference to one element of a data node.
+			/// \details Reading through an ElementRef never changes the node.
+			///		Unlike the index operator it is therefore safe to use it
+			///		on a shared node from many threads.
+			class ElementRef
+			{
+				const Node* m_node;
+				uint64_t m_index;
+			public:
+				ElementRef( const Node* _node, uint64_t _index ) : m_node(_node), m_index(_index)	{}
+
+				/// \brief Casts. \see{Node::operator float()}
+				operator float() const			{ return m_node->ConvertedElement<float>(m_index); }
+				operator double() const			{ return m_node->ConvertedElement<double>(m_index); }
+				operator int8_t() const			{ return m_node->ConvertedElement<int8_t>(m_index); }
+				operator uint8_t() const		{ return m_node->ConvertedElement<uint8_t>(m_index); }
+				operator int16_t() const		{ return m_node->ConvertedElement<int16_t>(m_index); }
+				operator uint16_t() const		{ return m_node->ConvertedElement<uint16_t>(m_index); }
+				operator int32_t() const		{ return m_node->ConvertedElement<int32_t>(m_index); }
+				operator uint32_t() const		{ return m_node->ConvertedElement<uint32_t>(m_index); }
+				operator int64_t() const		{ return m_node->ConvertedElement<int64_t>(m_index); }
+				operator uint64_t() const		{ return m_node->ConvertedElement<uint64_t>(m_index); }
+				operator bool() const			{ return m_node->BitElement(m_index); }
+				operator std::string() const	{ return m_node->GetStringView(m_index); }
+
+				/// \brief Access with implicit casting. \see{Node::Get()}
+				template<typename T> T Get( T _default ) const	{ return m_node->GetAt( m_index, _default ); }
+			};
+
+			/// \brief Reference a single element of a data node.
+			/// \details In contrast to the const operator[] this does not
+			///		involve any copies.
+			/// \throws std::string
+			ElementRef At( uint64_t _index ) const;
 
 			/// \brief Short to test if this node contains a string(-array)
 			bool IsString() const	{ return m_type == ElementType::STRING; }
@@ -267,6 +1096,114 @@ namespace Files {
 
 		Node RootNode;
 
+	private:
+		/// \brief Compress the payload of a numeric or BIT array.
+		/// \param [out] _encoded The compressed payload.
+		/// \return The codec or 0 if the array should be stored raw.
+		static uint8_t EncodeArray( ElementType _type, const void* _data, uint64_t _numElements, std::vector<uint8_t>& _encoded );
+
+		/// \brief Smallest integer type which holds all elements of an
+		///		integer array (NARROW_INTEGERS).
+		/// \return _type for other arrays or if no smaller type fits.
+		static ElementType NarrowestType( ElementType _type, const void* _data, uint64_t _numElements );
+
+		/// \brief Decompress an array payload.
+		/// \param [out] _data Memory for all _numElements elements.
+		/// \param [in] _swap The array was compressed on a host with the
+		///		other byte order.
+		/// \throws std::string if the data is corrupted.
+		static void DecodeArray( uint8_t _codec, ElementType _type, const uint8_t* _encoded, uint64_t _encodedSize, void* _data, uint64_t _numElements, bool _swap );
+
+		/// \brief A compressed array which was read but not decoded yet.
+		struct PendingArray
+		{
+			Node* node;
+			uint8_t codec;
+			std::vector<uint8_t> encoded;
+		};
+
+		/// \brief Decode all pending arrays distributed over several
+		///		threads.
+		static void DecodePending( std::vector<PendingArray>& _pending );
+
+		/// \brief A skipped subtree of a parallel read.
+		struct SubtreeTask
+		{
+			Node* node;
+			uint64_t position;		///< Position of the SRAW header
+			uint64_t size;			///< Size of the data block
+		};
+
+		/// \brief Work which is deferred while a SRAW file is scanned.
+		struct ReadBatch
+		{
+			std::vector<PendingArray> arrays;
+			std::vector<SubtreeTask> subtrees;
+			/// \brief Blocks larger than this are split into their
+			///		children. 0 disables the subtree tasks.
+			uint64_t grain;
+		};
+
+		friend class StructReader;
+		/// \brief Type, dimension and payload size of a SRAW block.
+		struct BlockHeader
+		{
+			ElementType type;
+			int stringSize;			///< Size of the length prefixes of a STRING block
+			uint64_t numElements;
+			uint64_t dataSize;		///< Size of the data block following the header
+			uint8_t codec;			///< Codec of a compressed array or 0
+			uint64_t directorySize;	///< Size of the child directory at the start of a NODE data block
+			uint64_t reference;		///< Distance back to the NODE block of a reference or 0
+		};
+
+		/// \brief Move to the data block of the NODE which a reference
+		///		points to.
+		/// \param [in] _position Position of the header of the reference.
+		/// \param [inout] _header The header of the reference. Replaced by
+		///		the header of the referenced block.
+		/// \throws std::string if the reference is invalid.
+		static void FollowReference( const IFile& _file, int _srawFlags, uint64_t _position, BlockHeader& _header );
+
+		/// \brief Precomputed data of a SaveAsSraw() call.
+		struct SrawWriteState
+		{
+			std::unordered_map<const Node*, uint64_t> sizeBounds;	///< VARINT_SIZES
+			/// \brief Position of each NODE block which was written by the
+			///		hash of its content.
+			std::unordered_multimap<uint64_t, std::pair<const Node*, uint64_t>> written;
+		};
+
+		/// \brief Read CodeNType, name, NELEMS and SIZE of a block and skip
+		///		the padding of aligned arrays.
+		/// \param [out] _name The identifier or nullptr to skip it.
+		static void ReadBlockHeader( const IFile& _file, int _srawFlags, BlockHeader& _header, std::string* _name );
+
+		/// \brief Read the payload of a numeric or BIT array.
+		/// \details Compressed and foreign arrays are decoded directly.
+		/// \param [out] _data Memory for all elements.
+		static void ReadArrayPayload( const IFile& _file, int _srawFlags, const BlockHeader& _header, void* _data );
+
+		/// \brief Remove the length prefixes of a STRING payload in place.
+		/// \param [out] _ends The end offset of each element.
+		static void UnpackStrings( char* _data, const BlockHeader& _header, int _srawFlags, uint64_t* _ends );
+
+		/// \brief Convert numeric elements like a static_cast.
+		static void ConvertElements( const void* _src, ElementType _srcType, void* _dst, ElementType _dstType, uint64_t _num );
+
+		/// \brief Reverse the byte order of each element.
+		/// \details _src and _dst may be equal. Elements which are not 2, 4
+		///		or 8 bytes large are copied.
+		static void SwapBytes( const void* _src, void* _dst, uint64_t _num, int _elementSize );
+
+		/// \brief Read an array of foreign byte order.
+		static void ReadSwapped( const IFile& _file, void* _dst, uint64_t _num, int _elementSize );
+
+		/// \brief Read all skipped subtrees with several threads.
+		/// \param [in] _memory The buffer of the file.
+		void ReadSubtrees( const void* _memory, uint64_t _size, std::vector<SubtreeTask>& _tasks );
+
+	public:
 		/// \brief Direct access to the root node. See Node::operator[] for
 		///		more details.
 		Node& operator[]( const std::string& _name )				{ return RootNode[_name]; }
@@ -278,5 +1215,47 @@ namespace Files {
 		const Node& operator[]( uint64_t _index ) const				{ return RootNode[_index]; }
 	};
 
+	/**************************************************************************//**
+	 * \class	Jo::Files::BackgroundSave
+	 * \brief	A MetaFileWrapper::SaveInBackground() in progress.
+	 *****************************************************************************/
+	class BackgroundSave
+	{
+	public:
+		/// \brief Waits until the save is done.
+		~BackgroundSave();
+
+		/// \brief Fraction of the file which is written (0 to 1).
+		/// \details Estimated from the size of the snapshot as uncompressed
+		///		SRAW, so the value grows unevenly for JSON and COMPRESS. It
+		///		reaches 1 when the save is done.
+		float GetProgress() const;
+
+		/// \brief Is the file written and the completion callback done?
+		bool IsDone() const						{ return m_done.load(std::memory_order_acquire); }
+
+		/// \brief Block until the save is done.
+		void Wait();
+
+		/// \brief Error message of a failed save or empty. Valid after
+		///		IsDone() or Wait().
+		const std::string& GetError() const		{ return m_error; }
+
+	private:
+		friend class MetaFileWrapper;
+		BackgroundSave();
+		// Copying not allowed.
+		void operator = (const BackgroundSave&);
+		BackgroundSave(const BackgroundSave&);
+
+		MetaFileWrapper* m_snapshot;			///< Owned. Deleted as soon as it is written.
+		std::shared_ptr<MetaFileWrapper::SnapshotShare> m_share;
+		std::atomic<uint64_t> m_written;		///< Bytes written so far
+		std::atomic<uint64_t> m_estimate;		///< Expected file size or 0 if not known yet
+		std::atomic<bool> m_done;
+		std::string m_error;
+		std::thread m_thread;
+	};
+
 } // namespace Files
 } // namespace Jo
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "filewrapper.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	/**************************************************************************//**
+	 * \class	Jo::Files::FrozenDocument
+	 * \brief	An immutable document stored in one contiguous block (tape).
+	 * \details	The nodes are laid out in pre-order. Each entry has a type tag,
+	 *			the name id, the number of elements and the size of its
+	 *			subtree, followed by the payload: the offsets of the children
+	 *			of a NODE or the elements of an array inline. Traversal only
+	 *			touches this block and the whole document is a single
+	 *			allocation.
+	 *
+	 *			The tape is written as it is in memory and can be mapped back
+	 *			without any parsing:
+	 *
+	 *			auto frozen = wrapper.Freeze();
+	 *			frozen->Write( file );
+	 *			...
+	 *			MappedFile mapping( "document.tape" );
+	 *			FrozenDocument document( mapping );
+	 *			float x = document[std::string("position")][0];
+	 *
+	 *			Tapes use the byte order of the host which wrote them. All
+	 *			methods can be called from many threads at once.
+	 *****************************************************************************/
+	class FrozenDocument
+	{
+		/// \brief Header of a tape entry. The payload follows directly.
+		struct Entry
+		{
+			uint8_t type;			///< MetaFileWrapper::ElementType
+			uint8_t reserved[3];
+			uint32_t name;			///< Index in m_names
+			uint64_t numElements;
+			uint64_t size;			///< Size of the entry and its subtree in bytes
+		};
+
+	public:
+		typedef MetaFileWrapper::ElementType ElementType;
+
+		/// \brief A read-only reference to one entry of the tape.
+		/// \details Handles are small values which stay valid as long as
+		///		the document exists. The methods mirror
+		///		MetaFileWrapper::Node.
+		class Node
+		{
+			const FrozenDocument* m_document;
+			const Entry* m_entry;
+			uint64_t m_lastAccessed;		///< Element of a data node used by the casts
+
+			Node( const FrozenDocument* _document, const Entry* _entry, uint64_t _index = 0 ) :
+				m_document( _document ), m_entry( _entry ), m_lastAccessed( _index )	{}
+			friend class FrozenDocument;
+
+			const void* Payload() const		{ return m_entry + 1; }
+			template<typename T> T Element( uint64_t _index ) const	{ return reinterpret_cast<const T*>(Payload())[_index]; }
+			bool BitElement( uint64_t _index ) const	{ return (reinterpret_cast<const uint8_t*>(Payload())[_index/8] & (1 << (_index & 0x7))) != 0; }
+
+			/// \brief Implementation of Get() with the conversion rules of
+			///		MetaFileWrapper::Node::Get().
+			float GetAt( uint64_t _index, float _default ) const;
+			double GetAt( uint64_t _index, double _default ) const;
+			int8_t GetAt( uint64_t _index, int8_t _default ) const;
+			uint8_t GetAt( uint64_t _index, uint8_t _default ) const;
+			int16_t GetAt( uint64_t _index, int16_t _default ) const;
+			uint16_t GetAt( uint64_t _index, uint16_t _default ) const;
+			int32_t GetAt( uint64_t _index, int32_t _default ) const;
+			uint32_t GetAt( uint64_t _index, uint32_t _default ) const;
+			int64_t GetAt( uint64_t _index, int64_t _default ) const;
+			uint64_t GetAt( uint64_t _index, uint64_t _default ) const;
+			bool GetAt( uint64_t _index, bool _default ) const	{ if(GetType() == ElementType::BIT) return BitElement(_index); return _default; }
+
+			/// \brief Throws if the elements are not of type _type.
+			void CheckSpanType( ElementType _type ) const;
+
+		public:
+			uint64_t Size() const				{ return m_entry->numElements; }
+			const std::string& GetName() const;
+			ElementType GetType() const			{ return ElementType(m_entry->type); }
+
+			/// \brief Unchecked casts of the last indexed element.
+			/// \details \see{MetaFileWrapper::Node::operator float()}
+			operator float() const				{ return Element<float>(m_lastAccessed); }
+			operator double() const				{ return Element<double>(m_lastAccessed); }
+			operator int8_t() const				{ return Element<int8_t>(m_lastAccessed); }
+			operator uint8_t() const			{ return Element<uint8_t>(m_lastAccessed); }
+			operator int16_t() const			{ return Element<int16_t>(m_lastAccessed); }
+			operator uint16_t() const			{ return Element<uint16_t>(m_lastAccessed); }
+			operator int32_t() const			{ return Element<int32_t>(m_lastAccessed); }
+			operator uint32_t() const			{ return Element<uint32_t>(m_lastAccessed); }
+			operator int64_t() const			{ return Element<int64_t>(m_lastAccessed); }
+			operator uint64_t() const			{ return Element<uint64_t>(m_lastAccessed); }
+			operator bool() const				{ return BitElement(m_lastAccessed); }
+			operator std::string() const		{ return GetStringView(m_lastAccessed); }
+
+			/// \brief Access a string element without copying it.
+			/// \throws std::string
+			MetaFileWrapper::StringView GetStringView( uint64_t _index ) const;
+
+			/// \brief Find a child by name.
+			/// \return An UNKNOWN node if there is no such child.
+			/// \throws std::string for data nodes.
+			Node operator[]( const std::string& _name ) const;
+
+			/// \brief A child of a NODE or an element of a data node.
+			/// \throws std::string
+			Node operator[]( uint64_t _index ) const;
+
+			/// \brief Ask for a child without an UNKNOWN fallback.
+			/// \param [opt] [out] _child Set to the child if it is found.
+			bool HasChild( const std::string& _name, Node* _child = nullptr ) const;
+
+			/// \brief The elements of a numeric or BIT array in the tape.
+			/// \throws std::string
+			const void* GetData() const;
+
+			/// \brief Typed access to the elements without copying.
+			/// \throws std::string
+			template<typename T> MetaFileWrapper::Span<const T> AsSpan() const
+			{
+				CheckSpanType( MetaFileWrapper::TypeOf((const T*)nullptr) );
+				MetaFileWrapper::Span<const T> span = { (const T*)Payload(), Size() };
+				return span;
+			}
+
+			/// \brief Convert a range of elements into an other numeric type.
+			/// \details \see{MetaFileWrapper::Node::CopyTo()}
+			/// \throws std::string
+			template<typename T> void CopyTo( T* _dst, uint64_t _first, uint64_t _count ) const
+			{
+				CopyTo( _dst, MetaFileWrapper::TypeOf((const T*)nullptr), _first, _count );
+			}
+			void CopyTo( void* _dst, ElementType _dstType, uint64_t _first, uint64_t _count ) const;
+
+			/// \brief Access with implicit casting.
+			/// \details \see{MetaFileWrapper::Node::Get()}
+			template<typename T> T Get( T _default ) const	{ return GetAt( m_lastAccessed, _default ); }
+
+			bool IsString() const	{ return GetType() == ElementType::STRING; }
+			bool IsInt() const	{ return GetType() <= ElementType::INT64 && GetType() >= ElementType::INT8; }
+			bool IsUnsignedInt() const	{ return GetType() <= ElementType::UINT64 && GetType() >= ElementType::UINT8; }
+			bool IsFloat() const	{ return GetType() == ElementType::FLOAT || GetType() == ElementType::DOUBLE; }
+		};
+
+		/// \brief Flatten a document into a new tape.
+		/// \details Lazy nodes of the wrapper are decoded.
+		explicit FrozenDocument( const MetaFileWrapper& _wrapper );
+
+		/// \brief Use a tape which was written with Write().
+		/// \details Reads from the current position of the file. If the file
+		///		has a buffer (MemFile, MappedFile) the tape is used in place
+		///		and the file must stay valid and unchanged as long as the
+		///		document exists. Otherwise it is read into one allocation.
+		/// \throws std::string if the file is no valid tape of this host.
+		explicit FrozenDocument( const IFile& _file );
+
+		~FrozenDocument();
+
+		/// \brief Write the tape unchanged.
+		void Write( IFile& _file ) const;
+
+		/// \brief Size of the tape in bytes.
+		uint64_t GetSize() const;
+
+		/// \brief The root of the document.
+		Node Root() const								{ return Node( this, m_root ); }
+		Node operator[]( const std::string& _name ) const	{ return Root()[_name]; }
+		Node operator[]( uint64_t _index ) const		{ return Root()[_index]; }
+
+	private:
+		// Copying not allowed.
+		void operator = (const FrozenDocument&);
+		FrozenDocument(const FrozenDocument&);
+
+		/// \brief Id of each name in the tape.
+		typedef std::unordered_map<const std::string*, uint32_t> NameIndex;
+
+		/// \brief Size of a subtree in the tape. Registers all names.
+		static uint64_t Measure( const MetaFileWrapper::Node& _node, NameIndex& _names );
+
+		/// \brief Write a subtree into the tape.
+		/// \return The end of the subtree.
+		static uint8_t* Flatten( const MetaFileWrapper::Node& _node, uint8_t* _entry, const NameIndex& _names );
+
+		/// \brief Read the name table and check the entries.
+		void Open();
+
+		/// \brief Check that a subtree lies within its parent.
+		void Validate( const Entry* _entry, uint64_t _available ) const;
+
+		const uint8_t* m_tape;		///< File header and all entries
+		void* m_memory;				///< Owned tape or nullptr for a mapped one
+		const Entry* m_root;
+		std::vector<std::string> m_names;	///< Sorted, the index is the name id
+
+		/// \brief The entry of missing children followed by a zero
+		///		payload.
+		static const Entry UndefinedEntry[2];
+	};
+
+} // namespace Files
+} // namespace Jo
@@ -21,7 +21,9 @@ namespace Files {
 		SRAW,
 		PNG,
 		PFM,		///< Portable float map
-		TGA
+		TGA,
+		MSGPACK,	///< MessagePack
+		CBOR		///< RFC 8949 with RFC 8746 typed arrays
 	};
 } // namespace Files
 } // namespace Jo
@@ -29,7 +31,11 @@ namespace Files {
 #include "file.hpp"
 #include "memfile.hpp"
 #include "hddfile.hpp"
+#include "mappedfile.hpp"
 #include "filewrapper.hpp"
+#include "srawwriter.hpp"
+#include "frozendocument.hpp"
+#include "binding.hpp"
 #include "imagewrapper.hpp"
 #include "fileutils.hpp"
 #include "streamreader.hpp"
\ No newline at end of file
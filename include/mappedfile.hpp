@@ -0,0 +1,63 @@
+#pragma once
+
+#include "memfile.hpp"
+#include <string>
+
+namespace Jo {
+namespace Files {
+
+	/**************************************************************************//**
+	 * \class	Files::MappedFile
+	 * \brief	A file on hard disk which is mapped into the address space.
+	 * \details	Reading works like for a MemFile and the content is available
+	 *			through GetBuffer(), so a MetaFileWrapper can read it IN_PLACE.
+	 *			Pages are loaded by the operating system when they are touched
+	 *			first.
+	 *
+	 *			With write access changes of the buffer are changes of the
+	 *			file. The size of a mapped file is fixed: writes behind the end
+	 *			fail.
+	 *****************************************************************************/
+	class MappedFile: public MemFile
+	{
+	public:
+		/// \brief Determine how a file should be opened.
+		typedef int ModeFlags;
+		static const int WRITE = 1;		///< Map with write access. Otherwise the file is read-only.
+
+		/// \brief Map an existing file.
+		/// \param [in] _name Name and path to a file on disk.
+		/// \param [in] _flags Access to the mapping.
+		/// \throws std::string if the file cannot be opened or mapped.
+		MappedFile( const std::string& _name, ModeFlags _flags = 0 );
+
+		/// \brief Unmaps the file. Changed pages are written to disk by the
+		///		operating system.
+		~MappedFile();
+
+		/// \details Writes only within the existing file.
+		/// \throws std::string
+		virtual void Write( const void* _from, uint64_t _numBytes ) override;
+
+		virtual std::string Name() const override { return m_name; }
+
+		/// \brief Write changed pages to disk and wait until this is done.
+		void Flush();
+
+		/// \brief Direct write access to the content.
+		/// \return nullptr for read-only mappings.
+		void* GetWritableBuffer()		{ return m_writeAccess ? m_buffer : nullptr; }
+
+	private:
+		// Copying files not allowed.
+		void operator = (const MappedFile&);
+		MappedFile(const MappedFile&);
+
+		/// \brief Reserve would reallocate the mapped memory.
+		using MemFile::Reserve;
+
+		std::string m_name;
+	};
+
+} // namespace Files
+} // namespace Jo
@@ -69,7 +69,7 @@ namespace Files {
 		virtual std::string Name() const override;
 
 		//void* GetBuffer()				{ return m_buffer; }
-		const void* GetBuffer() const	{ return m_buffer; }
+		virtual const void* GetBuffer() const override	{ return m_buffer; }
 
 	private:
 		// Copying files not allowed.
@@ -10,6 +10,27 @@
 #	define JO_POSIX
 #endif
 
+// SSE2 is part of every x86-64 target. Kernels using it need a scalar
+// fallback for all other targets.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define JO_SSE2
+#endif
+
+// Visual Studio supports thread_local since 2015 only.
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#	define JO_THREAD_LOCAL __declspec(thread)
+#else
+#	define JO_THREAD_LOCAL thread_local
+#endif
+
+// Visual Studio supports constexpr since 2015 only. Without it the
+// functions are evaluated at run time.
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#	define JO_CONSTEXPR
+#else
+#	define JO_CONSTEXPR constexpr
+#endif
+
 #include <cstdint>
 
 namespace Jo {
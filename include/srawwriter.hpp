@@ -0,0 +1,120 @@
+#pragma once
+
+#include "filewrapper.hpp"
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	/**************************************************************************//**
+	 * \class	Jo::Files::SrawWriter
+	 * \brief	Writes a SRAW file incrementally without a MetaFileWrapper.
+	 * \details	Nodes and arrays are emitted directly into the file. NELEMS
+	 *			and [SIZE] of open blocks are written as placeholders and
+	 *			patched when the block is closed, so only the path from the
+	 *			root to the current block is kept in memory.
+	 *
+	 *			SrawWriter writer( file );
+	 *			writer.BeginNode( "Frame" );
+	 *			writer.WriteArray( "Positions", ElementType::FLOAT, data, n );
+	 *			writer.BeginArray( "Samples", ElementType::DOUBLE );
+	 *			writer.AppendArray( chunk, m );	// As often as required
+	 *			writer.EndArray();
+	 *			writer.EndNode();
+	 *			writer.Finish();
+	 *
+	 *			The result is read by MetaFileWrapper like any other SRAW
+	 *			file. The root node is created by the writer.
+	 *****************************************************************************/
+	class SrawWriter
+	{
+	public:
+		typedef MetaFileWrapper::ElementType ElementType;
+
+		/// \brief Start a file with an empty root node.
+		/// \param [in] _file A file opened with write access. The writer
+		///		seeks back into regions it has written before.
+		/// \param [in] _flags Options like for MetaFileWrapper::Write.
+		///		CHILD_DIRECTORY is not supported because the children are
+		///		unknown when a node starts, VARINT_SIZES because the sizes
+		///		are patched and DEDUPLICATE because complete subtrees are
+		///		never known.
+		/// \throws std::string
+		SrawWriter( IFile& _file, MetaFileWrapper::WriteFlags _flags = 0 );
+
+		/// \brief Closes all open blocks if Finish() was not called.
+		~SrawWriter();
+
+		/// \brief Open an intermediate node as child of the current node.
+		void BeginNode( const std::string& _name );
+
+		/// \brief Close the current node.
+		void EndNode();
+
+		/// \brief Write a complete numeric or BIT array as child of the
+		///		current node. Use a count of 1 for scalars.
+		/// \details With COMPRESS large arrays are compressed and with
+		///		NARROW_INTEGERS integers use the smallest type which holds
+		///		all values. Arrays written in chunks are always stored raw.
+		void WriteArray( const std::string& _name, ElementType _type, const void* _data, uint64_t _numElements );
+
+		/// \brief Write a single string as child of the current node.
+		void WriteString( const std::string& _name, const std::string& _value );
+
+		/// \brief Write a string array as child of the current node.
+		void WriteStrings( const std::string& _name, const std::string* _values, uint64_t _numElements );
+
+		/// \brief Open an array whose elements are appended in chunks.
+		void BeginArray( const std::string& _name, ElementType _type );
+
+		/// \brief Append elements to the open array.
+		/// \details For BIT arrays all chunks except the last one must
+		///		have a multiple of 8 elements.
+		void AppendArray( const void* _data, uint64_t _numElements );
+
+		/// \brief Close the open array.
+		void EndArray();
+
+		/// \brief Close the root node. Nothing can be written afterwards.
+		/// \throws std::string if a node or an array is still open.
+		void Finish();
+
+	private:
+		/// \brief Position and state of a block which is not closed yet.
+		struct OpenBlock
+		{
+			ElementType type;
+			uint64_t numElementsPosition;	///< Position of the 8 byte NELEMS field
+			uint64_t dataPosition;			///< First byte after the header
+			uint64_t numElements;
+		};
+
+		IFile& m_file;
+		MetaFileWrapper::WriteFlags m_flags;
+		std::vector<OpenBlock> m_open;
+
+		/// \brief Write the header of a node and make it the current node.
+		void OpenNode( const std::string& _name );
+
+		/// \brief Write CodeNType, name and a placeholder NELEMS and count
+		///		the new child in the current node.
+		/// \param [in] _codeFlags Additional bits of the CodeNType.
+		void WriteHeader( const std::string& _name, ElementType _type, uint64_t _numElements, uint8_t _codeFlags = 0 );
+
+		/// \brief Write the PAD byte and the padding of aligned files.
+		void WritePadding( uint64_t _payloadSize );
+
+		/// \brief Overwrite NELEMS (and SIZE for nodes) of a closed block.
+		void PatchHeader( const OpenBlock& _block );
+
+		/// \brief Throws if the current block is not a node.
+		void CheckNodeOpen() const;
+
+		// Copying writers not allowed.
+		SrawWriter( const SrawWriter& );
+		void operator = ( const SrawWriter& );
+	};
+
+} // namespace Files
+} // namespace Jo
@@ -0,0 +1,472 @@
+#include "jofilelib.hpp"
+#include "binding.hpp"
+#include "platform.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	// ********************************************************************* //
+	// StructReader															 //
+	// ********************************************************************* //
+
+	StructReader::StructReader( const IFile& _file, Format _format ) :
+		m_file( _file ),
+		m_format( _format ),
+		m_srawFlags( 0 )
+	{
+		// Same detection as MetaFileWrapper: an object starting with {" or {}
+		if( m_format == Format::AUTO_DETECT )
+		{
+			m_format = Format::SRAW;
+			try {
+				if( NextToken() == '{' ) {
+					char next = NextToken();
+					if( next == '}' || next == '"' )
+						m_format = Format::JSON;
+				}
+			} catch(...) {}
+			m_file.Seek( 0 );
+		}
+
+		if( m_format == Format::SRAW )
+		{
+			// Revision 2 files have a preamble
+			if( m_file.Next() == MetaFileWrapper::SRAW_V2_MARKER )
+			{
+				uint8_t version = m_file.Next();
+				if( version > MetaFileWrapper::SRAW_VERSION ) throw std::string("[StructReader] Unsupported SRAW version.");
+				m_srawFlags = m_file.Next();
+			} else m_file.Seek( 1, IFile::SeekMode::MOVE_BACKWARD );
+		} else if( m_format != Format::JSON )
+			throw std::string("[StructReader] Only SRAW and JSON are supported.");
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadRoot( const FieldInfo* _fields, size_t _numFields, void* _object )
+	{
+		if( m_format == Format::JSON )
+			ReadObject( NextToken(), _fields, _numFields, _object );
+		else {
+			Block root;
+			ReadHeader( root );
+			ReadNode( root, _fields, _numFields, _object );
+			Skip( root );
+		}
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadHeader( Block& _block )
+	{
+		uint64_t position = m_file.GetCursor();
+		MetaFileWrapper::ReadBlockHeader( m_file, m_srawFlags, _block.header, &_block.name );
+		_block.hash = HashKey( _block.name.c_str() );
+		_block.end = m_file.GetCursor() + _block.header.dataSize;
+		// A reference is read like the block it points to
+		if( _block.header.reference )
+			MetaFileWrapper::FollowReference( m_file, m_srawFlags, position, _block.header );
+		_block.type = _block.header.type;
+		_block.numElements = _block.header.numElements;
+		if( _block.end > m_file.GetSize() ) throw std::string("[StructReader] Unexpected end of file.");
+		// The children follow the directory
+		m_file.Seek( _block.header.directorySize, IFile::SeekMode::MOVE_FORWARD );
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadElements( const Block& _block, ElementType _type, void* _dst, uint64_t _num )
+	{
+		if( _block.type <= ElementType::STRING || _block.type == ElementType::UNKNOWN )
+			throw "[StructReader] '" + _block.name + "' does not contain numeric data.";
+		if( _block.numElements < _num )
+			throw "[StructReader] '" + _block.name + "' has too few elements.";
+		if( (_block.type == ElementType::BIT) != (_type == ElementType::BIT) )
+			throw "[StructReader] '" + _block.name + "' cannot be converted from or to BIT.";
+
+		// Exact matches are read without a copy
+		if( _block.type == _type && _block.numElements == _num )
+		{
+			MetaFileWrapper::ReadArrayPayload( m_file, m_srawFlags, _block.header, _dst );
+			return;
+		}
+
+		m_scratch.resize( (size_t)MetaFileWrapper::ArraySize( _block.numElements, _block.type ) );
+		MetaFileWrapper::ReadArrayPayload( m_file, m_srawFlags, _block.header, m_scratch.data() );
+		if( _block.type == _type )
+			memcpy( _dst, m_scratch.data(), (size_t)MetaFileWrapper::ArraySize( _num, _type ) );
+		else MetaFileWrapper::ConvertElements( m_scratch.data(), _block.type, _dst, _type, _num );
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadStrings( const Block& _block, std::vector<std::string>& _values )
+	{
+		if( _block.type != ElementType::STRING ) throw "[StructReader] '" + _block.name + "' is not a string.";
+
+		std::vector<char> data( (size_t)_block.header.dataSize );
+		std::vector<uint64_t> ends( (size_t)_block.numElements );
+		m_file.Read( data.size(), data.data() );
+		MetaFileWrapper::UnpackStrings( data.data(), _block.header, m_srawFlags, ends.data() );
+		_values.resize( ends.size() );
+		uint64_t begin = 0;
+		for( size_t i=0; i<ends.size(); ++i )
+		{
+			_values[i].assign( data.data() + begin, size_t(ends[i] - begin) );
+			begin = ends[i];
+		}
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadNode( const Block& _block, const FieldInfo* _fields, size_t _numFields, void* _object )
+	{
+		if( _block.type != ElementType::NODE ) throw "[StructReader] '" + _block.name + "' is not a node.";
+
+		size_t next = 0;
+		Block child;
+		for( uint64_t i=0; i<_block.numElements; ++i )
+		{
+			ReadHeader( child );
+			const FieldInfo* field = FindField( _fields, _numFields, child.hash, child.name, next );
+			if( field ) field->readSraw( *this, child, _object );
+			Skip( child );
+		}
+	}
+
+	// ********************************************************************* //
+	const FieldInfo* StructReader::FindField( const FieldInfo* _fields, size_t _numFields, uint32_t _hash, const std::string& _name, size_t& _next )
+	{
+		for( size_t i=0; i<_numFields; ++i )
+		{
+			size_t index = (_next + i) % _numFields;
+			if( _fields[index].hash == _hash && _name == _fields[index].name )
+			{
+				_next = index + 1;
+				return &_fields[index];
+			}
+		}
+		return nullptr;
+	}
+
+	// ********************************************************************* //
+	char StructReader::NextToken()
+	{
+		char charBuffer;
+		do {
+			if( m_file.IsEof() ) throw std::string("Syntax error in json file. Unexpected end of file.");
+			charBuffer = m_file.Next();
+		} while( std::isspace(charBuffer) );
+		return charBuffer;
+	}
+
+	// ********************************************************************* //
+	std::string StructReader::ReadJsonString()
+	{
+		std::string value;
+		for(;;)
+		{
+			if( m_file.IsEof() ) throw std::string("Syntax error in json file. Unexpected end of file.");
+			char charBuffer = m_file.Next();
+			if( charBuffer == '"' ) return value;
+			if( charBuffer != '\\' ) { value += charBuffer; continue; }
+
+			if( m_file.IsEof() ) throw std::string("Syntax error in json file. Unexpected end of file.");
+			charBuffer = m_file.Next();
+			switch( charBuffer )
+			{
+			case 'b': value += '\b'; break;
+			case 'f': value += '\f'; break;
+			case 'n': value += '\n'; break;
+			case 'r': value += '\r'; break;
+			case 't': value += '\t'; break;
+			case 'u': {
+				// Basic multilingual plane only, encoded as UTF-8
+				char hex[5] = {0};
+				m_file.Read( 4, hex );
+				unsigned code = (unsigned)strtoul( hex, nullptr, 16 );
+				if( code < 0x80 ) value += char(code);
+				else if( code < 0x800 ) {
+					value += char(0xc0 | (code >> 6));
+					value += char(0x80 | (code & 0x3f));
+				} else {
+					value += char(0xe0 | (code >> 12));
+					value += char(0x80 | ((code >> 6) & 0x3f));
+					value += char(0x80 | (code & 0x3f));
+				}
+			} break;
+			default: value += charBuffer; break;	// \" \\ \/
+			}
+		}
+	}
+
+	// ********************************************************************* //
+	std::string StructReader::ReadJsonToken( char _first )
+	{
+		std::string token( 1, _first );
+		while( !m_file.IsEof() )
+		{
+			char charBuffer = m_file.Next();
+			if( charBuffer == ',' || charBuffer == '}' || charBuffer == ']' || std::isspace(charBuffer) )
+			{
+				m_file.Seek( 1, IFile::SeekMode::MOVE_BACKWARD );
+				break;
+			}
+			token += charBuffer;
+		}
+		return token;
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadJsonNumber( char _first, ElementType _type, void* _dst )
+	{
+		std::string number = ReadJsonToken( _first );
+		const char* begin = number.c_str();
+		char* end;
+		// Parse with the precision of the target. Like MetaFileWrapper
+		// integers can be hexadecimal.
+		bool isFloat = _type == ElementType::FLOAT || _type == ElementType::DOUBLE
+			|| (number.find_first_of( ".eE" ) != std::string::npos && number.find_first_of( "xX" ) == std::string::npos);
+		if( isFloat )
+		{
+			double value = strtod( begin, &end );
+			MetaFileWrapper::ConvertElements( &value, ElementType::DOUBLE, _dst, _type, 1 );
+		} else if( _first == '-' ) {
+			int64_t value = strtoll( begin, &end, 0 );
+			MetaFileWrapper::ConvertElements( &value, ElementType::INT64, _dst, _type, 1 );
+		} else {
+			uint64_t value = strtoull( begin, &end, 0 );
+			MetaFileWrapper::ConvertElements( &value, ElementType::UINT64, _dst, _type, 1 );
+		}
+		if( end == begin || *end != 0 ) throw "Syntax error in json file. Invalid number " + number + ".";
+	}
+
+	// ********************************************************************* //
+	bool StructReader::ReadJsonBool( char _first )
+	{
+		std::string literal = ReadJsonToken( _first );
+		if( literal == "true" ) return true;
+		if( literal == "false" ) return false;
+		throw "Syntax error in json file. Expected true or false but found " + literal + ".";
+	}
+
+	// ********************************************************************* //
+	void StructReader::SkipJsonValue( char _first )
+	{
+		if( _first == '"' ) ReadJsonString();
+		else if( _first == '[' ) {
+			for( char c = BeginJsonArray( _first ); c != ']'; c = NextJsonElement() )
+				SkipJsonValue( c );
+		} else if( _first == '{' ) {
+			char charBuffer = NextToken();
+			while( charBuffer != '}' )
+			{
+				if( charBuffer != '"' ) throw std::string("Syntax error in json file. Expected \"");
+				ReadJsonString();
+				if( NextToken() != ':' ) throw std::string("Syntax error in json file. Expected :");
+				SkipJsonValue( NextToken() );
+				charBuffer = NextToken();
+				if( charBuffer == ',' ) charBuffer = NextToken();
+				else if( charBuffer != '}' ) throw std::string("Syntax error in json file. Object must end with }");
+			}
+		} else ReadJsonToken( _first );
+	}
+
+	// ********************************************************************* //
+	char StructReader::BeginJsonArray( char _first )
+	{
+		if( _first != '[' ) throw std::string("Syntax error in json file. Expected [");
+		return NextToken();
+	}
+
+	char StructReader::NextJsonElement()
+	{
+		char charBuffer = NextToken();
+		if( charBuffer == ']' ) return charBuffer;
+		if( charBuffer != ',' ) throw std::string("Syntax error in json file. Expected , or ]");
+		return NextToken();
+	}
+
+	// ********************************************************************* //
+	void StructReader::ReadObject( char _first, const FieldInfo* _fields, size_t _numFields, void* _object )
+	{
+		if( _first != '{' ) throw std::string("Syntax error in json file. Expected {");
+
+		size_t next = 0;
+		char charBuffer = NextToken();
+		while( charBuffer != '}' )
+		{
+			if( charBuffer != '"' ) throw std::string("Syntax error in json file. Expected \"");
+			std::string key = ReadJsonString();
+			if( NextToken() != ':' ) throw std::string("Syntax error in json file. Expected :");
+
+			const FieldInfo* field = FindField( _fields, _numFields, HashKey( key.c_str() ), key, next );
+			if( field ) field->readJson( *this, NextToken(), _object );
+			else SkipJsonValue( NextToken() );
+
+			charBuffer = NextToken();
+			if( charBuffer == ',' ) charBuffer = NextToken();
+			else if( charBuffer != '}' ) throw std::string("Syntax error in json file. Object must end with }");
+		}
+	}
+
+	// ********************************************************************* //
+	// StructWriter															 //
+	// ********************************************************************* //
+
+	StructWriter::StructWriter( IFile& _file, Format _format, MetaFileWrapper::WriteFlags _flags ) :
+		m_file( _file ),
+		m_sraw( nullptr ),
+		m_indent( 0 )
+	{
+		if( _format == Format::SRAW )
+			m_sraw = new SrawWriter( _file, _flags );
+		else if( _format != Format::JSON )
+			throw std::string("[StructWriter] Only SRAW and JSON are supported.");
+	}
+
+	// ********************************************************************* //
+	StructWriter::~StructWriter()
+	{
+		delete m_sraw;
+	}
+
+	// ********************************************************************* //
+	void StructWriter::WriteRoot( const FieldInfo* _fields, size_t _numFields, const void* _object )
+	{
+		if( m_sraw )
+		{
+			WriteFields( _fields, _numFields, _object );
+			m_sraw->Finish();
+		} else JsonObject( _fields, _numFields, _object );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::WriteFields( const FieldInfo* _fields, size_t _numFields, const void* _object )
+	{
+		for( size_t i=0; i<_numFields; ++i )
+			_fields[i].writeSraw( *this, _fields[i].name, _object );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::JsonNumbers( ElementType _type, const void* _values, uint64_t _num, bool _asArray )
+	{
+		if( _asArray ) Write( "[" );
+		char buffer[32];
+		for( uint64_t i=0; i<_num; ++i )
+		{
+			switch( _type )
+			{
+			// Enough digits to read the same value back
+			case ElementType::FLOAT:	sprintf( buffer, "%.9g", ((const float*)_values)[i] ); break;
+			case ElementType::DOUBLE:	sprintf( buffer, "%.17g", ((const double*)_values)[i] ); break;
+			case ElementType::INT8:		sprintf( buffer, "%d", int(((const int8_t*)_values)[i]) ); break;
+			case ElementType::INT16:	sprintf( buffer, "%d", int(((const int16_t*)_values)[i]) ); break;
+			case ElementType::INT32:	sprintf( buffer, "%d", int(((const int32_t*)_values)[i]) ); break;
+			case ElementType::INT64:	sprintf( buffer, "%lld", (long long)((const int64_t*)_values)[i] ); break;
+			case ElementType::UINT8:	sprintf( buffer, "%u", unsigned(((const uint8_t*)_values)[i]) ); break;
+			case ElementType::UINT16:	sprintf( buffer, "%u", unsigned(((const uint16_t*)_values)[i]) ); break;
+			case ElementType::UINT32:	sprintf( buffer, "%u", unsigned(((const uint32_t*)_values)[i]) ); break;
+			case ElementType::UINT64:	sprintf( buffer, "%llu", (unsigned long long)((const uint64_t*)_values)[i] ); break;
+			default: throw std::string("[StructWriter] Element type must be numeric.");
+			}
+			// MetaFileWrapper recognizes floats by the dot or exponent
+			if( (_type == ElementType::FLOAT || _type == ElementType::DOUBLE) && !strpbrk( buffer, ".eni" ) )
+				strcat( buffer, ".0" );
+			Write( buffer );
+			if( i+1 < _num ) Write( ", " );
+		}
+		if( _asArray ) Write( "]" );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::JsonBool( bool _value )
+	{
+		Write( _value ? "true" : "false" );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::JsonStrings( const std::string* _values, uint64_t _num, bool _asArray )
+	{
+		if( _asArray ) Write( "[" );
+		for( uint64_t i=0; i<_num; ++i )
+		{
+			std::string buffer( 1, '"' );
+			for( size_t c=0; c<_values[i].length(); ++c )
+			{
+				char character = _values[i][c];
+				switch( character )
+				{
+				case '"': buffer += "\\\""; break;
+				case '\\': buffer += "\\\\"; break;
+				case '\n': buffer += "\\n"; break;
+				case '\r': buffer += "\\r"; break;
+				case '\t': buffer += "\\t"; break;
+				default: buffer += character; break;
+				}
+			}
+			buffer += '"';
+			m_file.Write( buffer.c_str(), buffer.length() );
+			if( i+1 < _num ) Write( ", " );
+		}
+		if( _asArray ) Write( "]" );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::JsonObject( const FieldInfo* _fields, size_t _numFields, const void* _object )
+	{
+		Write( "{\n" );
+		m_indent += 2;
+		for( size_t i=0; i<_numFields; ++i )
+		{
+			Indent();
+			Write( "\"" );
+			Write( _fields[i].name );
+			Write( "\": " );
+			_fields[i].writeJson( *this, _object );
+			// All variables are delimited by ,
+			Write( i+1 < _numFields ? ",\n" : "\n" );
+		}
+		m_indent -= 2;
+		Indent();
+		Write( "}" );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::JsonBeginList( uint64_t _num )
+	{
+		Write( _num ? "[\n" : "[" );
+		m_indent += 2;
+	}
+
+	void StructWriter::JsonListItem( uint64_t _index )
+	{
+		if( _index ) Write( ",\n" );
+		Indent();
+	}
+
+	void StructWriter::JsonEndList( uint64_t _num )
+	{
+		m_indent -= 2;
+		if( _num )
+		{
+			Write( "\n" );
+			Indent();
+		}
+		Write( "]" );
+	}
+
+	// ********************************************************************* //
+	void StructWriter::Write( const char* _text )
+	{
+		m_file.Write( _text, strlen(_text) );
+	}
+
+	void StructWriter::Indent()
+	{
+		for( int i=0; i<m_indent; ++i ) m_file.Write( " ", 1 );
+	}
+
+} // namespace Files
+} // namespace Jo
@@ -1,22 +1,66 @@
 #include "jofilelib.hpp"
 #include "file.hpp"
 #include "filewrapper.hpp"
+#include "platform.hpp"
 #include <cctype>
 #include <cstring>	// memcpy
+#include <limits>
 #include <string>
 #include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <type_traits>
+#ifdef JO_SSE2
+#	include <emmintrin.h>
+#endif
 using namespace std; 
 
 namespace Jo {
 namespace Files {
 
-	const int64_t MetaFileWrapper::ELEMENT_TYPE_SIZE[] = { sizeof(Node*)*8, sizeof(std::string)*8, -1, -1, -1, 1, 8, 16, 32, 64, 8, 16, 32, 64, 32, 64 };
+	const int64_t MetaFileWrapper::ELEMENT_TYPE_SIZE[] = { sizeof(Node*)*8, 64, -1, -1, -1, 1, 8, 16, 32, 64, 8, 16, 32, 64, 32, 64 };
 	static int NELEM_SIZE(uint8_t _code) { return 1<<((_code & 0x30)>>4); }
 
-	/// \brief Calculate the space required by the bufferArray
-#	define ARRAY_SIZE(n,T)		(((n) * MetaFileWrapper::ELEMENT_TYPE_SIZE[(int)(T)] + 7) / 8)
+	// SRAW revision 2 files start with the marker byte, the VERSION byte and
+	// a byte with the WriteFlags. Bits 6 and 7 of a revision 1 CodeNType are
+	// always 0, so the marker cannot begin a revision 1 file. With
+	// CHILD_DIRECTORY each NODE block starts with NELEMS directory entries
+	// sorted by the child names. An entry consists of the offset of the child
+	// header relative to the directory start and the index of the child
+	// (2x uint64). The block SIZE includes the directory. With ALIGN_16 or
+	// ALIGN_64 the data block of each numeric array starts with a byte PAD
+	// followed by PAD zero bytes. With COMPRESS the CodeNType of an array
+	// can have the bit SRAW_COMPRESSED. The header of such an array ends
+	// with a CODEC byte and the SIZE of the compressed data (uint64), which
+	// follows without padding.
+	static const uint64_t DIRECTORY_ENTRY_SIZE = 16;
+
+	// A parallel read hands blocks of at least this size to the workers.
+	static const uint64_t MIN_TASK_SIZE = 65536;
+	// Number of nodes a read worker takes from the pool at once.
+	static const int NODE_BATCH_SIZE = 256;
+
+	// Per thread state of a parallel read. Node memory and names are taken
+	// from the wrapper in batches to avoid locking for each node.
+	struct ReadWorker
+	{
+		const MetaFileWrapper* wrapper;
+		std::vector<void*> nodes;
+		std::unordered_map<std::string, const std::string*> names;
+	};
+	static JO_THREAD_LOCAL ReadWorker* s_readWorker = nullptr;
+
+	// ********************************************************************* //
+	uint8_t MetaFileWrapper::PaddingSize( WriteFlags _flags, uint64_t _position, uint64_t _payloadSize )
+	{
+		uint64_t alignment = (_flags & ALIGN_64) ? 64 : 16;
+		if( _payloadSize < alignment ) return 0;
+		return uint8_t((alignment - (_position + 1) % alignment) % alignment);
+	}
 
 
+	const std::string MetaFileWrapper::EmptyName;
 	MetaFileWrapper::Node MetaFileWrapper::Node::UndefinedNode( nullptr, std::string() );
 
 	// ********************************************************************* //
@@ -65,7 +109,7 @@ namespace Files {
 			charBuffer = _file.Next();
 			number += charBuffer;
 			// It is a float!
-			if( charBuffer == '.' || charBuffer == 'e') _isFloat = true;
+			if( charBuffer == '.' || charBuffer == 'e' || charBuffer == 'E' ) _isFloat = true;
 			// Silently accept any delimiting character.
 		} while( charBuffer != ',' && charBuffer != '\n' && charBuffer != '}' && charBuffer != ']' );
 
@@ -73,6 +117,36 @@ namespace Files {
 		_file.Seek( 1, IFile::SeekMode::MOVE_BACKWARD );
 		return number.c_str();
 	}
+	// Reads the numbers of an array up to the closing ]. _first is the
+	// first character of the first number. Integers are collected until a
+	// float turns all elements into doubles. Returns true for doubles.
+	static bool ReadJsonNumbers( const IFile& _file, char _first, std::vector<int64_t>& _integers, std::vector<double>& _floats )
+	{
+		bool isFloat = false;
+		char charBuffer = _first;
+		while( charBuffer != ']' )
+		{
+			if( charBuffer == 'n' ) throw std::string("[Node::ParseJsonArray] null is only allowed in arrays of objects or arrays.");
+			if( (charBuffer < '0' || charBuffer > '9') && charBuffer != '-' ) throw std::string("[Node::ParseJsonArray] Arrays must have the same type everywhere!");
+			bool elementIsFloat;
+			std::string number = charBuffer + ReadJsonNumber( _file, elementIsFloat );
+			if( elementIsFloat && !isFloat )
+			{
+				isFloat = true;
+				_floats.assign( _integers.begin(), _integers.end() );
+				std::vector<int64_t>().swap( _integers );
+			}
+			if( isFloat ) _floats.push_back( atof(number.c_str()) );
+			else _integers.push_back( strtoll(number.c_str(), nullptr, 10) );
+
+			charBuffer = FindFirstNonWhitespace(_file);
+			if( charBuffer != ',' && charBuffer != ']' )
+				throw std::string("Syntax error in json file. Expected , or ]");
+			if( charBuffer == ',' )
+				charBuffer = FindFirstNonWhitespace(_file);
+		}
+		return isFloat;
+	}
 
 	// ********************************************************************* //
 	// Determine the minimum variable size to store the value in _iVal
@@ -85,55 +159,696 @@ namespace Files {
 		else return 0;
 	}
 
+	// ********************************************************************* //
+	// True if the numbers in a SRAW file with the given flags have the
+	// other byte order than the host.
+	static bool IsForeignEndian( int _srawFlags )
+	{
+		return ((_srawFlags & MetaFileWrapper::BIG_ENDIAN_FILE) != 0) == IsLittleEndian();
+	}
+
+	// ********************************************************************* //
+	// Load an unsigned integer with 1, 2, 4 or 8 bytes.
+	static uint64_t LoadSized( const uint8_t* _src, int _size, bool _swap )
+	{
+		switch( _size )
+		{
+		case 1: return *_src;
+		case 2: { uint16_t v; memcpy( &v, _src, 2 ); return _swap ? ConvertEndian(v) : v; }
+		case 4: { uint32_t v; memcpy( &v, _src, 4 ); return _swap ? ConvertEndian(v) : v; }
+		default: { uint64_t v; memcpy( &v, _src, 8 ); return _swap ? ConvertEndian(v) : v; }
+		}
+	}
+
+	// ********************************************************************* //
+	// Store the _size low order bytes of _value in host byte order.
+	static void StoreSized( uint8_t* _dst, uint64_t _value, int _size )
+	{
+		switch( _size )
+		{
+		case 1: *_dst = uint8_t(_value); break;
+		case 2: { uint16_t v = uint16_t(_value); memcpy( _dst, &v, 2 ); } break;
+		case 4: { uint32_t v = uint32_t(_value); memcpy( _dst, &v, 4 ); } break;
+		default: memcpy( _dst, &_value, 8 ); break;
+		}
+	}
+
+	// ********************************************************************* //
+	static uint64_t ReadSized( const IFile& _file, int _size, bool _swap )
+	{
+		uint8_t buffer[8];
+		_file.Read( _size, buffer );
+		return LoadSized( buffer, _size, _swap );
+	}
+
+	static void WriteSized( IFile& _file, uint64_t _value, int _size )
+	{
+		uint8_t buffer[8];
+		StoreSized( buffer, _value, _size );
+		_file.Write( buffer, _size );
+	}
+
+	// ********************************************************************* //
+	// Number of LEB128 bytes (7 bits each) of a VARINT_SIZES field.
+	static int VarintSize( uint64_t _value )
+	{
+		int size = 1;
+		while( _value >= 0x80 ) { _value >>= 7; ++size; }
+		return size;
+	}
+
+	// Write a LEB128 value with exactly _size bytes. Unused high order
+	// groups are stored as 0x80 which allows patching a reserved field.
+	static void WriteVarint( IFile& _file, uint64_t _value, int _size )
+	{
+		uint8_t buffer[10];
+		for( int i=0; i<_size-1; ++i )
+		{
+			buffer[i] = uint8_t(_value & 0x7f) | 0x80;
+			_value >>= 7;
+		}
+		buffer[_size-1] = uint8_t(_value);
+		_file.Write( buffer, _size );
+	}
+
+	static uint64_t ReadVarint( const IFile& _file )
+	{
+		uint64_t value = 0;
+		for( int shift=0; shift<64; shift+=7 )
+		{
+			uint8_t byte = _file.Next();
+			value |= uint64_t(byte & 0x7f) << shift;
+			if( !(byte & 0x80) ) return value;
+		}
+		throw std::string("[Node::ReadSraw] Invalid variable length size.");
+	}
+
+	// SIZE field of NODE, STRING and compressed blocks.
+	static uint64_t ReadBlockSize( const IFile& _file, int _srawFlags, bool _swap )
+	{
+		if( _srawFlags & MetaFileWrapper::VARINT_SIZES ) return ReadVarint( _file );
+		return ReadSized( _file, 8, _swap );
+	}
+
+	// _size is ignored for fixed 8 byte fields.
+	static void WriteBlockSize( IFile& _file, uint64_t _value, int _size, MetaFileWrapper::WriteFlags _flags )
+	{
+		if( _flags & MetaFileWrapper::VARINT_SIZES ) WriteVarint( _file, _value, _size );
+		else _file.Write( &_value, 8 );
+	}
+
 	// ********************************************************************* //
 	// Read a string with variable sized length header from file to std::string
-	static void ReadString( const IFile& _file, int _stringSize, std::string& _Out )
+	static void ReadString( const IFile& _file, int _stringSize, std::string& _Out, bool _swap = false )
 	{
-		uint64_t length = 0;
-		_file.Read( _stringSize, &length );
+		uint64_t length = ReadSized( _file, _stringSize, _swap );
 		_Out.resize( size_t(length) );
 		_file.Read( length, &_Out[0] );
 	}
 
+	// ********************************************************************* //
+	// Read one directory entry and the name of the child it points to.
+	static void ReadDirectoryEntry( const IFile& _file, uint64_t _directory, uint64_t _entry, bool _swap, uint64_t* _out, std::string& _name )
+	{
+		_file.Seek( _directory + _entry * DIRECTORY_ENTRY_SIZE );
+		_out[0] = ReadSized( _file, 8, _swap );
+		_out[1] = ReadSized( _file, 8, _swap );
+		// Skip the CodeNType of the child
+		_file.Seek( _directory + _out[0] + 1 );
+		ReadString( _file, 1, _name );
+	}
+
+	// ********************************************************************* //
+	// Start offset of a string element in a packed STRING node.
+	static uint64_t StringBegin( const void* _offsets, uint64_t _index )
+	{
+		return _index ? ((const uint64_t*)_offsets)[_index-1] : 0;
+	}
+
+	// ********************************************************************* //
+	// Write packed strings with variable sized length headers. Length fields
+	// and characters are interleaved in a staging buffer to write larger
+	// blocks.
+	static void WriteStrings( IFile& _file, int _stringSize, const uint64_t* _ends, const char* _strings, uint64_t _num )
+	{
+		const uint64_t STAGING_SIZE = 16384;
+		uint8_t staging[STAGING_SIZE];
+		uint64_t fill = 0;
+		for( uint64_t i=0; i<_num; ++i )
+		{
+			uint64_t begin = StringBegin( _ends, i );
+			uint64_t length = _ends[i] - begin;
+			if( fill + _stringSize + length > STAGING_SIZE ) {
+				_file.Write( staging, fill );
+				fill = 0;
+			}
+			StoreSized( staging + fill, length, _stringSize );
+			fill += _stringSize;
+			// Huge strings bypass the staging buffer
+			if( length > STAGING_SIZE - _stringSize ) {
+				_file.Write( staging, fill );
+				_file.Write( _strings + begin, length );
+				fill = 0;
+			} else {
+				memcpy( staging + fill, _strings + begin, size_t(length) );
+				fill += length;
+			}
+		}
+		_file.Write( staging, fill );
+	}
+
+	// ********************************************************************* //
+	// Element type conversion kernels. The generic version is left to the
+	// auto vectorizer, the most common widening conversions use SSE2.
+	template<typename S, typename D> static void ConvertArray( const S* _src, D* _dst, uint64_t _num )
+	{
+		for( uint64_t i=0; i<_num; ++i )
+			_dst[i] = D(_src[i]);
+	}
+
+	// Sign or zero extension of 8 elements to 32 bit
+#	define WIDEN_16_TO_32(V, SIGNED, LO, HI)															\
+		if( SIGNED ) { LO = _mm_srai_epi32(_mm_unpacklo_epi16(V, V), 16); HI = _mm_srai_epi32(_mm_unpackhi_epi16(V, V), 16); }	\
+		else { LO = _mm_unpacklo_epi16(V, _mm_setzero_si128()); HI = _mm_unpackhi_epi16(V, _mm_setzero_si128()); }
+
+	template<typename S> static void Convert16ToFloat( const S* _src, float* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		for( ; i+8 <= _num; i+=8 )
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(_src+i)), lo, hi;
+			WIDEN_16_TO_32(v, S(-1) < 0, lo, hi)
+			_mm_storeu_ps(_dst+i, _mm_cvtepi32_ps(lo));
+			_mm_storeu_ps(_dst+i+4, _mm_cvtepi32_ps(hi));
+		}
+#endif
+		for( ; i<_num; ++i ) _dst[i] = float(_src[i]);
+	}
+	static void ConvertArray( const int16_t* _src, float* _dst, uint64_t _num )		{ Convert16ToFloat(_src, _dst, _num); }
+	static void ConvertArray( const uint16_t* _src, float* _dst, uint64_t _num )	{ Convert16ToFloat(_src, _dst, _num); }
+
+	template<typename S, typename D> static void Convert16To32( const S* _src, D* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		for( ; i+8 <= _num; i+=8 )
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(_src+i)), lo, hi;
+			WIDEN_16_TO_32(v, S(-1) < 0, lo, hi)
+			_mm_storeu_si128((__m128i*)(_dst+i), lo);
+			_mm_storeu_si128((__m128i*)(_dst+i+4), hi);
+		}
+#endif
+		for( ; i<_num; ++i ) _dst[i] = D(_src[i]);
+	}
+	static void ConvertArray( const int16_t* _src, int32_t* _dst, uint64_t _num )	{ Convert16To32(_src, _dst, _num); }
+	static void ConvertArray( const uint16_t* _src, int32_t* _dst, uint64_t _num )	{ Convert16To32(_src, _dst, _num); }
+	static void ConvertArray( const uint16_t* _src, uint32_t* _dst, uint64_t _num )	{ Convert16To32(_src, _dst, _num); }
+
+	template<typename S> static void Convert8ToFloat( const S* _src, float* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		for( ; i+16 <= _num; i+=16 )
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(_src+i)), lo, hi;
+			__m128i v16[2];
+			if( S(-1) < 0 ) {
+				v16[0] = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+				v16[1] = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+			} else {
+				v16[0] = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+				v16[1] = _mm_unpackhi_epi8(v, _mm_setzero_si128());
+			}
+			for( int j=0; j<2; ++j )
+			{
+				WIDEN_16_TO_32(v16[j], S(-1) < 0, lo, hi)
+				_mm_storeu_ps(_dst+i+j*8, _mm_cvtepi32_ps(lo));
+				_mm_storeu_ps(_dst+i+j*8+4, _mm_cvtepi32_ps(hi));
+			}
+		}
+#endif
+		for( ; i<_num; ++i ) _dst[i] = float(_src[i]);
+	}
+	static void ConvertArray( const int8_t* _src, float* _dst, uint64_t _num )		{ Convert8ToFloat(_src, _dst, _num); }
+	static void ConvertArray( const uint8_t* _src, float* _dst, uint64_t _num )		{ Convert8ToFloat(_src, _dst, _num); }
+#	undef WIDEN_16_TO_32
+
+	static void ConvertArray( const int32_t* _src, float* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		for( ; i+4 <= _num; i+=4 )
+			_mm_storeu_ps(_dst+i, _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(_src+i))));
+#endif
+		for( ; i<_num; ++i ) _dst[i] = float(_src[i]);
+	}
+
+	static void ConvertArray( const float* _src, double* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		for( ; i+4 <= _num; i+=4 )
+		{
+			__m128 v = _mm_loadu_ps(_src+i);
+			_mm_storeu_pd(_dst+i, _mm_cvtps_pd(v));
+			_mm_storeu_pd(_dst+i+2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+		}
+#endif
+		for( ; i<_num; ++i ) _dst[i] = double(_src[i]);
+	}
+
+	static void ConvertArray( const double* _src, float* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		for( ; i+4 <= _num; i+=4 )
+		{
+			__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(_src+i));
+			__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(_src+i+2));
+			_mm_storeu_ps(_dst+i, _mm_movelh_ps(lo, hi));
+		}
+#endif
+		for( ; i<_num; ++i ) _dst[i] = float(_src[i]);
+	}
+
+	// Reverse the byte order of each element. SSE2 has no byte shuffle:
+	// the 16 bit words of an element are reordered first and the two bytes
+	// of each word are swapped afterwards.
+	template<typename T> static void SwapArray( const uint8_t* _src, uint8_t* _dst, uint64_t _num )
+	{
+		uint64_t i = 0;
+#ifdef JO_SSE2
+		const uint64_t STEP = 16 / sizeof(T);
+		for( ; i+STEP <= _num; i+=STEP )
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(_src + i*sizeof(T)));
+			if( sizeof(T) == 4 ) v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+			if( sizeof(T) == 8 ) v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0,1,2,3)), _MM_SHUFFLE(0,1,2,3));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			_mm_storeu_si128((__m128i*)(_dst + i*sizeof(T)), v);
+		}
+#endif
+		for( ; i<_num; ++i )
+		{
+			T v;
+			memcpy( &v, _src + i*sizeof(T), sizeof(T) );
+			v = ConvertEndian(v);
+			memcpy( _dst + i*sizeof(T), &v, sizeof(T) );
+		}
+	}
+
+	void MetaFileWrapper::SwapBytes( const void* _src, void* _dst, uint64_t _num, int _elementSize )
+	{
+		switch( _elementSize )
+		{
+		case 2: SwapArray<uint16_t>( (const uint8_t*)_src, (uint8_t*)_dst, _num ); break;
+		case 4: SwapArray<uint32_t>( (const uint8_t*)_src, (uint8_t*)_dst, _num ); break;
+		case 8: SwapArray<uint64_t>( (const uint8_t*)_src, (uint8_t*)_dst, _num ); break;
+		default: if( _src != _dst ) memmove( _dst, _src, size_t(_num * _elementSize) );
+		}
+	}
+
+	// Read an array of foreign byte order. The bytes are swapped while
+	// copying them out of a memory file or chunk by chunk while the data
+	// is still in the cache.
+	void MetaFileWrapper::ReadSwapped( const IFile& _file, void* _dst, uint64_t _num, int _elementSize )
+	{
+		const uint8_t* source = (const uint8_t*)_file.GetBuffer();
+		if( source )
+		{
+			if( _file.GetCursor() + _num * _elementSize > _file.GetSize() ) throw std::string("[Node::ReadSraw] Unexpected end of file.");
+			SwapBytes( source + _file.GetCursor(), _dst, _num, _elementSize );
+			_file.Seek( _num * _elementSize, IFile::SeekMode::MOVE_FORWARD );
+			return;
+		}
+
+		const uint64_t CHUNK_SIZE = 65536 / _elementSize;
+		for( uint64_t i=0; i<_num; i+=CHUNK_SIZE )
+		{
+			uint64_t num = std::min( CHUNK_SIZE, _num - i );
+			uint8_t* chunk = (uint8_t*)_dst + i * _elementSize;
+			_file.Read( num * _elementSize, chunk );
+			SwapBytes( chunk, chunk, num, _elementSize );
+		}
+	}
+
+	// ********************************************************************* //
+	// Second dispatch level: the source type is known.
+	template<typename S> static void ConvertFrom( const S* _src, void* _dst, MetaFileWrapper::ElementType _dstType, uint64_t _num )
+	{
+		typedef MetaFileWrapper::ElementType ET;
+		switch( _dstType )
+		{
+		case ET::INT8:		ConvertArray( _src, (int8_t*)_dst, _num ); break;
+		case ET::INT16:		ConvertArray( _src, (int16_t*)_dst, _num ); break;
+		case ET::INT32:		ConvertArray( _src, (int32_t*)_dst, _num ); break;
+		case ET::INT64:		ConvertArray( _src, (int64_t*)_dst, _num ); break;
+		case ET::UINT8:		ConvertArray( _src, (uint8_t*)_dst, _num ); break;
+		case ET::UINT16:	ConvertArray( _src, (uint16_t*)_dst, _num ); break;
+		case ET::UINT32:	ConvertArray( _src, (uint32_t*)_dst, _num ); break;
+		case ET::UINT64:	ConvertArray( _src, (uint64_t*)_dst, _num ); break;
+		case ET::FLOAT:		ConvertArray( _src, (float*)_dst, _num ); break;
+		case ET::DOUBLE:	ConvertArray( _src, (double*)_dst, _num ); break;
+		default: throw std::string("[Node::CopyTo] Target type must be numeric.");
+		}
+	}
+
 	// ********************************************************************* //
 	// MetaFileWrapper														 //
 	// ********************************************************************* //
 
 	// ********************************************************************* //
 	// Use a wrapped file to read from.
-	MetaFileWrapper::MetaFileWrapper( const IFile& _file, Format _format ) :
+	MetaFileWrapper::MetaFileWrapper( const IFile& _file, Format _format, ReadFlags _flags ) :
 		m_nodePool(sizeof(Node)),
-		RootNode(this, _file, _format)
+		m_source(nullptr),
+		m_numLazyNodes(0),
+		m_srawFlags(0),
+		m_sourceMemory(nullptr),
+		m_writeThrough(false),
+		m_referenceTargets(nullptr),
+		m_snapshotGeneration(0),
+		RootNode(this, _file, _format, _flags)
 	{
 	}
 
 	// ********************************************************************* //
 	// Clears the old data and loads content from file.
-	void MetaFileWrapper::Read( const IFile& _file, Format _format )
+	void MetaFileWrapper::Read( const IFile& _file, Format _format, ReadFlags _flags )
 	{
 		RootNode.~Node();
 		// After the ~Node the following call should do nothing
 		m_nodePool.FreeAll();
+		// No node references a name anymore
+		m_names.clear();
+		m_source = nullptr;
+		m_numLazyNodes = 0;
+		m_srawFlags = 0;
+		m_sourceMemory = nullptr;
+		m_writeThrough = false;
+		m_spareNodes.clear();
+		m_sharedNodes.clear();
 
 		// Load from file
-		RootNode.Read( _file, _format );
+		new (&RootNode) Node( this, _file, _format, _flags );
 	}
 
 	// ********************************************************************* //
 	// Create an empty wrapper for writing new files.
 	MetaFileWrapper::MetaFileWrapper() :
 		m_nodePool(sizeof(Node)),
+		m_source(nullptr),
+		m_numLazyNodes(0),
+		m_srawFlags(0),
+		m_sourceMemory(nullptr),
+		m_writeThrough(false),
+		m_referenceTargets(nullptr),
+		m_snapshotGeneration(0),
 		RootNode(this, "Root")
 	{
 	}
 
 	// ********************************************************************* //
 	// Writes the wrapped data into a file.
-	void MetaFileWrapper::Write( IFile& _file, Format _format ) const
+	void MetaFileWrapper::Write( IFile& _file, Format _format, WriteFlags _flags ) const
 	{
 		if( _format == Format::JSON ) 
 			RootNode.SaveAsJson( _file );
-		else RootNode.SaveAsSraw( _file );
+		else if( _format == Format::MSGPACK )
+			RootNode.SaveAsMsgpack( _file, _flags );
+		else if( _format == Format::CBOR )
+			RootNode.SaveAsCbor( _file );
+		else {
+			// Without options the file stays readable for old readers
+			_flags &= ~BIG_ENDIAN_FILE;
+			if( !IsLittleEndian() ) _flags |= BIG_ENDIAN_FILE;
+			// Narrowed arrays need nothing special to be read
+			WriteFlags fileFlags = _flags & ~(NARROW_INTEGERS | PACKED_ARRAYS);
+			if( fileFlags )
+			{
+				uint8_t preamble[3] = { SRAW_V2_MARKER, SRAW_VERSION, uint8_t(fileFlags) };
+				_file.Write( preamble, 3 );
+			}
+			RootNode.SaveAsSraw( _file, _flags );
+		}
+	}
+
+	// ********************************************************************* //
+	MetaFileWrapper::NameId MetaFileWrapper::InternName( const std::string& _name )
+	{
+		// Array elements are unnamed. Do not store this most common name.
+		if( _name.empty() ) return &EmptyName;
+		if( s_readWorker && s_readWorker->wrapper == this )
+		{
+			// Workers of a parallel read share the table
+			auto it = s_readWorker->names.find( _name );
+			if( it != s_readWorker->names.end() ) return it->second;
+			std::lock_guard<std::mutex> lock( m_sourceMutex );
+			NameId name = &*m_names.insert( _name ).first;
+			s_readWorker->names[_name] = name;
+			return name;
+		}
+		// unordered_set never moves its elements -> the address is stable.
+		return &*m_names.insert( _name ).first;
+	}
+
+	// ********************************************************************* //
+	void* MetaFileWrapper::AllocNode()
+	{
+		if( s_readWorker && s_readWorker->wrapper == this )
+		{
+			std::vector<void*>& nodes = s_readWorker->nodes;
+			if( nodes.empty() )
+			{
+				std::lock_guard<std::mutex> lock( m_sourceMutex );
+				while( nodes.size() < NODE_BATCH_SIZE && !m_spareNodes.empty() )
+				{
+					nodes.push_back( m_spareNodes.back() );
+					m_spareNodes.pop_back();
+				}
+				while( nodes.size() < NODE_BATCH_SIZE )
+					nodes.push_back( m_nodePool.Alloc() );
+			}
+			void* node = nodes.back();
+			nodes.pop_back();
+			return node;
+		}
+
+		if( !m_spareNodes.empty() )
+		{
+			void* node = m_spareNodes.back();
+			m_spareNodes.pop_back();
+			return node;
+		}
+		return m_nodePool.Alloc();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::DeleteNode( Node* _node )
+	{
+		if( _node->m_readOnly )
+		{
+			auto it = m_sharedNodes.find( _node );
+			if( it != m_sharedNodes.end() )
+			{
+				// Other parents still use the subtree
+				if( --it->second > 0 ) return;
+				m_sharedNodes.erase( it );
+			}
+		}
+		m_nodePool.Delete( _node );
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::ShareNode( Node* _node )
+	{
+		auto it = m_sharedNodes.find( _node );
+		if( it != m_sharedNodes.end() ) ++it->second;
+		else {
+			m_sharedNodes[_node] = 2;
+			_node->SetReadOnly();
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::ReadSubtrees( const void* _memory, uint64_t _size, std::vector<SubtreeTask>& _tasks )
+	{
+		// Start with the largest tasks to balance the load
+		std::sort( _tasks.begin(), _tasks.end(), []( const SubtreeTask& _a, const SubtreeTask& _b ) {
+			return _a.size > _b.size;
+		} );
+
+		std::atomic<size_t> next( 0 );
+		std::string error;
+		auto work = [&]() {
+			// Each worker has its own cursor
+			MemFile file( _memory, _size );
+			ReadWorker worker;
+			worker.wrapper = this;
+			s_readWorker = &worker;
+			for( size_t i = next++; i < _tasks.size(); i = next++ )
+			{
+				try {
+					file.Seek( _tasks[i].position );
+					_tasks[i].node->ReadSraw( file, false );
+				} catch( const std::string& _message ) {
+					std::lock_guard<std::mutex> lock( m_sourceMutex );
+					error = _message;
+				}
+			}
+			s_readWorker = nullptr;
+			std::lock_guard<std::mutex> lock( m_sourceMutex );
+			m_spareNodes.insert( m_spareNodes.end(), worker.nodes.begin(), worker.nodes.end() );
+		};
+
+		size_t numThreads = std::min<size_t>( std::thread::hardware_concurrency(), _tasks.size() );
+		std::vector<std::thread> threads;
+		for( size_t i=1; i<numThreads; ++i )
+			threads.push_back( std::thread(work) );
+		work();
+		for( size_t i=0; i<threads.size(); ++i )
+			threads[i].join();
+
+		if( !error.empty() ) throw error;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::ReadBlockHeader( const IFile& _file, int _srawFlags, BlockHeader& _header, std::string* _name )
+	{
+		// The first byte has CODE ELEM_TYPE nibbles
+		uint8_t codeNType = _file.Next();
+		_header.type = (ElementType)(codeNType & 0xf);
+		_header.codec = 0;
+		_header.directorySize = 0;
+		_header.reference = 0;
+
+		// Map all STRINGxx types to STRING but remember the size for ReadString.
+		// The number is useless for non string types
+		_header.stringSize = 1;
+		if( (int)_header.type <= 0x4 && _header.type > ElementType::STRING ) {
+			_header.stringSize = 1<<((int)_header.type-(int)ElementType::STRING);
+			_header.type = ElementType::STRING;
+		}
+
+		// Then the identifier follows as STRING8
+		if( _name ) ReadString( _file, 1, *_name );
+		else _file.Seek( _file.Next(), IFile::SeekMode::MOVE_FORWARD );
+
+		// Read NELEMS (array dimension)
+		bool swap = IsForeignEndian( _srawFlags );
+		_header.numElements = ReadSized( _file, NELEM_SIZE(codeNType), swap );
+
+		// Read or calculate the data block size (used to skip blocks)
+		if( (codeNType & SRAW_REFERENCE) && (_srawFlags & DEDUPLICATE) ) {
+			// A reference has no data block, only the distance back to the
+			// referenced NODE
+			if( _header.type != ElementType::NODE ) throw std::string("[Node::ReadSraw] Invalid reference.");
+			_header.reference = ReadBlockSize( _file, _srawFlags, swap );
+			_header.dataSize = 0;
+		} else if( _header.type == ElementType::NODE || _header.type == ElementType::STRING ) {
+			_header.dataSize = ReadBlockSize( _file, _srawFlags, swap );
+			if( _header.type == ElementType::NODE && (_srawFlags & CHILD_DIRECTORY) )
+				_header.directorySize = _header.numElements * DIRECTORY_ENTRY_SIZE;
+		} else if( (codeNType & SRAW_COMPRESSED) && (_srawFlags & COMPRESS) ) {
+			_header.codec = _file.Next();
+			_header.dataSize = ReadBlockSize( _file, _srawFlags, swap );
+		} else {
+			_header.dataSize = ArraySize( _header.numElements, _header.type );
+			// Skip the padding of aligned files
+			if( _srawFlags & (ALIGN_16 | ALIGN_64) )
+				_file.Seek( _file.Next(), IFile::SeekMode::MOVE_FORWARD );
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::FollowReference( const IFile& _file, int _srawFlags, uint64_t _position, BlockHeader& _header )
+	{
+		// Only complete blocks before the reference can be referenced. This
+		// excludes cycles.
+		uint64_t numElements = _header.numElements;
+		if( _header.reference > _position ) throw std::string("[Node::ReadSraw] Invalid reference.");
+		_file.Seek( _position - _header.reference );
+		ReadBlockHeader( _file, _srawFlags, _header, nullptr );
+		if( _header.type != ElementType::NODE || _header.reference || _header.numElements != numElements
+			|| _file.GetCursor() + _header.dataSize > _position )
+			throw std::string("[Node::ReadSraw] Invalid reference.");
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::ReadArrayPayload( const IFile& _file, int _srawFlags, const BlockHeader& _header, void* _data )
+	{
+		if( _file.GetCursor() + _header.dataSize > _file.GetSize() ) throw std::string("[Node::ReadSraw] Unexpected end of file.");
+		bool swap = IsForeignEndian( _srawFlags );
+		if( _header.codec )
+		{
+			std::vector<uint8_t> encoded( (size_t)_header.dataSize );
+			_file.Read( _header.dataSize, encoded.data() );
+			DecodeArray( _header.codec, _header.type, encoded.data(), _header.dataSize, _data, _header.numElements, swap );
+		} else if( _header.numElements > 0 ) {
+			int elementSize = int(ELEMENT_TYPE_SIZE[(int)_header.type] / 8);
+			if( swap && elementSize > 1 )
+				ReadSwapped( _file, _data, _header.numElements, elementSize );
+			else _file.Read( _header.dataSize, _data );
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::UnpackStrings( char* _data, const BlockHeader& _header, int _srawFlags, uint64_t* _ends )
+	{
+		bool swap = IsForeignEndian( _srawFlags );
+		uint64_t readPos = 0, writePos = 0;
+		for( uint64_t i=0; i<_header.numElements; ++i )
+		{
+			if( readPos + _header.stringSize > _header.dataSize ) throw std::string("[Node::ReadSraw] String data exceeds the block size.");
+			uint64_t length = LoadSized( (const uint8_t*)_data + readPos, _header.stringSize, swap );
+			readPos += _header.stringSize;
+			if( readPos + length > _header.dataSize ) throw std::string("[Node::ReadSraw] String data exceeds the block size.");
+			memmove( _data + writePos, _data + readPos, size_t(length) );
+			readPos += length;
+			writePos += length;
+			_ends[i] = writePos;
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::ConvertElements( const void* _src, ElementType _srcType, void* _dst, ElementType _dstType, uint64_t _num )
+	{
+		switch( _srcType )
+		{
+		case ElementType::INT8:		ConvertFrom( (const int8_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::INT16:	ConvertFrom( (const int16_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::INT32:	ConvertFrom( (const int32_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::INT64:	ConvertFrom( (const int64_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::UINT8:	ConvertFrom( (const uint8_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::UINT16:	ConvertFrom( (const uint16_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::UINT32:	ConvertFrom( (const uint32_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::UINT64:	ConvertFrom( (const uint64_t*)_src, _dst, _dstType, _num ); break;
+		case ElementType::FLOAT:	ConvertFrom( (const float*)_src, _dst, _dstType, _num ); break;
+		case ElementType::DOUBLE:	ConvertFrom( (const double*)_src, _dst, _dstType, _num ); break;
+		default: throw std::string("[MetaFileWrapper::ConvertElements] Source type must be numeric.");
+		}
+	}
+
+	// ********************************************************************* //
+	MetaFileWrapper::NameId MetaFileWrapper::FindName( const std::string& _name ) const
+	{
+		if( _name.empty() ) return &EmptyName;
+		// Lazy decoding can change the table at any time. Once everything
+		// is decoded the table stays as it is.
+		std::unique_lock<std::mutex> lock( m_sourceMutex, std::defer_lock );
+		if( m_numLazyNodes.load(std::memory_order_acquire) ) lock.lock();
+		auto it = m_names.find( _name );
+		return it == m_names.end() ? nullptr : &*it;
+	}
+
+	// ********************************************************************* //
+	size_t MetaFileWrapper::GetNumNames() const
+	{
+		std::unique_lock<std::mutex> lock( m_sourceMutex, std::defer_lock );
+		if( m_numLazyNodes.load(std::memory_order_acquire) ) lock.lock();
+		return m_names.size();
 	}
 
 
@@ -149,46 +864,105 @@ namespace Files {
 		m_lastAccessed( 0 ),
 		m_numElements( 0 ),
 		m_type( ElementType::UNKNOWN ),
-		m_name( _name )
+		m_name( _wrapper ? _wrapper->InternName(_name) : &EmptyName ),
+		m_strings( nullptr ),
+		m_stringCapacity( 0 ),
+		m_fileOffset( 0 ),
+		m_lazy( DECODED ),
+		m_inPlace( false ),
+		m_dirty( 0 ),
+		m_shareGeneration( 0 ),
+		m_readOnly( false ),
+		m_parent( nullptr ),
+		m_hash( 0 )
+	{
+	}
+
+	// ********************************************************************* //
+	MetaFileWrapper::Node::Node( const Node& _array, uint64_t _index ) :
+		m_file( nullptr ),
+		m_bufferArray( _array.m_bufferArray == _array.m_buffer ? m_buffer : _array.m_bufferArray ),
+		m_lastAccessed( _index ),
+		m_numElements( _array.m_numElements ),
+		m_type( _array.m_type ),
+		m_name( _array.m_name ),
+		m_strings( _array.m_strings ),
+		m_stringCapacity( 0 ),
+		m_fileOffset( 0 ),
+		m_lazy( DECODED ),
+		m_inPlace( false ),
+		m_dirty( 0 ),
+		m_shareGeneration( 0 ),
+		m_readOnly( _array.m_readOnly ),
+		m_parent( nullptr ),
+		m_hash( 0 )
 	{
+		if( m_bufferArray == m_buffer )
+			memcpy( m_buffer, _array.m_buffer, sizeof(m_buffer) );
 	}
 
 	// ********************************************************************* //
-	MetaFileWrapper::Node::Node( MetaFileWrapper* _wrapper, const IFile& _file, Format _format ) :
+	MetaFileWrapper::Node::Node( MetaFileWrapper* _wrapper, const IFile& _file, Format _format, ReadFlags _flags ) :
 		m_file( _wrapper ),
 		m_bufferArray( m_buffer ),
 		m_lastAccessed( 0 ),
 		m_numElements( 0 ),
 		m_type( ElementType::UNKNOWN ),
-		m_name("")
+		m_name( &EmptyName ),
+		m_strings( nullptr ),
+		m_stringCapacity( 0 ),
+		m_fileOffset( 0 ),
+		m_lazy( DECODED ),
+		m_inPlace( false ),
+		m_dirty( 0 ),
+		m_shareGeneration( 0 ),
+		m_readOnly( false ),
+		m_parent( nullptr ),
+		m_hash( 0 )
 	{
 		// Ignore empty files
-		if( !_file.IsEof() )
-			Read( _file, _format );
+		if( _file.IsEof() ) return;
+		try {
+			Read( _file, _format, _flags );
+		} catch( ... ) {
+			// The destructor does not run for a throwing constructor. Free
+			// what was read and leave an empty node for MetaFileWrapper::Read.
+			this->~Node();
+			new (this) Node( _wrapper, "" );
+			throw;
+		}
 	}
 
 	// ********************************************************************* //
 	MetaFileWrapper::Node::~Node()
 	{
-		if( m_file )	// Only if this is not a flat copy
+		// Only if this is not a flat copy. Nodes which were never decoded
+		// own nothing.
+		if( m_file && m_lazy != HEADER_ONLY )
 		{
 			if( m_type == ElementType::NODE )
 			{
+				// Children which were not looked up have no slot
 				for( uint64_t i=0; i<m_numElements; ++i )
-					m_file->m_nodePool.Delete( ((Node**)m_bufferArray)[i] );
-			} else if( m_type == ElementType::STRING )
-			{
-				for( uint64_t i=0; i<m_numElements; ++i )
-					((string*)m_bufferArray+i)->~string();
+					if( ((Node**)m_bufferArray)[i] )
+						m_file->DeleteNode( ((Node**)m_bufferArray)[i] );
 			}
+			// A running background save still reads the buffers
+			if( IsShared() ) Unshare( false );
+			// Snapshot nodes borrow the characters from the document
+			if( !m_inPlace ) free(m_strings);
 
-			if( ARRAY_SIZE(m_numElements, m_type) > sizeof(m_buffer) )
+			// UNKNOWN nodes have no size -> compare the address instead
+			if( m_bufferArray != m_buffer && !m_inPlace )
 				free(m_bufferArray);
 		}
+		// Name lookups rely on an exact count
+		if( m_file && m_lazy != DECODED )
+			m_file->m_numLazyNodes.fetch_sub( 1, std::memory_order_relaxed );
 	}
 
 	// ********************************************************************* //
-	void MetaFileWrapper::Node::Read( const IFile& _file, Format _format )
+	void MetaFileWrapper::Node::Read( const IFile& _file, Format _format, ReadFlags _flags )
 	{
 		// Read in the first few bytes to test which format it is.
 		// In json files either {" or {} are valid (expanded with white spaces).
@@ -197,11 +971,22 @@ namespace Files {
 		{
 			_format = Format::SRAW;	// Default if nothing else can be detected
 			try {
-				char charBuffer = FindFirstNonWhitespace(_file);
-				if( charBuffer == '{' ) {
-					charBuffer = FindFirstNonWhitespace(_file);
-					if( charBuffer == '}' || charBuffer == '"' )
-						_format = Format::JSON;
+				// A MessagePack map header cannot start a SRAW or JSON file.
+				// Neither can a CBOR map or the self-describe tag d9d9f7.
+				uint8_t first = _file.Next();
+				if( (first & 0xf0) == 0x80 || first == 0xde || first == 0xdf )
+					_format = Format::MSGPACK;
+				else if( (first >= 0xa0 && first <= 0xbb) || first == 0xbf
+					|| (first == 0xd9 && _file.Next() == 0xd9 && _file.Next() == 0xf7) )
+					_format = Format::CBOR;
+				else {
+					_file.Seek( 0 );
+					char charBuffer = FindFirstNonWhitespace(_file);
+					if( charBuffer == '{' ) {
+						charBuffer = FindFirstNonWhitespace(_file);
+						if( charBuffer == '}' || charBuffer == '"' )
+							_format = Format::JSON;
+					}
 				}
 			} catch(...) {}
 			// Let the parser see everything
@@ -209,7 +994,81 @@ namespace Files {
 		}
 		if( _format == Format::JSON ) 
 			ParseJson( _file );
-		else ReadSraw( _file );
+		else if( _format == Format::MSGPACK )
+			ReadBinary( _file, &Node::ParseMsgpack );
+		else if( _format == Format::CBOR )
+		{
+			// Typed arrays can stay in the file like SRAW arrays
+			if( _flags & (IN_PLACE | WRITE_THROUGH) ) m_file->m_sourceMemory = (const uint8_t*)_file.GetBuffer();
+			if( _flags & WRITE_THROUGH )
+			{
+				if( !_file.CanWrite() ) throw std::string("[Node::Read] WRITE_THROUGH requires a file with write access.");
+				m_file->m_writeThrough = m_file->m_sourceMemory != nullptr;
+			}
+			ReadBinary( _file, &Node::ParseCbor );
+		} else {
+			// Revision 2 files have a preamble
+			if( _file.Next() == SRAW_V2_MARKER )
+			{
+				uint8_t version = _file.Next();
+				if( version > SRAW_VERSION ) throw std::string("[Node::Read] Unsupported SRAW version.");
+				m_file->m_srawFlags = _file.Next();
+			} else _file.Seek( 1, IFile::SeekMode::MOVE_BACKWARD );
+
+			if( _flags & LAZY ) m_file->m_source = &_file;
+			if( _flags & (IN_PLACE | WRITE_THROUGH) ) m_file->m_sourceMemory = (const uint8_t*)_file.GetBuffer();
+			if( _flags & WRITE_THROUGH )
+			{
+				if( !_file.CanWrite() ) throw std::string("[Node::Read] WRITE_THROUGH requires a file with write access.");
+				// A patch of a referenced block would change all references
+				if( m_file->m_srawFlags & DEDUPLICATE ) throw std::string("[Node::Read] WRITE_THROUGH cannot be used for deduplicated files.");
+				m_file->m_writeThrough = m_file->m_sourceMemory != nullptr;
+			}
+			// Compressed arrays are decoded in parallel after the tree is
+			// built. A parallel read skips large blocks in the first pass.
+			ReadBatch batch;
+			batch.grain = 0;
+			const void* memory = _file.GetBuffer();
+			unsigned numThreads = std::thread::hardware_concurrency();
+			if( (_flags & PARALLEL) && !(_flags & LAZY) && memory && numThreads > 1 )
+				batch.grain = std::max( MIN_TASK_SIZE, _file.GetSize() / (numThreads * 8) );
+			// References share the subtrees of a sequential read. Otherwise
+			// each one is decoded on its own.
+			std::unordered_map<uint64_t, Node*> referenceTargets;
+			if( (m_file->m_srawFlags & DEDUPLICATE) && !(_flags & LAZY) && !batch.grain )
+				m_file->m_referenceTargets = &referenceTargets;
+			try {
+				ReadSraw( _file, (_flags & LAZY) != 0, &batch );
+			} catch(...) {
+				m_file->m_referenceTargets = nullptr;
+				throw;
+			}
+			m_file->m_referenceTargets = nullptr;
+			if( !batch.subtrees.empty() )
+				m_file->ReadSubtrees( memory, _file.GetSize(), batch.subtrees );
+			DecodePending( batch.arrays );
+		}
+		// The document as read is the reference of the journal
+		ClearDirty();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ReadBinary( const IFile& _file, const uint8_t* (Node::*_parse)( const uint8_t*, const uint8_t* ) )
+	{
+		// Parse the buffer of the file or read the rest of the file at once
+		uint64_t start = _file.GetCursor();
+		uint64_t size = _file.GetSize() - start;
+		const uint8_t* data = (const uint8_t*)_file.GetBuffer();
+		std::vector<uint8_t> content;
+		if( data ) data += start;
+		else {
+			content.resize( size_t(size) );
+			_file.Read( size, content.data() );
+			data = content.data();
+		}
+
+		const uint8_t* end = (this->*_parse)( data, data + size );
+		_file.Seek( start + (end - data) );
 	}
 
 	// ********************************************************************* //
@@ -255,8 +1114,10 @@ namespace Files {
 			if( isFloat ) {
 				*this = atof(number.c_str());
 			} else {
-				// Using strtoul allows reading numbers like 0xffffffff
-				*this = (int)strtoul(number.c_str(), nullptr, 0);
+				// Integers which do not fit into INT32 become INT64
+				int64_t value = strtoll(number.c_str(), nullptr, 10);
+				if( value == int32_t(value) ) *this = int32_t(value);
+				else *this = value;
 			}
 		}
 	}
@@ -268,9 +1129,41 @@ namespace Files {
 
 		// Now there are values or the end of the array.
 		char charBuffer = FindFirstNonWhitespace(_file);
+
+		// The type of a number array is known after the last element:
+		// INT32, INT64 if any value needs it or DOUBLE if there is a float.
+		if( (charBuffer >= '0' && charBuffer <= '9') || charBuffer == '-' )
+		{
+			std::vector<int64_t> integers;
+			std::vector<double> floats;
+			if( ReadJsonNumbers( _file, charBuffer, integers, floats ) )
+			{
+				Resize( floats.size(), ElementType::DOUBLE );
+				memcpy( GetData(), floats.data(), floats.size() * sizeof(double) );
+				return;
+			}
+			bool fits = true;
+			for( size_t i=0; i<integers.size() && fits; ++i )
+				fits = integers[i] == int32_t(integers[i]);
+			if( fits )
+			{
+				Resize( integers.size(), ElementType::INT32 );
+				int32_t* data = (int32_t*)GetData();
+				for( size_t i=0; i<integers.size(); ++i )
+					data[i] = int32_t(integers[i]);
+			} else {
+				Resize( integers.size(), ElementType::INT64 );
+				memcpy( GetData(), integers.data(), integers.size() * sizeof(int64_t) );
+			}
+			return;
+		}
+
 		uint64_t index = 0;
 		while( charBuffer != ']' )
 		{
+			// A null element would silently become a default value
+			if( charBuffer == 'n' && m_type != ElementType::NODE )
+				throw std::string("[Node::ParseJsonArray] null is only allowed in arrays of objects or arrays.");
 			// Most values are read plane into the array except other arrays
 			// or objects which require a new node.
 			if( charBuffer == '[' || charBuffer == '{' )
@@ -320,231 +1213,456 @@ namespace Files {
 	}
 
 	// ********************************************************************* //
-	void MetaFileWrapper::Node::ReadSraw( const IFile& _file )
+	void MetaFileWrapper::Node::ReadSrawHeader( const IFile& _file, BlockHeader& _header, bool _setName )
 	{
-		// The first byte has CODE ELEM_TYPE nibbles
+		std::string name;
+		ReadBlockHeader( _file, m_file->m_srawFlags, _header, _setName ? &name : nullptr );
+		if( _setName ) SetName( name );
+		m_type = _header.type;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::SkipSraw( const IFile& _file )
+	{
+		m_fileOffset = _file.GetCursor();
+		BlockHeader header;
+		ReadSrawHeader( _file, header, true );
+		// Only the header is valid. The node does not own any memory yet.
+		// A reference is followed when the node is decoded.
+		m_numElements = header.numElements;
+		m_lazy.store( HEADER_ONLY, std::memory_order_relaxed );
+		m_file->m_numLazyNodes.fetch_add( 1, std::memory_order_relaxed );
+		_file.Seek( header.dataSize, IFile::SeekMode::MOVE_FORWARD );
+	}
+
+	// ********************************************************************* //
+	bool MetaFileWrapper::Node::ShareReference( const IFile& _file, Node*& _child )
+	{
+		uint64_t position = _file.GetCursor();
 		uint8_t codeNType = _file.Next();
-		m_type = (ElementType)(codeNType & 0xf);
+		_file.Seek( position );
+		if( !(codeNType & SRAW_REFERENCE) ) return false;
+
+		BlockHeader header;
+		std::string name;
+		ReadBlockHeader( _file, m_file->m_srawFlags, header, &name );
+		auto it = header.reference <= position ? m_file->m_referenceTargets->find( position - header.reference ) : m_file->m_referenceTargets->end();
+		// A node has a single name. Differently named copies are decoded
+		// on their own.
+		if( it == m_file->m_referenceTargets->end() || *it->second->m_name != name
+			|| it->second->m_numElements != header.numElements )
+		{
+			_file.Seek( position );
+			return false;
+		}
+		m_file->m_nodePool.Delete( _child );
+		_child = it->second;
+		m_file->ShareNode( _child );
+		return true;
+	}
 
-		// Map all STRINGxx types to STRING but remember the size for ReadString.
-		// The number is useless for non string types
-		int stringSize = 1;
-		if( (int)m_type <= 0x4 && m_type > ElementType::STRING ) {
-			stringSize = 1<<((int)m_type-(int)MetaFileWrapper::ElementType::STRING);
-			m_type = ElementType::STRING;
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::SetReadOnly()
+	{
+		m_readOnly = true;
+		if( m_type == ElementType::NODE )
+			for( uint64_t i=0; i<m_numElements; ++i )
+				Child(i)->SetReadOnly();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::DecodeLazy() const
+	{
+		std::lock_guard<std::mutex> lock( m_file->m_sourceMutex );
+		// An other thread could have been faster
+		if( m_lazy.load(std::memory_order_relaxed) != HEADER_ONLY ) return;
+
+		// Decoding does not change any property visible in the header.
+		// Readers have to wait for m_lazy before they can see anything else.
+		Node* self = const_cast<Node*>(this);
+		self->m_numElements = 0;
+		m_file->m_source->Seek( m_fileOffset );
+		self->ReadSraw( *m_file->m_source, true );
+		self->m_dirty = 0;
+		// ReadSraw switches to CHILDREN_PENDING if the node has a directory
+		uint8_t state = m_lazy.load( std::memory_order_relaxed );
+		m_lazy.store( state == HEADER_ONLY ? (uint8_t)DECODED : state, std::memory_order_release );
+		// Publishes the new names to lookups without lock
+		m_file->m_numLazyNodes.fetch_sub( 1, std::memory_order_release );
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::DecodeDirectory() const
+	{
+		std::lock_guard<std::mutex> lock( m_file->m_sourceMutex );
+		if( m_lazy.load(std::memory_order_relaxed) != CHILDREN_PENDING ) return;
+
+		const IFile& file = *m_file->m_source;
+		std::vector<uint64_t> directory( (size_t)(m_numElements * 2) );
+		file.Seek( m_fileOffset );
+		if( m_numElements )
+		{
+			file.Read( m_numElements * DIRECTORY_ENTRY_SIZE, &directory[0] );
+			if( IsForeignEndian( m_file->m_srawFlags ) )
+				SwapBytes( &directory[0], &directory[0], m_numElements * 2, 8 );
 		}
 
-		// Then the identifier follows as STRING8
-		ReadString( _file, 1, m_name );
+		// Create the headers of all children which were not looked up
+		Node** children = (Node**)m_bufferArray;
+		for( uint64_t i=0; i<m_numElements; ++i )
+		{
+			uint64_t index = directory[size_t(i*2+1)];
+			if( index >= m_numElements ) throw std::string("[Node::DecodeDirectory] Invalid child index.");
+			if( !children[index] )
+			{
+				file.Seek( m_fileOffset + directory[size_t(i*2)] );
+				children[index] = new (m_file->AllocNode()) Node( m_file, "" );
+				children[index]->m_parent = const_cast<Node*>(this);
+				children[index]->SkipSraw( file );
+			}
+		}
+		m_lazy.store( DECODED, std::memory_order_release );
+		m_file->m_numLazyNodes.fetch_sub( 1, std::memory_order_release );
+	}
 
-		// Read NELEMS (array dimension)
-		uint64_t numElements = 0;
-		_file.Read( NELEM_SIZE(codeNType), &numElements );
+	// ********************************************************************* //
+	const MetaFileWrapper::Node* MetaFileWrapper::Node::FindInDirectory( const std::string& _name ) const
+	{
+		std::lock_guard<std::mutex> lock( m_file->m_sourceMutex );
+		const IFile& file = *m_file->m_source;
+
+		// Find the first entry which is not less than _name. This is the
+		// child with the smallest index if names are ambiguous.
+		uint64_t entry[2];
+		std::string name;
+		bool swap = IsForeignEndian( m_file->m_srawFlags );
+		uint64_t first = 0, count = m_numElements;
+		while( count > 0 )
+		{
+			uint64_t step = count / 2;
+			ReadDirectoryEntry( file, m_fileOffset, first + step, swap, entry, name );
+			if( name < _name ) { first += step + 1; count -= step + 1; }
+			else count = step;
+		}
+		if( first == m_numElements ) return nullptr;
+		ReadDirectoryEntry( file, m_fileOffset, first, swap, entry, name );
+		if( name != _name ) return nullptr;
+
+		// The slot exists if the child was found before or the node was
+		// decoded meanwhile.
+		uint64_t index = entry[1];
+		if( index >= m_numElements ) throw std::string("[Node::FindInDirectory] Invalid child index.");
+		Node*& child = ((Node**)m_bufferArray)[index];
+		if( !child )
+		{
+			file.Seek( m_fileOffset + entry[0] );
+			child = new (m_file->AllocNode()) Node( m_file, "" );
+			child->m_parent = const_cast<Node*>(this);
+			child->SkipSraw( file );
+		}
+		return child;
+	}
 
-		// Read or calculate the data block size (could be used to skip blocks too)
-		uint64_t dataSize;
-		if( m_type == ElementType::NODE || m_type == ElementType::STRING )
-			_file.Read( 8, &dataSize );
-		else
-			dataSize = ARRAY_SIZE(numElements, m_type);
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ReadSraw( const IFile& _file, bool _lazy, ReadBatch* _batch )
+	{
+		uint64_t headerPosition = _file.GetCursor();
+		// The name of a lazy node is known already
+		BlockHeader header;
+		ReadSrawHeader( _file, header, m_lazy.load(std::memory_order_relaxed) != HEADER_ONLY );
+		if( header.reference )
+		{
+			// Decode the referenced block into this node and continue after
+			// the reference
+			uint64_t end = _file.GetCursor();
+			FollowReference( _file, m_file->m_srawFlags, headerPosition, header );
+			ReadSrawData( _file, header, headerPosition, _lazy, nullptr );
+			_file.Seek( end );
+		} else ReadSrawData( _file, header, headerPosition, _lazy, _batch );
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ReadSrawData( const IFile& _file, const BlockHeader& _header, uint64_t _position, bool _lazy, ReadBatch* _batch )
+	{
+		uint64_t numElements = _header.numElements;
+		uint64_t dataSize = _header.dataSize;
+		uint8_t codec = _header.codec;
+		bool directory = m_type == ElementType::NODE && (m_file->m_srawFlags & CHILD_DIRECTORY);
+
+		if( directory && _lazy )
+		{
+			// Create empty slots only. The children are read when they are
+			// looked up or when all children are required.
+			uint64_t size = ArraySize( numElements, m_type );
+			if( size > sizeof(m_buffer) ) m_bufferArray = malloc( size_t(size) );
+			memset( m_bufferArray, 0, size_t(size) );
+			m_numElements = numElements;
+			m_fileOffset = _file.GetCursor();
+			m_lazy.store( CHILDREN_PENDING, std::memory_order_relaxed );
+			m_file->m_numLazyNodes.fetch_add( 1, std::memory_order_relaxed );
+			return;
+		}
+
+		// Hand large blocks to the workers of a parallel read. Nodes which
+		// are too large for a single task are split into their children.
+		if( _batch && _batch->grain && this != &m_file->RootNode && dataSize >= MIN_TASK_SIZE
+			&& (m_type != ElementType::NODE || dataSize <= _batch->grain) )
+		{
+			SubtreeTask task = { this, _position, dataSize };
+			_batch->subtrees.push_back( task );
+			_file.Seek( dataSize, IFile::SeekMode::MOVE_FORWARD );
+			return;
+		}
+
+		if( codec )
+		{
+			if( _file.GetCursor() + dataSize > _file.GetSize() ) throw std::string("[Node::ReadSraw] Unexpected end of file.");
+			Resize( numElements );
+			std::vector<uint8_t> encoded( (size_t)dataSize );
+			_file.Read( dataSize, encoded.data() );
+			if( _batch )
+			{
+				_batch->arrays.resize( _batch->arrays.size() + 1 );
+				PendingArray& array = _batch->arrays.back();
+				array.node = this;
+				array.codec = codec;
+				array.encoded.swap( encoded );
+			} else
+				DecodeArray( codec, m_type, encoded.data(), dataSize, m_bufferArray, m_numElements, IsForeignEndian( m_file->m_srawFlags ) );
+			return;
+		}
+
+		// Arrays of foreign byte order must be converted
+		bool swap = IsForeignEndian( m_file->m_srawFlags );
+		// Small arrays are cheaper to copy unless they are patched in the
+		// source.
+		if( m_file->m_sourceMemory && !swap && m_type > ElementType::STRING
+			&& (dataSize > sizeof(m_buffer) || m_file->m_writeThrough) )
+		{
+			// Use the array from the source if the element type is aligned
+			const uint8_t* data = m_file->m_sourceMemory + _file.GetCursor();
+			uint64_t alignment = std::max<uint64_t>( 1, ELEMENT_TYPE_SIZE[(int)m_type] / 8 );
+			if( ((uintptr_t)data % alignment) == 0 )
+			{
+				if( _file.GetCursor() + dataSize > _file.GetSize() ) throw std::string("[Node::ReadSraw] Unexpected end of file.");
+				m_bufferArray = const_cast<uint8_t*>(data);
+				m_inPlace = true;
+				m_numElements = numElements;
+				_file.Seek( dataSize, IFile::SeekMode::MOVE_FORWARD );
+				return;
+			}
+		}
 
 		Resize( numElements );
 
 		if( m_type == ElementType::NODE )
 		{
+			if( directory )
+				_file.Seek( m_numElements * DIRECTORY_ENTRY_SIZE, IFile::SeekMode::MOVE_FORWARD );
 			// Recursive read (file cursor is at the correct position).
+			std::unordered_map<uint64_t, Node*>* targets = m_file->m_referenceTargets;
 			for( uint64_t i=0; i<m_numElements; ++i )
 			{
-				((Node**)m_bufferArray)[i]->ReadSraw( _file );
+				Node*& child = ((Node**)m_bufferArray)[i];
+				uint64_t position = _file.GetCursor();
+				if( _lazy ) child->SkipSraw( _file );
+				else if( !targets || !ShareReference( _file, child ) )
+				{
+					child->ReadSraw( _file, false, _batch );
+					// Complete subtrees can be referenced by later blocks
+					if( targets && child->m_type == ElementType::NODE )
+						(*targets)[position] = child;
+				}
 			}
 		} else {
 			// Now the files cursor is at the beginning of the data
 			if( m_type == ElementType::STRING )
 			{
-				// Buffer single string objects
-				for( uint64_t i=0; i<m_numElements; ++i )
-					ReadString( _file, stringSize, ((std::string*)m_bufferArray)[i] );
-			} else if( m_numElements > 0 ) {
-				_file.Read( dataSize, m_bufferArray );
-			}
+				// Read all length-prefixed strings with one access and
+				// remove the length fields in place afterwards.
+				m_strings = (char*)malloc( size_t(dataSize) );
+				m_stringCapacity = dataSize;
+				_file.Read( dataSize, m_strings );
+				UnpackStrings( m_strings, _header, m_file->m_srawFlags, (uint64_t*)m_bufferArray );
+			} else ReadArrayPayload( _file, m_file->m_srawFlags, _header, m_bufferArray );
 		}
 	}
 
 
 	// ********************************************************************* //
-	float MetaFileWrapper::Node::Get( float _default ) const
+	float MetaFileWrapper::Node::GetAt( uint64_t _index, float _default ) const
 	{
 		switch(m_type)
 		{
 		case ElementType::FLOAT:
-			return (float)*this;
+			return Element<float>(_index);
 		case ElementType::DOUBLE:
-			return float((double)*this);
+			return float(Element<double>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	double MetaFileWrapper::Node::Get( double _default ) const
+	double MetaFileWrapper::Node::GetAt( uint64_t _index, double _default ) const
 	{
 		switch(m_type)
 		{
 		case ElementType::FLOAT:
-			return (float)*this;
+			return Element<float>(_index);
 		case ElementType::DOUBLE:
-			return (double)*this;
+			return Element<double>(_index);
 		default:
 			return _default;
 		}
 	}
 
-	int8_t MetaFileWrapper::Node::Get( int8_t _default ) const
+	int8_t MetaFileWrapper::Node::GetAt( uint64_t _index, int8_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return int8_t((int8_t)*this);
+			return int8_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return int8_t((uint8_t)*this);
+			return int8_t(Element<uint8_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	uint8_t MetaFileWrapper::Node::Get( uint8_t _default ) const
+	uint8_t MetaFileWrapper::Node::GetAt( uint64_t _index, uint8_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return uint8_t((int8_t)*this);
+			return uint8_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return uint8_t((uint8_t)*this);
+			return uint8_t(Element<uint8_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	int16_t MetaFileWrapper::Node::Get( int16_t _default ) const
+	int16_t MetaFileWrapper::Node::GetAt( uint64_t _index, int16_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return int16_t((int8_t)*this);
+			return int16_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT16:
-			return int16_t((int16_t)*this);
+			return int16_t(Element<int16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return int16_t((uint8_t)*this);
+			return int16_t(Element<uint8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT16:
-			return int16_t((uint16_t)*this);
+			return int16_t(Element<uint16_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	uint16_t MetaFileWrapper::Node::Get( uint16_t _default ) const
+	uint16_t MetaFileWrapper::Node::GetAt( uint64_t _index, uint16_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return uint16_t((int8_t)*this);
+			return uint16_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT16:
-			return uint16_t((int16_t)*this);
+			return uint16_t(Element<int16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return uint16_t((uint8_t)*this);
+			return uint16_t(Element<uint8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT16:
-			return uint16_t((uint16_t)*this);
+			return uint16_t(Element<uint16_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	int32_t MetaFileWrapper::Node::Get( int32_t _default ) const
+	int32_t MetaFileWrapper::Node::GetAt( uint64_t _index, int32_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return int32_t((int8_t)*this);
+			return int32_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT16:
-			return int32_t((int16_t)*this);
+			return int32_t(Element<int16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT32:
-			return int32_t((int32_t)*this);
+			return int32_t(Element<int32_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return int32_t((uint8_t)*this);
+			return int32_t(Element<uint8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT16:
-			return int32_t((uint16_t)*this);
+			return int32_t(Element<uint16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT32:
-			return int32_t((uint32_t)*this);
+			return int32_t(Element<uint32_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	uint32_t MetaFileWrapper::Node::Get( uint32_t _default ) const
+	uint32_t MetaFileWrapper::Node::GetAt( uint64_t _index, uint32_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return uint32_t((int8_t)*this);
+			return uint32_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT16:
-			return uint32_t((int16_t)*this);
+			return uint32_t(Element<int16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT32:
-			return uint32_t((int32_t)*this);
+			return uint32_t(Element<int32_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return uint32_t((uint8_t)*this);
+			return uint32_t(Element<uint8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT16:
-			return uint32_t((uint16_t)*this);
+			return uint32_t(Element<uint16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT32:
-			return uint32_t((uint32_t)*this);
+			return uint32_t(Element<uint32_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	int64_t MetaFileWrapper::Node::Get( int64_t _default ) const
+	int64_t MetaFileWrapper::Node::GetAt( uint64_t _index, int64_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return int64_t((int8_t)*this);
+			return int64_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT16:
-			return int64_t((int16_t)*this);
+			return int64_t(Element<int16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT32:
-			return int64_t((int32_t)*this);
+			return int64_t(Element<int32_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT64:
-			return int64_t((int64_t)*this);
+			return int64_t(Element<int64_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return int64_t((uint8_t)*this);
+			return int64_t(Element<uint8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT16:
-			return int64_t((uint16_t)*this);
+			return int64_t(Element<uint16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT32:
-			return int64_t((uint32_t)*this);
+			return int64_t(Element<uint32_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT64:
-			return int64_t((uint64_t)*this);
+			return int64_t(Element<uint64_t>(_index));
 		default:
 			return _default;
 		}
 	}
 
-	uint64_t MetaFileWrapper::Node::Get( uint64_t _default ) const
+	uint64_t MetaFileWrapper::Node::GetAt( uint64_t _index, uint64_t _default ) const
 	{
 		switch(m_type)
 		{
 		case Jo::Files::MetaFileWrapper::ElementType::INT8:
-			return uint64_t((int8_t)*this);
+			return uint64_t(Element<int8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT16:
-			return uint64_t((int16_t)*this);
+			return uint64_t(Element<int16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT32:
-			return uint64_t((int32_t)*this);
+			return uint64_t(Element<int32_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::INT64:
-			return uint64_t((int64_t)*this);
+			return uint64_t(Element<int64_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT8:
-			return uint64_t((uint8_t)*this);
+			return uint64_t(Element<uint8_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT16:
-			return uint64_t((uint16_t)*this);
+			return uint64_t(Element<uint16_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT32:
-			return uint64_t((uint32_t)*this);
+			return uint64_t(Element<uint32_t>(_index));
 		case Jo::Files::MetaFileWrapper::ElementType::UINT64:
-			return uint64_t((uint64_t)*this);
+			return uint64_t(Element<uint64_t>(_index));
 		default:
 			return _default;
 		}
@@ -554,31 +1672,38 @@ namespace Files {
 	// ********************************************************************* //
 	void MetaFileWrapper::Node::SaveAsJson( IFile& _file, int _indent ) const
 	{
-		// Do not save unknown garbage
-		if( m_type == ElementType::UNKNOWN ) return;
+		// An empty wrapper produces an empty file
+		if( m_type == ElementType::UNKNOWN && this == &m_file->RootNode ) return;
 
 		std::string buffer;
 		// Start with indent + identifier
-		if( _indent != 0 && m_name != "" )	// Not for root node or unnamed nodes
+		if( _indent != 0 && !m_name->empty() )	// Not for root node or unnamed nodes
 		{
 			buffer = "";
 			for( int i=0; i<_indent; ++i )
 				buffer += ' ';
 			// "Name": 
-			buffer += '\"' + m_name + "\": ";
+			buffer += '\"' + *m_name + "\": ";
 			_file.Write( buffer.c_str(), buffer.length() );
 		} else for( int i=0; i<_indent; ++i ) _file.Write( " ", 1 );
 
+		// The parent already counted this value -> keep the json valid
+		if( m_type == ElementType::UNKNOWN )
+		{
+			_file.Write( "null", 4 );
+			return;
+		}
+
 		// Add nodes recursively
 		if( m_type == ElementType::NODE )
 		{
 			// Node arrays? Look if there is a child without name.
-			bool nodeArray = (m_numElements==0) || (*this)[0].m_name == "";
+			bool nodeArray = (m_numElements==0) || Child(0)->m_name->empty();
 			if( nodeArray )	_file.Write( "[\n", 2 );
 			else _file.Write( "{\n", 2 );
 			for( uint64_t i=0; i<m_numElements; ++i )
 			{
-				(*this)[i].SaveAsJson( _file, _indent+2 );
+				Child(i)->SaveAsJson( _file, _indent+2 );
 				// All variables are delimited by ,
 				if(i+1<m_numElements) _file.Write( ",\n", 2 );
 				else _file.Write( "\n", 1 );
@@ -591,24 +1716,27 @@ namespace Files {
 			// If there is more than one element add array syntax []
 			// Also use [] for empty data arrays.
 			// This is a child node of an array -> Array of value-arrays
-			bool isArray = (m_name == "") || ( m_numElements != 1 );
+			bool isArray = m_name->empty() || ( m_numElements != 1 );
 			if(isArray) _file.Write( "[", 1 );
 			for( uint64_t i=0; i<m_numElements; ++i )
 			{
 				switch( m_type )
 				{
-				case ElementType::BIT:		if((*this)[i]) buffer = "true"; else buffer = "false";	break;
-				case ElementType::DOUBLE:	buffer = std::to_string( double((*this)[i]) );			break;
-				case ElementType::FLOAT:	buffer = std::to_string( float((*this)[i]) );			break;
-				case ElementType::INT8:		buffer = std::to_string( int8_t((*this)[i]) );			break;
-				case ElementType::INT16:	buffer = std::to_string( int16_t((*this)[i]) );			break;
-				case ElementType::INT32:	buffer = std::to_string( int32_t((*this)[i]) );			break;
-				case ElementType::INT64:	buffer = std::to_string( int64_t((*this)[i]) );			break;
-				case ElementType::UINT8:	buffer = std::to_string( uint8_t((*this)[i]) );			break;
-				case ElementType::UINT16:	buffer = std::to_string( uint16_t((*this)[i]) );		break;
-				case ElementType::UINT32:	buffer = std::to_string( uint32_t((*this)[i]) );		break;
-				case ElementType::UINT64:	buffer = std::to_string( uint64_t((*this)[i]) );		break;
-				case ElementType::STRING:	buffer = '\"' + (std::string)((*this)[i]) + '\"';		break;
+				case ElementType::BIT:		buffer = BitElement(i) ? "true" : "false";			break;
+				case ElementType::DOUBLE:	buffer = std::to_string( Element<double>(i) );		break;
+				case ElementType::FLOAT:	buffer = std::to_string( Element<float>(i) );		break;
+				case ElementType::INT8:		buffer = std::to_string( Element<int8_t>(i) );		break;
+				case ElementType::INT16:	buffer = std::to_string( Element<int16_t>(i) );		break;
+				case ElementType::INT32:	buffer = std::to_string( Element<int32_t>(i) );		break;
+				case ElementType::INT64:	buffer = std::to_string( Element<int64_t>(i) );		break;
+				case ElementType::UINT8:	buffer = std::to_string( Element<uint8_t>(i) );		break;
+				case ElementType::UINT16:	buffer = std::to_string( Element<uint16_t>(i) );	break;
+				case ElementType::UINT32:	buffer = std::to_string( Element<uint32_t>(i) );	break;
+				case ElementType::UINT64:	buffer = std::to_string( Element<uint64_t>(i) );	break;
+				case ElementType::STRING: {
+					StringView view = GetStringView( i );
+					buffer.assign( 1, '\"' ).append( view.data, size_t(view.length) ) += '\"';
+					} break;
 				default: break;
 				}
 				_file.Write( buffer.c_str(), buffer.length() );
@@ -619,54 +1747,203 @@ namespace Files {
 	}
 
 	// ********************************************************************* //
-	void MetaFileWrapper::Node::SaveAsSraw( IFile& _file ) const
+	void MetaFileWrapper::Node::SaveAsSraw( IFile& _file, WriteFlags _flags ) const
+	{
+		SrawWriteState state;
+		if( _flags & VARINT_SIZES )
+		{
+			if( _flags & (ALIGN_16 | ALIGN_64) ) throw std::string("[Node::SaveAsSraw] VARINT_SIZES cannot be combined with an alignment.");
+			GetSizeBounds( _flags, state.sizeBounds );
+		}
+		WriteSraw( _file, _flags, state );
+	}
+
+	// ********************************************************************* //
+	uint64_t MetaFileWrapper::Node::GetSizeBounds( WriteFlags _flags, std::unordered_map<const Node*, uint64_t>& _bounds ) const
 	{
-		// Do not save unknown garbage
-		if( m_type == ElementType::UNKNOWN ) return;
+		uint64_t headerSize = 2 + m_name->length() + (1<<GetNumRequiredBytes(m_numElements));
+		if( m_type == ElementType::UNKNOWN ) return headerSize + 1;
+		if( m_type == ElementType::NODE )
+		{
+			uint64_t dataSize = (_flags & CHILD_DIRECTORY) ? m_numElements * DIRECTORY_ENTRY_SIZE : 0;
+			for( uint64_t i=0; i<m_numElements; ++i )
+				dataSize += Child(i)->GetSizeBounds( _flags, _bounds );
+			_bounds[this] = dataSize;
+			return headerSize + VarintSize( dataSize ) + dataSize;
+		}
+		if( m_type == ElementType::STRING )
+		{
+			uint64_t dataSize = GetDataSize();
+			return headerSize + VarintSize( dataSize ) + dataSize;
+		}
+		// Compressed arrays are only used if they are smaller than the raw
+		// ones, CODEC and SIZE come on top.
+		uint64_t dataSize = ArraySize( m_numElements, m_type );
+		if( _flags & COMPRESS ) dataSize += 11;
+		return headerSize + dataSize;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::WriteSraw( IFile& _file, WriteFlags _flags, SrawWriteState& _state ) const
+	{
+		// Untyped nodes (json null or []) are stored as empty nodes. The
+		// element count of the parent would be wrong otherwise.
+		if( m_type == ElementType::UNKNOWN )
+		{
+			if( this == &m_file->RootNode ) return;
+			uint8_t header[2] = { uint8_t(ElementType::NODE), uint8_t(m_name->length()) };
+			_file.Write( header, 2 );
+			_file.Write( m_name->data(), header[1] );
+			uint8_t numElements = 0;
+			_file.Write( &numElements, 1 );
+			WriteBlockSize( _file, 0, 1, _flags );
+			return;
+		}
+
+		// A subtree equal to one which was written before is replaced by
+		// the distance back to it. With VARINT_SIZES the reference must
+		// not be larger than the reserved size bound.
+		uint64_t reference = 0;
+		uint64_t headerPosition = _file.GetCursor();
+		if( (_flags & DEDUPLICATE) && m_type == ElementType::NODE && m_numElements > 0
+			&& (!(_flags & VARINT_SIZES) || _state.sizeBounds[this] >= 9) )
+		{
+			uint64_t hash = GetHash();
+			auto range = _state.written.equal_range( hash );
+			for( auto it = range.first; it != range.second && !reference; ++it )
+				if( SameContent( *it->second.first ) )
+					reference = headerPosition - it->second.second;
+			if( !reference )
+				_state.written.insert( std::make_pair( hash, std::make_pair( this, headerPosition ) ) );
+		}
 
 		// Determine correct string type
 		ElementType _storeType = m_type;
 		int _stringSize;
+		uint64_t dataSize = 0;
 		if( m_type == ElementType::STRING )
 		{
-			GetDataSize( &_stringSize );
+			dataSize = GetDataSize( &_stringSize );
 			if( _stringSize == 2 ) _storeType = ElementType((int)_storeType+1);
 			else if( _stringSize == 4 ) _storeType = ElementType((int)_storeType+2);
 			else if( _stringSize == 8 ) _storeType = ElementType((int)_storeType+3);
 		}
 
+		// Store integers with the smallest type which holds all values
+		const void* data = m_bufferArray;
+		std::vector<uint8_t> narrowed;
+		if( (_flags & NARROW_INTEGERS) && m_type >= ElementType::INT8 && m_type <= ElementType::UINT64 )
+		{
+			_storeType = NarrowestType( m_type, m_bufferArray, m_numElements );
+			if( _storeType != m_type )
+			{
+				narrowed.resize( size_t(ArraySize( m_numElements, _storeType )) );
+				ConvertElements( m_bufferArray, m_type, narrowed.data(), _storeType, m_numElements );
+				data = narrowed.data();
+			}
+		}
+
+		// Compress large arrays if this makes them smaller
+		std::vector<uint8_t> encoded;
+		uint8_t codec = 0;
+		if( (_flags & COMPRESS) && m_type > ElementType::STRING && ArraySize( m_numElements, _storeType ) >= COMPRESSION_THRESHOLD )
+			codec = EncodeArray( _storeType, data, m_numElements, encoded );
+
 		// TYPE
 		uint8_t code = (GetNumRequiredBytes(m_numElements)<<4) | uint8_t(_storeType);
+		if( codec ) code |= SRAW_COMPRESSED;
+		if( reference ) code |= SRAW_REFERENCE;
 		_file.Write( &code, 1 );
 
 		// IDENTIFIER
-		uint8_t length = uint8_t(m_name.length());
+		uint8_t length = uint8_t(m_name->length());
 		_file.Write( &length, 1 );
-		_file.Write( &m_name[0], length );
+		_file.Write( m_name->data(), length );
 
 		// NELEMS
-		_file.Write( &m_numElements, NELEM_SIZE(code) );
+		WriteSized( _file, m_numElements, NELEM_SIZE(code) );
+
+		// [REFERENCE]
+		if( reference )
+		{
+			WriteBlockSize( _file, reference, VarintSize( reference ), _flags );
+			return;
+		}
 
 		// [SIZE]
-		uint64_t dataSize = GetDataSize();
+		// The size of a NODE block is known after all children are written.
+		// A placeholder is patched afterwards which avoids recursive size
+		// computations. Variable length sizes of nodes reserve the bytes of
+		// an upper bound.
+		uint64_t sizePosition = _file.GetCursor();
+		int sizeBytes = 8;
+		if( _flags & VARINT_SIZES )
+			sizeBytes = VarintSize( m_type == ElementType::NODE ? _state.sizeBounds[this] : dataSize );
 		if( m_type == ElementType::NODE || m_type == ElementType::STRING )
-			_file.Write( &dataSize, 8 );
+			WriteBlockSize( _file, dataSize, sizeBytes, _flags );
 
 		// data
 		if( m_type == ElementType::NODE )
 		{
-			// Recursive write.
-			for( uint64_t i=0; i<m_numElements; ++i )
-				((Node**)m_bufferArray)[i]->SaveAsSraw( _file );
-		} else if( m_type == ElementType::STRING ) {
+			// The directory is patched together with the size
+			std::vector<uint64_t> directory;
+			bool hasDirectory = (_flags & CHILD_DIRECTORY) && m_numElements;
+			if( hasDirectory )
+			{
+				directory.resize( size_t(m_numElements * 2) );
+				_file.Write( &directory[0], m_numElements * DIRECTORY_ENTRY_SIZE );
+			}
+
+			// Recursive write. Children are stored in index order.
+			uint64_t dataStart = sizePosition + sizeBytes;
+			std::vector<uint64_t> offsets( hasDirectory ? (size_t)m_numElements : 0 );
 			for( uint64_t i=0; i<m_numElements; ++i )
 			{
-				uint64_t length = ((std::string*)m_bufferArray)[i].length();
-				_file.Write( &length, _stringSize );
-				_file.Write( ((std::string*)m_bufferArray)[i].data(), length );
+				if( hasDirectory ) offsets[size_t(i)] = _file.GetCursor() - dataStart;
+				Child(i)->WriteSraw( _file, _flags, _state );
+			}
+			uint64_t end = _file.GetCursor();
+
+			if( hasDirectory )
+			{
+				// Sort the entries by name. Equal names keep the index order.
+				Node** children = (Node**)m_bufferArray;
+				std::vector<uint64_t> order( (size_t)m_numElements );
+				for( uint64_t i=0; i<m_numElements; ++i ) order[size_t(i)] = i;
+				std::stable_sort( order.begin(), order.end(), [children]( uint64_t _a, uint64_t _b ) {
+					return *children[_a]->m_name < *children[_b]->m_name;
+				} );
+				for( uint64_t i=0; i<m_numElements; ++i )
+				{
+					directory[size_t(i*2)] = offsets[size_t(order[size_t(i)])];
+					directory[size_t(i*2+1)] = order[size_t(i)];
+				}
 			}
+
+			dataSize = end - dataStart;
+			_file.Seek( sizePosition );
+			WriteBlockSize( _file, dataSize, sizeBytes, _flags );
+			if( hasDirectory )
+				_file.Write( &directory[0], m_numElements * DIRECTORY_ENTRY_SIZE );
+			_file.Seek( end );
+		} else if( m_type == ElementType::STRING ) {
+			WriteStrings( _file, _stringSize, (const uint64_t*)m_bufferArray, m_strings, m_numElements );
+		} else if( codec ) {
+			// CODEC, SIZE and the compressed data
+			_file.Write( &codec, 1 );
+			dataSize = encoded.size();
+			WriteBlockSize( _file, dataSize, VarintSize( dataSize ), _flags );
+			_file.Write( encoded.data(), dataSize );
 		} else {
-			_file.Write( m_bufferArray, dataSize );
+			uint64_t payloadSize = ArraySize( m_numElements, _storeType );
+			if( _flags & (ALIGN_16 | ALIGN_64) )
+			{
+				static const uint8_t ZEROS[64] = {0};
+				uint8_t padding = PaddingSize( _flags, _file.GetCursor(), payloadSize );
+				_file.Write( &padding, 1 );
+				_file.Write( ZEROS, padding );
+			}
+			_file.Write( data, payloadSize );
 		}
 	}
 
@@ -684,23 +1961,27 @@ namespace Files {
 	// ********************************************************************* //
 	MetaFileWrapper::Node& MetaFileWrapper::Node::operator[]( const std::string& _name )
 	{
-		if( m_type == ElementType::UNKNOWN ) m_type = ElementType::NODE;
-		if( m_type != ElementType::NODE ) throw "Node '" + m_name + "' is of an elementary type and has no named children.";
+		if( m_type == ElementType::UNKNOWN ) { CheckWritable(); m_type = ElementType::NODE; MarkDirty( DIRTY_SUBTREE ); }
+		if( m_type != ElementType::NODE ) throw "Node '" + *m_name + "' is of an elementary type and has no named children.";
+		ResolveChildren();
 		
 		// Linear search for the correct child (assumes only a few children
-		// and requires array access -> no hash map)
-		unsigned int m_lastAccessed = 0;
-		while( m_lastAccessed < m_numElements )
+		// and requires array access -> no hash map). Interned names can be
+		// compared by their address.
+		NameId name = m_file->InternName( _name );
+		uint64_t i = 0;
+		while( i < m_numElements )
 		{
-			if( _name == ((Node**)m_bufferArray)[m_lastAccessed]->m_name )
-				return *((Node**)m_bufferArray)[m_lastAccessed];
-			++m_lastAccessed;
+			if( name == ((Node**)m_bufferArray)[i]->m_name )
+				return *Child(i);
+			++i;
 		}
 
 		// Not found -> create a new one (stable reaction and for write access)
+		CheckWritable();
 		Resize(m_numElements + 1);
-		((Node**)m_bufferArray)[m_lastAccessed]->SetName( _name );
-		return *((Node**)m_bufferArray)[m_lastAccessed];
+		((Node**)m_bufferArray)[i]->m_name = name;
+		return *((Node**)m_bufferArray)[i];
 	}
 
 	// ********************************************************************* //
@@ -708,39 +1989,48 @@ namespace Files {
 	{
 		// No additional changes required.
 		// This would be the case if the parent uses some faster search structure!
-		m_name = _name;
+		CheckWritable();
+		m_name = m_file ? m_file->InternName( _name ) : &EmptyName;
+		MarkDirty( DIRTY_NAME );
 	}
 
 	// ********************************************************************* //
 	void MetaFileWrapper::Node::Resize( uint64_t _size, ElementType _type )
 	{
+		CheckWritable();
 		// Check if type is correct and set the type
 		if( m_type == ElementType::UNKNOWN && _type == ElementType::UNKNOWN ) throw std::string("[Node::Reset] Current node has undefined type. Type must be defined by the Reset parameter.");
+		// A NODE only records how many children it has. New children are
+		// recorded as a whole.
+		MarkDirty( m_type == ElementType::NODE ? DIRTY_CHILD_COUNT : DIRTY_SUBTREE );
 		if( m_type == ElementType::UNKNOWN )
 			m_type = _type;
 		if( m_type != _type && _type != ElementType::UNKNOWN ) throw std::string("[Node::Reset] Reset cannot change the type of a node.");
+		// Children must exist to be moved or deleted
+		ResolveChildren();
+		MakeWritable();
 
 		m_lastAccessed = m_lastAccessed >= _size ? 0 : m_lastAccessed;
 
-		uint64_t oldSize = ARRAY_SIZE(m_numElements, m_type);
-		uint64_t newSize = ARRAY_SIZE(_size, m_type);
+		// Correctly delete pruned elements before the buffer shrinks
+		if( m_type == ElementType::NODE )
+			for( uint64_t i=_size; i<m_numElements; ++i )
+				m_file->DeleteNode( ((Node**)m_bufferArray)[i] );
+
+		uint64_t oldSize = ArraySize( m_numElements, m_type );
+		uint64_t newSize = ArraySize( _size, m_type );
 		// If both old and new are buffered nothing happens otherwise
 		// a realloc or copy is necessary
 		if( oldSize > sizeof(m_buffer) || newSize > sizeof(m_buffer) )
 		{
 			void* oldData = m_bufferArray;
-			uint64_t minNum = min(m_numElements, _size);
 
 			// Determine target memory
 			if( newSize <= sizeof(m_buffer) ) m_bufferArray = m_buffer;
 			else m_bufferArray = malloc( size_t(newSize) );
 
 			// Now (flat) copy the old data
-			if( m_type == ElementType::STRING )
-				for( uint64_t i=0; i<minNum; ++i )
-					new ((string*)m_bufferArray + i) string(std::move(((string*)oldData)[i]));
-			else
-				memcpy(m_bufferArray, oldData, (size_t)min(oldSize, newSize) );
+			memcpy(m_bufferArray, oldData, (size_t)min(oldSize, newSize) );
 
 			if( oldSize > sizeof(m_buffer) ) free(oldData);
 		}
@@ -751,20 +2041,30 @@ namespace Files {
 			if( m_type == ElementType::NODE )
 				for( uint64_t i=m_numElements; i<_size; ++i )
 				{
-					Node* newNode = (Node*)m_file->m_nodePool.Alloc();
+					Node* newNode = (Node*)m_file->AllocNode();
 					((Node**)m_bufferArray)[i] = new (newNode) Node( m_file, "" );
+					newNode->m_dirty = DIRTY_SUBTREE;
+					newNode->m_parent = this;
 				}
 			else if( m_type == ElementType::STRING )
+			{
+				// Empty strings end where the last string ended
+				uint64_t end = StringBegin( m_bufferArray, m_numElements );
 				for( uint64_t i=m_numElements; i<_size; ++i )
-					new ((string*)m_bufferArray + i) string();
-		} else {
-			// Correctly delete pruned elements
-			if( m_type == ElementType::NODE )
-				for( uint64_t i=_size; i<m_numElements; ++i )
-					m_file->m_nodePool.Delete( ((Node**)m_bufferArray)[i] );
-			else if( m_type == ElementType::STRING )
-				for( uint64_t i=_size; i<m_numElements; ++i )
-					((string*)m_bufferArray)[i].~string();
+					((uint64_t*)m_bufferArray)[i] = end;
+			}
+		}
+		// The characters of pruned strings remain as unused capacity.
+
+		// New bits and the unused bits of the last byte are 0. Otherwise
+		// SRAW output would depend on the content of the allocation.
+		if( m_type == ElementType::BIT )
+		{
+			uint8_t* bits = (uint8_t*)m_bufferArray;
+			uint64_t keep = min( m_numElements, _size );
+			if( keep % 8 ) bits[keep / 8] &= uint8_t((1 << (keep % 8)) - 1);
+			uint64_t firstClear = (keep + 7) / 8;
+			memset( bits + firstClear, 0, size_t(ArraySize( _size, m_type ) - firstClear) );
 		}
 
 		m_numElements = _size;
@@ -774,16 +2074,49 @@ namespace Files {
 	// Read in a single value/child node by index.
 	const MetaFileWrapper::Node& MetaFileWrapper::Node::operator[]( uint64_t _index ) const
 	{
-		if( _index >= m_numElements ) throw "Out of bounds in node '" + m_name + "'";
+		if( _index >= m_numElements ) throw "Out of bounds in node '" + *m_name + "'";
 
 		// In case of nodes there is no casting afterwards which dereferences
 		// the item. The child node must be returned immediately.
-		if( m_type == ElementType::NODE ) return *((Node**)m_bufferArray)[_index];
+		if( m_type == ElementType::NODE ) return *Child(_index);
+
+		// Changing m_lastAccessed would be a data race between readers.
+		// Instead each thread gets a flat view of the element from a small
+		// ring. A view stays valid for the next NUM_VIEWS-1 accesses of the
+		// same thread.
+		const int NUM_VIEWS = 16;
+		typedef std::aligned_storage<sizeof(Node), std::alignment_of<Node>::value>::type ViewStorage;
+		static JO_THREAD_LOCAL ViewStorage s_views[NUM_VIEWS];
+		static JO_THREAD_LOCAL int s_nextView = 0;
+		static JO_THREAD_LOCAL Node* s_lastView = nullptr;
+
+		// Loops over one array reuse the latest view like the non-constant
+		// variant reuses the node. Views of arrays in m_buffer have their
+		// own copy and never take this path. The buffer identifies the
+		// array, the other fields could have changed since.
+		Node* last = s_lastView;
+		if( last && last->m_bufferArray == m_bufferArray )
+		{
+			last->m_lastAccessed = _index;
+			last->m_numElements = m_numElements;
+			last->m_type = m_type;
+			last->m_name = m_name;
+			last->m_strings = m_strings;
+			last->m_readOnly = m_readOnly;
+			return *last;
+		}
 
-		m_lastAccessed = _index;
+		void* view = &s_views[s_nextView];
+		s_nextView = (s_nextView + 1) % NUM_VIEWS;
+		// Views own nothing -> the previous one can be overwritten
+		s_lastView = new (view) Node( *this, _index );
+		return *s_lastView;
+	}
 
-		// There is no new node (no memory allocations except for strings).
-		return *this;
+	MetaFileWrapper::Node::ElementRef MetaFileWrapper::Node::At( uint64_t _index ) const
+	{
+		if( _index >= m_numElements ) throw "Out of bounds in node '" + *m_name + "'";
+		return ElementRef( this, _index );
 	}
 
 	MetaFileWrapper::Node& MetaFileWrapper::Node::operator[]( uint64_t _index )
@@ -801,7 +2134,7 @@ namespace Files {
 
 		// In case of nodes there is no casting afterwards which dereferences
 		// the item. The child node must be returned immediately.
-		if( m_type == ElementType::NODE ) return *((Node**)m_bufferArray)[_index];
+		if( m_type == ElementType::NODE ) return *Child(_index);
 
 		m_lastAccessed = _index;
 		return *this;
@@ -810,44 +2143,174 @@ namespace Files {
 	// Casts the node data into string.
 	MetaFileWrapper::Node::operator std::string() const
 	{
-		// Because of array access the m_buffer is the start address of
-		// the string in m_bufferArray.
-		return reinterpret_cast<std::string*>(m_bufferArray)[m_lastAccessed];
+		uint64_t begin = StringBegin( m_bufferArray, m_lastAccessed );
+		return std::string( m_strings + begin, size_t(((uint64_t*)m_bufferArray)[m_lastAccessed] - begin) );
+	}
+
+	MetaFileWrapper::StringView MetaFileWrapper::Node::GetStringView( uint64_t _index ) const
+	{
+		if( m_type != ElementType::STRING ) throw "Node '" + *m_name + "' is no string node.";
+		if( _index >= m_numElements ) throw "Out of bounds in node '" + *m_name + "'";
+		uint64_t begin = StringBegin( m_bufferArray, _index );
+		StringView view = { m_strings + begin, ((uint64_t*)m_bufferArray)[_index] - begin };
+		return view;
+	}
+
+	void MetaFileWrapper::Node::SetString( uint64_t _index, const char* _data, uint64_t _length )
+	{
+		CheckWritable();
+		if( IsShared() ) Unshare( true );
+		MarkDirty( DIRTY_SUBTREE );
+		uint64_t* ends = (uint64_t*)m_bufferArray;
+		uint64_t begin = StringBegin( ends, _index );
+		uint64_t oldEnd = ends[_index];
+		uint64_t total = ends[m_numElements-1];
+		uint64_t newTotal = total - (oldEnd - begin) + _length;
+		if( newTotal > m_stringCapacity )
+		{
+			m_stringCapacity = max( newTotal, m_stringCapacity * 2 );
+			m_strings = (char*)realloc( m_strings, size_t(m_stringCapacity) );
+		}
+		// Shift all following strings
+		uint64_t newEnd = begin + _length;
+		if( newEnd != oldEnd )
+		{
+			memmove( m_strings + newEnd, m_strings + oldEnd, size_t(total - oldEnd) );
+			for( uint64_t i=_index; i<m_numElements; ++i )
+				ends[i] = ends[i] - oldEnd + newEnd;
+		}
+		// m_strings is still nullptr after assigning empty strings only
+		if( _length ) memcpy( m_strings + begin, _data, size_t(_length) );
 	}
 
 	void* MetaFileWrapper::Node::GetData()
 	{
-		if( m_type == ElementType::NODE ) throw "Cannot access data from intermediate node '" + m_name + "'";
-		if( m_type == ElementType::STRING ) throw "Cannot access data from string node '" + m_name + "'";
+		if( m_type == ElementType::NODE ) throw "Cannot access data from intermediate node '" + *m_name + "'";
+		if( m_type == ElementType::STRING ) throw "Cannot access data from string node '" + *m_name + "'";
 
+		MakeElementsWritable();
+		MarkDirty( DIRTY_SUBTREE );
 		return m_bufferArray;
 	}
 
+	const void* MetaFileWrapper::Node::GetData() const
+	{
+		if( m_type == ElementType::NODE ) throw "Cannot access data from intermediate node '" + *m_name + "'";
+		if( m_type == ElementType::STRING ) throw "Cannot access data from string node '" + *m_name + "'";
+
+		return m_bufferArray;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::MakeWritable()
+	{
+		CheckWritable();
+		if( IsShared() ) Unshare( true );
+		if( !m_inPlace ) return;
+
+		uint64_t size = ArraySize( m_numElements, m_type );
+		void* data = size > sizeof(m_buffer) ? malloc( size_t(size) ) : m_buffer;
+		memcpy( data, m_bufferArray, size_t(size) );
+		m_bufferArray = data;
+		m_inPlace = false;
+	}
+
+	void MetaFileWrapper::Node::CheckSpanType( ElementType _type ) const
+	{
+		if( m_type != _type ) throw "Node '" + *m_name + "' does not contain the requested element type.";
+	}
+
+	void MetaFileWrapper::Node::CopyTo( void* _dst, ElementType _dstType, uint64_t _first, uint64_t _count ) const
+	{
+		if( _first + _count > m_numElements || _first + _count < _first ) throw "Out of bounds in node '" + *m_name + "'";
+		if( !IsInt() && !IsUnsignedInt() && !IsFloat() ) throw "Node '" + *m_name + "' does not contain numeric data.";
+
+		const uint8_t* first = (const uint8_t*)m_bufferArray + _first * (ELEMENT_TYPE_SIZE[(int)m_type] / 8);
+		ConvertElements( first, m_type, _dst, _dstType, _count );
+	}
+
 	// ********************************************************************* //
 #define ASSIGNEMENT_OP(T, ET, TYPE_FAIL)									\
 	T MetaFileWrapper::Node::operator = (T _val)							\
 	{																		\
 		if( m_type == ElementType::UNKNOWN ) {m_type = ET; m_numElements = 1;}				\
-		if( TYPE_FAIL ) throw std::string("Cannot assign ") + #T + " to '" + m_name + "'";	\
+		if( TYPE_FAIL ) throw std::string("Cannot assign ") + #T + " to '" + *m_name + "'";	\
+		MakeElementsWritable();												\
+		MarkDirty( DIRTY_SUBTREE );											\
 		reinterpret_cast<T*>(m_bufferArray)[m_lastAccessed] = _val;			\
 		return _val;														\
 	}
 
 	ASSIGNEMENT_OP(float, ElementType::FLOAT, ElementType::FLOAT != m_type)
 	ASSIGNEMENT_OP(double, ElementType::DOUBLE, ElementType::DOUBLE != m_type)
-	ASSIGNEMENT_OP(int8_t, ElementType::INT8, ElementType::INT8 != m_type)
-	ASSIGNEMENT_OP(uint8_t, ElementType::UINT8, ElementType::UINT8 != m_type)
-	ASSIGNEMENT_OP(int16_t, ElementType::INT16, m_type != ElementType::INT16 && m_type != ElementType::INT8)
-	ASSIGNEMENT_OP(uint16_t, ElementType::UINT16, m_type != ElementType::UINT16 && m_type != ElementType::UINT8)
-	ASSIGNEMENT_OP(int32_t, ElementType::INT32, m_type > ElementType::INT32 || m_type < ElementType::INT8)
-	ASSIGNEMENT_OP(uint32_t, ElementType::UINT32, m_type > ElementType::UINT32 || m_type < ElementType::UINT8)
-	ASSIGNEMENT_OP(int64_t, ElementType::INT64, m_type > ElementType::INT64 || m_type < ElementType::INT8)
-	ASSIGNEMENT_OP(uint64_t, ElementType::UINT64, m_type > ElementType::UINT64 || m_type < ElementType::UINT8)
+
+	// ********************************************************************* //
+	// Does an integer fit into an element of the integer type _type?
+	static bool FitsInto( int64_t _val, MetaFileWrapper::ElementType _type )
+	{
+		typedef MetaFileWrapper::ElementType ET;
+		switch( _type )
+		{
+		case ET::INT8:		return _val >= std::numeric_limits<int8_t>::min() && _val <= std::numeric_limits<int8_t>::max();
+		case ET::INT16:		return _val >= std::numeric_limits<int16_t>::min() && _val <= std::numeric_limits<int16_t>::max();
+		case ET::INT32:		return _val >= std::numeric_limits<int32_t>::min() && _val <= std::numeric_limits<int32_t>::max();
+		case ET::UINT8:		return _val >= 0 && _val <= std::numeric_limits<uint8_t>::max();
+		case ET::UINT16:	return _val >= 0 && _val <= std::numeric_limits<uint16_t>::max();
+		case ET::UINT32:	return _val >= 0 && _val <= int64_t(std::numeric_limits<uint32_t>::max());
+		case ET::UINT64:	return _val >= 0;
+		default:			return true;
+		}
+	}
+
+	static bool FitsInto( uint64_t _val, MetaFileWrapper::ElementType _type )
+	{
+		typedef MetaFileWrapper::ElementType ET;
+		switch( _type )
+		{
+		case ET::INT8:		return _val <= uint64_t(std::numeric_limits<int8_t>::max());
+		case ET::INT16:		return _val <= uint64_t(std::numeric_limits<int16_t>::max());
+		case ET::INT32:		return _val <= uint64_t(std::numeric_limits<int32_t>::max());
+		case ET::INT64:		return _val <= uint64_t(std::numeric_limits<int64_t>::max());
+		case ET::UINT8:		return _val <= std::numeric_limits<uint8_t>::max();
+		case ET::UINT16:	return _val <= std::numeric_limits<uint16_t>::max();
+		case ET::UINT32:	return _val <= std::numeric_limits<uint32_t>::max();
+		default:			return true;
+		}
+	}
+
+	// Integer elements can have an other integer type than the value, e.g.
+	// after NARROW_INTEGERS. The value is converted to the type of the
+	// element and must fit into it. Only the element itself is written.
+#define INTEGER_ASSIGNEMENT_OP(T, ET, WIDE, WIDE_ET)							\
+	T MetaFileWrapper::Node::operator = (T _val)							\
+	{																		\
+		if( m_type == ElementType::UNKNOWN ) {m_type = ET; m_numElements = 1;}				\
+		if( !IsInt() && !IsUnsignedInt() ) throw std::string("Cannot assign ") + #T + " to '" + *m_name + "'";	\
+		WIDE wide = _val;													\
+		if( m_type != ET && !FitsInto( wide, m_type ) )						\
+			throw std::string("Cannot assign ") + #T + " to '" + *m_name + "': the value does not fit into the element type.";	\
+		MakeElementsWritable();												\
+		MarkDirty( DIRTY_SUBTREE );											\
+		if( m_type == ET ) reinterpret_cast<T*>(m_bufferArray)[m_lastAccessed] = _val;	\
+		else ConvertElements( &wide, WIDE_ET, (uint8_t*)m_bufferArray + m_lastAccessed * (ELEMENT_TYPE_SIZE[(int)m_type] / 8), m_type, 1 );	\
+		return _val;														\
+	}
+
+	INTEGER_ASSIGNEMENT_OP(int8_t, ElementType::INT8, int64_t, ElementType::INT64)
+	INTEGER_ASSIGNEMENT_OP(uint8_t, ElementType::UINT8, uint64_t, ElementType::UINT64)
+	INTEGER_ASSIGNEMENT_OP(int16_t, ElementType::INT16, int64_t, ElementType::INT64)
+	INTEGER_ASSIGNEMENT_OP(uint16_t, ElementType::UINT16, uint64_t, ElementType::UINT64)
+	INTEGER_ASSIGNEMENT_OP(int32_t, ElementType::INT32, int64_t, ElementType::INT64)
+	INTEGER_ASSIGNEMENT_OP(uint32_t, ElementType::UINT32, uint64_t, ElementType::UINT64)
+	INTEGER_ASSIGNEMENT_OP(int64_t, ElementType::INT64, int64_t, ElementType::INT64)
+	INTEGER_ASSIGNEMENT_OP(uint64_t, ElementType::UINT64, uint64_t, ElementType::UINT64)
 
 	bool MetaFileWrapper::Node::operator = (bool _val)
 	{
-		if( m_type == ElementType::UNKNOWN ) {m_type = ElementType::BIT; m_numElements=1;}
-		if( ElementType::BIT != m_type ) throw std::string("Cannot assign bool to '" + m_name + "'");
+		if( m_type == ElementType::UNKNOWN ) {m_type = ElementType::BIT; m_numElements=1; m_buffer[0]=0;}
+		if( ElementType::BIT != m_type ) throw std::string("Cannot assign bool to '" + *m_name + "'");
+		MakeElementsWritable();
+		MarkDirty( DIRTY_SUBTREE );
 
 		uint8_t& i = reinterpret_cast<uint8_t*>(m_bufferArray)[m_lastAccessed/8];
 		uint8_t m = 1 << (m_lastAccessed & 0x7);
@@ -858,27 +2321,29 @@ namespace Files {
 
 	const std::string& MetaFileWrapper::Node::operator = (const std::string& _val)
 	{
+		CheckWritable();
 		if( m_type == ElementType::UNKNOWN || m_numElements==0 ) {
 			m_type = ElementType::STRING;
 			m_numElements = 1;
-			new ((std::string*)m_bufferArray) string();
+			((uint64_t*)m_bufferArray)[0] = 0;
 		}
-		if( m_type != ElementType::STRING ) throw "Cannot assign std::string to '" + m_name + "'";
+		if( m_type != ElementType::STRING ) throw "Cannot assign std::string to '" + *m_name + "'";
 
-		((std::string*)m_bufferArray)[m_lastAccessed] = _val;
+		SetString( m_lastAccessed, _val.data(), _val.length() );
 		return _val;
 	}
 
 	const char* MetaFileWrapper::Node::operator = (const char* _val)
 	{
+		CheckWritable();
 		if( m_type == ElementType::UNKNOWN || m_numElements==0 ) {
 			m_type = ElementType::STRING;
 			m_numElements = 1;
-			new ((std::string*)m_bufferArray) string();
+			((uint64_t*)m_bufferArray)[0] = 0;
 		}
-		if( m_type != ElementType::STRING ) throw "Cannot assign 'const char*' to '" + m_name + "'";
+		if( m_type != ElementType::STRING ) throw "Cannot assign 'const char*' to '" + *m_name + "'";
 
-		((std::string*)m_bufferArray)[m_lastAccessed] = _val;
+		SetString( m_lastAccessed, _val, strlen(_val) );
 		return _val;
 	}
 
@@ -888,7 +2353,7 @@ namespace Files {
 	{
 		assert( _type != ElementType::UNKNOWN || _numElements == 0 );
 		if( m_type != ElementType::NODE && m_type != ElementType::UNKNOWN )
-			throw "It is not possible to add a child node to '" + m_name + "'. It has the wrong type.";
+			throw "It is not possible to add a child node to '" + *m_name + "'. It has the wrong type.";
 		// In case it was unknown set the type.
 		m_type = ElementType::NODE;
 
@@ -902,6 +2367,7 @@ namespace Files {
 			newNode->m_numElements = 0;
 			newNode->m_type = _type;
 		}
+		newNode->m_dirty = DIRTY_SUBTREE;
 
 		return *newNode;
 	}
@@ -911,21 +2377,26 @@ namespace Files {
 	bool MetaFileWrapper::Node::HasChild( const std::string& _name, const Node** _child ) const
 	{
 		if( m_type == ElementType::UNKNOWN ) { if(_child) *_child = nullptr; return false;}
-		if( m_type != ElementType::NODE ) throw "Node '" + m_name + "' is of an elementary type and has no named children.";
+		if( m_type != ElementType::NODE ) throw "Node '" + *m_name + "' is of an elementary type and has no named children.";
 
-		// Linear search for the correct child (assumes only a few children
-		// and requires array access -> no hash map)
-		uint64_t m_lastAccessed = 0;
-		while( m_lastAccessed < m_numElements )
-		{
-			if( _name == ((Node**)m_bufferArray)[m_lastAccessed]->m_name )
-				{ if(_child) *_child = &(*((Node**)m_bufferArray)[m_lastAccessed]); return true;}
-			++m_lastAccessed;
+		// A name which is not in the table cannot be the name of a child.
+		const Node* found = nullptr;
+		if( m_lazy.load(std::memory_order_acquire) == CHILDREN_PENDING )
+			found = FindInDirectory( _name );
+		else {
+			NameId name = m_file->FindName( _name );
+			// Linear search for the correct child (assumes only a few children
+			// and requires array access -> no hash map)
+			for( uint64_t i=0; name && i<m_numElements; ++i )
+			{
+				if( name == ((Node**)m_bufferArray)[i]->m_name )
+					{ found = ((Node**)m_bufferArray)[i]; break; }
+			}
 		}
-		// Not found
-		// Avoid that m_lastAccessed is invalid
-		m_lastAccessed = m_numElements-1;
-		return false;
+
+		if( found ) found->Resolve();
+		if(_child) *_child = found;
+		return found != nullptr;
 	}
 
 	// ********************************************************************* //
@@ -937,29 +2408,27 @@ namespace Files {
 
 	// ********************************************************************* //
 	// Recursive calculation of the size occupied in a sraw file.
-	uint64_t MetaFileWrapper::Node::GetDataSize( int* _stringSize ) const
+	uint64_t MetaFileWrapper::Node::GetDataSize( int* _stringSize, WriteFlags _flags, uint64_t _position ) const
 	{
+		if( m_type == ElementType::UNKNOWN ) return 0;
 		if( m_type == ElementType::NODE )
 		{
-			uint64_t dataSize = 0;
+			uint64_t position = _position;
+			if( _flags & CHILD_DIRECTORY )
+				position += m_numElements * DIRECTORY_ENTRY_SIZE;
 			for( uint64_t i=0; i<m_numElements; ++i ) {
-				dataSize += ((Node**)m_bufferArray)[i]->GetDataSize();
-				// Names are always stored as STRING8
-				uint64_t length = ((Node**)m_bufferArray)[i]->GetName().length();
-				dataSize += length + 1;
-				dataSize += 1;	// CodeNType
-				dataSize += uint64_t(1<<GetNumRequiredBytes(((Node**)m_bufferArray)[i]->Size()));	// NELEMS
-				if(((Node**)m_bufferArray)[i]->GetType() == ElementType::NODE || ((Node**)m_bufferArray)[i]->GetType() == ElementType::STRING)
-					dataSize += 8;	// Datasize
+				const Node* child = Child(i);
+				position += child->GetHeaderSize();
+				position += child->GetDataSize( nullptr, _flags, position );
 			}
-			return dataSize;
+			return position - _position;
 		} else if( m_type == ElementType::STRING ) {
 			// Go through all strings and determine the correct string type and
 			// total data amount
 			uint64_t lengthSum = 0, maxLength = 0;
 			for( uint64_t i=0; i<m_numElements; ++i )
 			{
-				uint64_t length = ((std::string*)m_bufferArray)[i].length();
+				uint64_t length = ((uint64_t*)m_bufferArray)[i] - StringBegin( m_bufferArray, i );
 				maxLength = std::max( maxLength, length );
 				lengthSum += length;
 			}
@@ -969,10 +2438,23 @@ namespace Files {
 			if(_stringSize) *_stringSize = numBytes;
 			return m_numElements * numBytes + lengthSum;
 		} else {
-			return ARRAY_SIZE(m_numElements, m_type);
+			uint64_t payloadSize = ArraySize( m_numElements, m_type );
+			if( _flags & (ALIGN_16 | ALIGN_64) )
+				return 1 + PaddingSize( _flags, _position, payloadSize ) + payloadSize;
+			return payloadSize;
 		}
 	}
 
-#undef ARRAY_SIZE
+	// ********************************************************************* //
+	uint64_t MetaFileWrapper::Node::GetHeaderSize() const
+	{
+		// CodeNType + name as STRING8
+		uint64_t size = 1 + 1 + m_name->length();
+		size += uint64_t(1<<GetNumRequiredBytes(m_numElements));	// NELEMS
+		if( m_type == ElementType::NODE || m_type == ElementType::STRING || m_type == ElementType::UNKNOWN )
+			size += 8;	// Datasize
+		return size;
+	}
+
 } // namespace Files
 } // namespace Jo
\ No newline at end of file
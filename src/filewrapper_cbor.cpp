@@ -0,0 +1,650 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include "platform.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	// CBOR (RFC 8949) documents have the structure of the JSON writer: NODEs
+	// with named children are maps, all others arrays. Data nodes are scalars
+	// if they have a name and one element. Numeric arrays are typed arrays
+	// (RFC 8746): a tag 64..87 which encodes the element type and byte order
+	// followed by a byte string with the elements. They are copied at once
+	// or used IN_PLACE. The writer uses the byte order of the host and longer
+	// heads than necessary to align the elements in the file. BIT and STRING
+	// arrays are plain arrays.
+
+	// The writer collects small values and writes them in blocks of this
+	// size.
+	static const size_t CBOR_BLOCK_SIZE = 65536;
+
+	// Marks the content of a file as CBOR (RFC 8949, 3.4.6). Written at the
+	// start of each document and skipped like all unknown tags.
+	static const uint64_t CBOR_SELF_DESCRIBE_TAG = 55799;
+
+	enum CborMajorType
+	{
+		CBOR_UNSIGNED = 0,
+		CBOR_NEGATIVE = 1,
+		CBOR_BYTES = 2,
+		CBOR_TEXT = 3,
+		CBOR_ARRAY = 4,
+		CBOR_MAP = 5,
+		CBOR_TAG = 6,
+		CBOR_SIMPLE = 7
+	};
+
+	// Number of bytes after the initial byte which store _value.
+	static int ArgumentWidth( uint64_t _value )
+	{
+		if( _value < 24 ) return 0;
+		if( _value <= 0xff ) return 1;
+		if( _value <= 0xffff ) return 2;
+		if( _value <= 0xffffffff ) return 4;
+		return 8;
+	}
+
+	// ********************************************************************* //
+	struct MetaFileWrapper::CborWriter
+	{
+		IFile& file;
+		uint64_t flushed;			///< Position of the buffer in the file
+		std::vector<uint8_t> buffer;
+
+		explicit CborWriter( IFile& _file ) : file( _file ), flushed( _file.GetCursor() )	{ buffer.reserve( CBOR_BLOCK_SIZE ); }
+
+		uint64_t Position() const	{ return flushed + buffer.size(); }
+
+		void Flush()
+		{
+			if( !buffer.empty() ) file.Write( buffer.data(), buffer.size() );
+			flushed += buffer.size();
+			buffer.clear();
+		}
+
+		void Put( uint8_t _byte )
+		{
+			if( buffer.size() == CBOR_BLOCK_SIZE ) Flush();
+			buffer.push_back( _byte );
+		}
+
+		void Put( const void* _data, uint64_t _size )
+		{
+			if( buffer.size() + _size > CBOR_BLOCK_SIZE )
+			{
+				Flush();
+				// Large payloads are not copied
+				if( _size > CBOR_BLOCK_SIZE ) { file.Write( _data, _size ); flushed += _size; return; }
+			}
+			buffer.insert( buffer.end(), (const uint8_t*)_data, (const uint8_t*)_data + _size );
+		}
+
+		template<typename T> void PutBig( T _value )
+		{
+			_value = AsBigEndian( _value );
+			Put( &_value, sizeof(T) );
+		}
+
+		/// \brief Initial byte and argument of a data item.
+		/// \param [in] _width Bytes of the argument, at least ArgumentWidth().
+		void Head( CborMajorType _major, uint64_t _value, int _width )
+		{
+			static const uint8_t INFO[9] = { 0, 24, 25, 0, 26, 0, 0, 0, 27 };
+			if( _width == 0 ) { Put( uint8_t((_major << 5) | _value) ); return; }
+			Put( uint8_t((_major << 5) | INFO[_width]) );
+			switch( _width )
+			{
+			case 1: Put( uint8_t(_value) ); break;
+			case 2: PutBig( uint16_t(_value) ); break;
+			case 4: PutBig( uint32_t(_value) ); break;
+			default: PutBig( _value );
+			}
+		}
+
+		void Head( CborMajorType _major, uint64_t _value )	{ Head( _major, _value, ArgumentWidth( _value ) ); }
+
+		void Signed( int64_t _value )
+		{
+			if( _value >= 0 ) Head( CBOR_UNSIGNED, uint64_t(_value) );
+			else Head( CBOR_NEGATIVE, uint64_t(-(_value + 1)) );
+		}
+
+		void Text( const char* _data, uint64_t _length )
+		{
+			Head( CBOR_TEXT, _length );
+			Put( _data, _length );
+		}
+
+		/// \brief Tag and byte string head of a typed array whose payload
+		///		starts at a multiple of _alignment in the file.
+		/// \details Heads may be longer than necessary, the remaining gaps
+		///		are filled with a self-describe tag. This finds a solution
+		///		for all alignments up to 8.
+		void TypedArrayHead( uint64_t _tag, uint64_t _size, uint64_t _alignment )
+		{
+			int minWidth = ArgumentWidth( _size );
+			for( int prefix = 0; prefix < 2; ++prefix )
+				for( int tagWidth = 1; tagWidth <= 8; tagWidth *= 2 )
+					for( int sizeWidth = minWidth; sizeWidth <= 8; sizeWidth = sizeWidth ? sizeWidth * 2 : 1 )
+					{
+						uint64_t headSize = prefix * 3 + 1 + tagWidth + 1 + sizeWidth;
+						if( (Position() + headSize) % _alignment ) continue;
+						if( prefix ) Head( CBOR_TAG, CBOR_SELF_DESCRIBE_TAG );
+						Head( CBOR_TAG, _tag, tagWidth );
+						Head( CBOR_BYTES, _size, sizeWidth );
+						return;
+					}
+		}
+	};
+
+	// ********************************************************************* //
+	// Static helper methods												 //
+	// ********************************************************************* //
+
+	// One data item without its content. Text and byte strings include
+	// their payload, arrays and maps are followed by their elements and tags
+	// by the tagged item.
+	struct CborToken
+	{
+		enum Kind { UINT, NEGATIVE, BYTES, TEXT, ARRAY, MAP, TAG, BOOL, NIL, FLOAT32, FLOAT64, BREAK };
+		Kind kind;
+		union {
+			bool b;
+			int64_t i;				///< Value of NEGATIVE
+			uint64_t u;				///< Value of UINT, number of the TAG
+			double d;
+		};
+		uint64_t length;			///< Bytes of strings or number of elements
+		bool indefinite;			///< Array or map which ends with a BREAK
+		const uint8_t* payload;
+		/// \brief Concatenated chunks of an indefinite length string. The
+		///		payload points into it.
+		std::string chunks;
+	};
+
+	static void Need( const uint8_t* _data, const uint8_t* _end, uint64_t _size )
+	{
+		if( uint64_t(_end - _data) < _size ) throw std::string("[Node::ReadCbor] Unexpected end of file.");
+	}
+
+	template<typename T> static T LoadBig( const uint8_t* _data )
+	{
+		T value;
+		memcpy( &value, _data, sizeof(T) );
+		return AsBigEndian( value );
+	}
+
+	// IEEE 754 binary16 to float.
+	static float HalfToFloat( uint16_t _half )
+	{
+		int exponent = (_half >> 10) & 0x1f;
+		int mantissa = _half & 0x3ff;
+		float value;
+		if( exponent == 0 ) value = std::ldexp( float(mantissa), -24 );
+		else if( exponent == 31 ) value = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+		else value = std::ldexp( float(mantissa + 1024), exponent - 25 );
+		return (_half & 0x8000) ? -value : value;
+	}
+
+	// ********************************************************************* //
+	// Read the head of the next data item.
+	// Returns the position after the head and string payloads.
+	static const uint8_t* ReadToken( const uint8_t* _data, const uint8_t* _end, CborToken& _token )
+	{
+		Need( _data, _end, 1 );
+		uint8_t initial = *_data++;
+		int major = initial >> 5;
+		int info = initial & 0x1f;
+		_token.length = 0;
+		_token.indefinite = false;
+
+		uint64_t argument = info;
+		if( info == 31 )
+		{
+			if( major == CBOR_SIMPLE ) { _token.kind = CborToken::BREAK; return _data; }
+			if( major < CBOR_BYTES || major == CBOR_TAG ) throw std::string("[Node::ReadCbor] Invalid indefinite length.");
+			_token.indefinite = true;
+		} else if( info >= 28 ) throw std::string("[Node::ReadCbor] Invalid additional information.");
+		else if( info >= 24 )
+		{
+			int width = 1 << (info - 24);
+			Need( _data, _end, width );
+			switch( width )
+			{
+			case 1: argument = *_data; break;
+			case 2: argument = LoadBig<uint16_t>( _data ); break;
+			case 4: argument = LoadBig<uint32_t>( _data ); break;
+			default: argument = LoadBig<uint64_t>( _data );
+			}
+			_data += width;
+		}
+
+		switch( major )
+		{
+		case CBOR_UNSIGNED: _token.kind = CborToken::UINT; _token.u = argument; break;
+		case CBOR_NEGATIVE:
+			if( argument > uint64_t(std::numeric_limits<int64_t>::max()) ) throw std::string("[Node::ReadCbor] Integer out of range.");
+			_token.kind = CborToken::NEGATIVE;
+			_token.i = -1 - int64_t(argument);
+			break;
+		case CBOR_BYTES:
+		case CBOR_TEXT:
+			_token.kind = major == CBOR_BYTES ? CborToken::BYTES : CborToken::TEXT;
+			if( _token.indefinite )
+			{
+				// Definite strings of the same major type up to the break
+				_token.chunks.clear();
+				CborToken chunk;
+				for( _data = ReadToken( _data, _end, chunk ); chunk.kind != CborToken::BREAK; _data = ReadToken( _data, _end, chunk ) )
+				{
+					if( chunk.kind != _token.kind || chunk.indefinite ) throw std::string("[Node::ReadCbor] Invalid string chunk.");
+					_token.chunks.append( (const char*)chunk.payload, size_t(chunk.length) );
+				}
+				_token.payload = (const uint8_t*)_token.chunks.data();
+				_token.length = _token.chunks.size();
+			} else {
+				Need( _data, _end, argument );
+				_token.payload = _data;
+				_token.length = argument;
+				_data += argument;
+			}
+			break;
+		case CBOR_ARRAY: _token.kind = CborToken::ARRAY; _token.length = argument; break;
+		case CBOR_MAP: _token.kind = CborToken::MAP; _token.length = argument; break;
+		case CBOR_TAG: _token.kind = CborToken::TAG; _token.u = argument; break;
+		default:
+			switch( info )
+			{
+			case 20: case 21: _token.kind = CborToken::BOOL; _token.b = info == 21; break;
+			case 25: _token.kind = CborToken::FLOAT32; _token.d = HalfToFloat( uint16_t(argument) ); break;
+			case 26: { uint32_t bits = uint32_t(argument); float f; memcpy( &f, &bits, 4 ); _token.d = f; }
+				_token.kind = CborToken::FLOAT32; break;
+			case 27: memcpy( &_token.d, &argument, 8 ); _token.kind = CborToken::FLOAT64; break;
+			// null, undefined and unassigned simple values
+			default: _token.kind = CborToken::NIL;
+			}
+		}
+		return _data;
+	}
+
+	// ********************************************************************* //
+	// Skip one data item including its content.
+	static const uint8_t* SkipItem( const uint8_t* _data, const uint8_t* _end )
+	{
+		CborToken token;
+		_data = ReadToken( _data, _end, token );
+		switch( token.kind )
+		{
+		case CborToken::TAG: return SkipItem( _data, _end );
+		case CborToken::BREAK: throw std::string("[Node::ReadCbor] Unexpected break.");
+		case CborToken::ARRAY:
+		case CborToken::MAP: {
+			uint64_t itemsPerEntry = token.kind == CborToken::MAP ? 2 : 1;
+			if( token.indefinite )
+			{
+				while( Need( _data, _end, 1 ), *_data != 0xff )
+					_data = SkipItem( _data, _end );
+				return _data + 1;
+			}
+			for( uint64_t i=0; i<token.length * itemsPerEntry; ++i )
+				_data = SkipItem( _data, _end );
+			} break;
+		default: break;
+		}
+		return _data;
+	}
+
+	// Number of entries of an indefinite array or map up to the break.
+	static uint64_t CountEntries( const uint8_t* _data, const uint8_t* _end, int _itemsPerEntry )
+	{
+		uint64_t numItems = 0;
+		while( Need( _data, _end, 1 ), *_data != 0xff )
+		{
+			_data = SkipItem( _data, _end );
+			++numItems;
+		}
+		if( numItems % _itemsPerEntry ) throw std::string("[Node::ReadCbor] Map without value.");
+		return numItems / _itemsPerEntry;
+	}
+
+	// Expect the break after the entries of an indefinite array or map.
+	static const uint8_t* ReadBreak( const uint8_t* _data, const uint8_t* _end )
+	{
+		CborToken token;
+		_data = ReadToken( _data, _end, token );
+		if( token.kind != CborToken::BREAK ) throw std::string("[Node::ReadCbor] Missing break.");
+		return _data;
+	}
+
+	// ********************************************************************* //
+	// Integers get the type of the JSON reader (INT32) unless they need
+	// more bits.
+	static MetaFileWrapper::ElementType IntegerType( int64_t _min, uint64_t _max )
+	{
+		if( _min >= std::numeric_limits<int32_t>::min() && _max <= uint64_t(std::numeric_limits<int32_t>::max()) )
+			return MetaFileWrapper::ElementType::INT32;
+		if( _max <= uint64_t(std::numeric_limits<int64_t>::max()) ) return MetaFileWrapper::ElementType::INT64;
+		if( _min >= 0 ) return MetaFileWrapper::ElementType::UINT64;
+		throw std::string("[Node::ReadCbor] The integers of an array do not fit into one type.");
+	}
+
+	// Typed array tag of a numeric type in the byte order of the host:
+	// 0b010fsell with f = float, s = signed, e = little-endian and ll the
+	// size.
+	static uint64_t TypedArrayTag( MetaFileWrapper::ElementType _type )
+	{
+		typedef MetaFileWrapper::ElementType ElementType;
+		uint64_t size = MetaFileWrapper::ELEMENT_TYPE_SIZE[(int)_type] / 8;
+		bool isFloat = _type == ElementType::FLOAT || _type == ElementType::DOUBLE;
+		bool isSigned = _type >= ElementType::INT8 && _type <= ElementType::INT64;
+		uint64_t ll = isFloat ? (size == 4 ? 1 : 2) : (size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3);
+		// 8 bit tags have no byte order, 68 is the clamped uint8 array
+		bool little = IsLittleEndian() && size > 1;
+		return 64 | (isFloat ? 0x10 : 0) | (isSigned ? 0x08 : 0) | (little ? 0x04 : 0) | ll;
+	}
+
+	// ********************************************************************* //
+	// Read and write														 //
+	// ********************************************************************* //
+
+	void MetaFileWrapper::Node::SaveAsCbor( IFile& _file ) const
+	{
+		// An empty wrapper produces an empty file
+		if( m_type == ElementType::UNKNOWN && this == &m_file->RootNode ) return;
+
+		CborWriter writer( _file );
+		writer.Head( CBOR_TAG, CBOR_SELF_DESCRIBE_TAG );
+		WriteCbor( writer );
+		writer.Flush();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::WriteCbor( CborWriter& _out ) const
+	{
+		// null
+		if( m_type == ElementType::UNKNOWN ) { _out.Put( uint8_t(0xf6) ); return; }
+
+		if( m_type == ElementType::NODE )
+		{
+			// Node arrays have unnamed children
+			bool nodeArray = m_numElements == 0 || Child(0)->m_name->empty();
+			_out.Head( nodeArray ? CBOR_ARRAY : CBOR_MAP, m_numElements );
+			for( uint64_t i=0; i<m_numElements; ++i )
+			{
+				const Node* child = Child(i);
+				if( !nodeArray ) _out.Text( child->m_name->data(), child->m_name->length() );
+				child->WriteCbor( _out );
+			}
+			return;
+		}
+
+		bool isArray = m_name->empty() || m_numElements != 1;
+		if( isArray && m_type > ElementType::BIT )
+		{
+			uint64_t size = ArraySize( m_numElements, m_type );
+			_out.TypedArrayHead( TypedArrayTag( m_type ), size, ELEMENT_TYPE_SIZE[(int)m_type] / 8 );
+			_out.Put( m_bufferArray, size );
+			return;
+		}
+
+		if( isArray ) _out.Head( CBOR_ARRAY, m_numElements );
+		for( uint64_t i=0; i<m_numElements; ++i )
+		{
+			switch( m_type )
+			{
+			case ElementType::BIT:		_out.Put( uint8_t(BitElement(i) ? 0xf5 : 0xf4) ); break;
+			case ElementType::FLOAT:	{ float f = Element<float>(i); uint32_t bits; memcpy( &bits, &f, 4 ); _out.Put( uint8_t(0xfa) ); _out.PutBig( bits ); } break;
+			case ElementType::DOUBLE:	{ double d = Element<double>(i); uint64_t bits; memcpy( &bits, &d, 8 ); _out.Put( uint8_t(0xfb) ); _out.PutBig( bits ); } break;
+			case ElementType::INT8:		_out.Signed( Element<int8_t>(i) ); break;
+			case ElementType::INT16:	_out.Signed( Element<int16_t>(i) ); break;
+			case ElementType::INT32:	_out.Signed( Element<int32_t>(i) ); break;
+			case ElementType::INT64:	_out.Signed( Element<int64_t>(i) ); break;
+			case ElementType::UINT8:	_out.Head( CBOR_UNSIGNED, Element<uint8_t>(i) ); break;
+			case ElementType::UINT16:	_out.Head( CBOR_UNSIGNED, Element<uint16_t>(i) ); break;
+			case ElementType::UINT32:	_out.Head( CBOR_UNSIGNED, Element<uint32_t>(i) ); break;
+			case ElementType::UINT64:	_out.Head( CBOR_UNSIGNED, Element<uint64_t>(i) ); break;
+			case ElementType::STRING: {
+				StringView view = GetStringView( i );
+				_out.Text( view.data, view.length );
+				} break;
+			default: break;
+			}
+		}
+	}
+
+	// ********************************************************************* //
+	const uint8_t* MetaFileWrapper::Node::ParseCbor( const uint8_t* _data, const uint8_t* _end )
+	{
+		CborToken token;
+		const uint8_t* data = ReadToken( _data, _end, token );
+		// Typed arrays become numeric arrays, all other tags are ignored
+		while( token.kind == CborToken::TAG )
+		{
+			uint64_t tag = token.u;
+			data = ReadToken( data, _end, token );
+			if( tag >= 64 && tag <= 87 )
+			{
+				if( token.kind != CborToken::BYTES ) throw std::string("[Node::ReadCbor] Typed arrays must be byte strings.");
+				ReadCborTypedArray( tag, token.payload, token.length, token.chunks.empty() );
+				return data;
+			}
+		}
+
+		switch( token.kind )
+		{
+		case CborToken::NIL:
+			// The node remains untyped
+			break;
+		case CborToken::BOOL:
+			*this = token.b;
+			break;
+		case CborToken::NEGATIVE:
+			if( token.i >= std::numeric_limits<int32_t>::min() ) *this = int32_t(token.i);
+			else *this = token.i;
+			break;
+		case CborToken::UINT:
+			switch( IntegerType( 0, token.u ) )
+			{
+			case ElementType::INT32: *this = int32_t(token.u); break;
+			case ElementType::INT64: *this = int64_t(token.u); break;
+			default: *this = token.u;
+			}
+			break;
+		case CborToken::FLOAT32:
+			*this = float(token.d);
+			break;
+		case CborToken::FLOAT64:
+			*this = token.d;
+			break;
+		case CborToken::TEXT:
+			*this = std::string( (const char*)token.payload, size_t(token.length) );
+			break;
+		case CborToken::BYTES:
+			Resize( token.length, ElementType::UINT8 );
+			memcpy( m_bufferArray, token.payload, size_t(token.length) );
+			break;
+		case CborToken::MAP: {
+			// All children are created at once
+			uint64_t numElements = token.indefinite ? CountEntries( data, _end, 2 ) : token.length;
+			Resize( numElements, ElementType::NODE );
+			for( uint64_t i=0; i<numElements; ++i )
+			{
+				CborToken key;
+				data = ReadToken( data, _end, key );
+				if( key.kind != CborToken::TEXT ) throw std::string("[Node::ReadCbor] Map keys must be text strings.");
+				Node* child = ((Node**)m_bufferArray)[i];
+				child->SetName( std::string( (const char*)key.payload, size_t(key.length) ) );
+				data = child->ParseCbor( data, _end );
+			}
+			if( token.indefinite ) data = ReadBreak( data, _end );
+			} break;
+		case CborToken::ARRAY: {
+			uint64_t numElements = token.indefinite ? CountEntries( data, _end, 1 ) : token.length;
+			data = ParseCborArray( data, _end, numElements );
+			if( token.indefinite ) data = ReadBreak( data, _end );
+			} break;
+		default:
+			throw std::string("[Node::ReadCbor] Unexpected break.");
+		}
+		return data;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ReadCborTypedArray( uint64_t _tag, const uint8_t* _payload, uint64_t _size, bool _inSource )
+	{
+		// 0b010fsell with f = float, s = signed, e = little-endian and ll
+		// the size
+		int bits = int(_tag - 64);
+		bool isFloat = (bits & 0x10) != 0;
+		bool isSigned = (bits & 0x08) != 0;
+		bool little = (bits & 0x04) != 0;
+		int ll = bits & 0x03;
+		ElementType type;
+		int elementSize;
+		if( isFloat )
+		{
+			static const ElementType FLOAT_TYPES[3] = { ElementType::FLOAT, ElementType::FLOAT, ElementType::DOUBLE };
+			if( ll == 3 ) throw std::string("[Node::ReadCbor] 128 bit floats are not supported.");
+			type = FLOAT_TYPES[ll];
+			elementSize = 2 << ll;
+		} else {
+			static const ElementType UNSIGNED_TYPES[4] = { ElementType::UINT8, ElementType::UINT16, ElementType::UINT32, ElementType::UINT64 };
+			static const ElementType SIGNED_TYPES[4] = { ElementType::INT8, ElementType::INT16, ElementType::INT32, ElementType::INT64 };
+			if( _tag == 76 ) throw std::string("[Node::ReadCbor] Reserved typed array tag.");
+			type = isSigned ? SIGNED_TYPES[ll] : UNSIGNED_TYPES[ll];
+			elementSize = 1 << ll;
+		}
+		if( _size % elementSize ) throw std::string("[Node::ReadCbor] Invalid typed array length.");
+		uint64_t numElements = _size / elementSize;
+		bool swap = elementSize > 1 && little != IsLittleEndian();
+
+		// half precision is widened
+		if( elementSize == 2 && isFloat )
+		{
+			Resize( numElements, type );
+			for( uint64_t i=0; i<numElements; ++i )
+			{
+				uint16_t half = uint16_t(little ? (_payload[i*2] | (_payload[i*2+1] << 8)) : ((_payload[i*2] << 8) | _payload[i*2+1]));
+				((float*)m_bufferArray)[i] = HalfToFloat( half );
+			}
+			return;
+		}
+
+		// Use the array from the source like SRAW arrays. Small arrays are
+		// cheaper to copy unless they are patched in the source.
+		if( _inSource && m_file->m_sourceMemory && !swap
+			&& (_size > sizeof(m_buffer) || m_file->m_writeThrough)
+			&& ((uintptr_t)_payload % elementSize) == 0 )
+		{
+			m_type = type;
+			m_bufferArray = const_cast<uint8_t*>(_payload);
+			m_inPlace = true;
+			m_numElements = numElements;
+			return;
+		}
+
+		Resize( numElements, type );
+		if( swap ) SwapBytes( _payload, m_bufferArray, numElements, elementSize );
+		else memcpy( m_bufferArray, _payload, size_t(_size) );
+	}
+
+	// ********************************************************************* //
+	const uint8_t* MetaFileWrapper::Node::ParseCborArray( const uint8_t* _data, const uint8_t* _end, uint64_t _numElements )
+	{
+		// Empty arrays remain untyped like in JSON
+		if( _numElements == 0 ) return _data;
+
+		// Arrays of arrays, maps, byte strings or tagged items are NODEs
+		// with unnamed children
+		CborToken token;
+		ReadToken( _data, _end, token );
+		if( token.kind == CborToken::ARRAY || token.kind == CborToken::MAP
+			|| token.kind == CborToken::BYTES || token.kind == CborToken::TAG )
+		{
+			Resize( _numElements, ElementType::NODE );
+			for( uint64_t i=0; i<_numElements; ++i )
+				_data = ((Node**)m_bufferArray)[i]->ParseCbor( _data, _end );
+			return _data;
+		}
+
+		// First pass: find the type which holds all values
+		bool anyBool = false, anyString = false, anyInteger = false, anyFloat32 = false, anyFloat64 = false;
+		int64_t minValue = 0;
+		uint64_t maxValue = 0;
+		uint64_t numChars = 0;
+		const uint8_t* data = _data;
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			data = ReadToken( data, _end, token );
+			switch( token.kind )
+			{
+			case CborToken::NIL: break;
+			case CborToken::BOOL: anyBool = true; break;
+			case CborToken::NEGATIVE: anyInteger = true; minValue = std::min( minValue, token.i ); break;
+			case CborToken::UINT: anyInteger = true; maxValue = std::max( maxValue, token.u ); break;
+			case CborToken::FLOAT32: anyFloat32 = true; break;
+			case CborToken::FLOAT64: anyFloat64 = true; break;
+			case CborToken::TEXT: anyString = true; numChars += token.length; break;
+			default: throw std::string("[Node::ReadCbor] Arrays must have the same type everywhere!");
+			}
+		}
+		bool anyNumber = anyInteger || anyFloat32 || anyFloat64;
+		if( int(anyBool) + int(anyString) + int(anyNumber) > 1 )
+			throw std::string("[Node::ReadCbor] Arrays must have the same type everywhere!");
+		ElementType type;
+		if( anyString ) type = ElementType::STRING;
+		else if( anyBool ) type = ElementType::BIT;
+		else if( anyFloat64 || (anyFloat32 && anyInteger) ) type = ElementType::DOUBLE;
+		else if( anyFloat32 ) type = ElementType::FLOAT;
+		else if( anyInteger ) type = IntegerType( minValue, maxValue );
+		// Only null
+		else return data;
+
+		// Second pass: store the values. Missing ones (null) are 0.
+		Resize( _numElements, type );
+		if( type == ElementType::BIT ) memset( m_bufferArray, 0, size_t(ArraySize( _numElements, type )) );
+		if( type == ElementType::STRING )
+		{
+			m_strings = (char*)malloc( size_t(numChars ? numChars : 1) );
+			m_stringCapacity = numChars;
+		}
+		uint64_t stringEnd = 0;
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			_data = ReadToken( _data, _end, token );
+			double value = token.kind == CborToken::FLOAT32 || token.kind == CborToken::FLOAT64 ? token.d
+				: token.kind == CborToken::NEGATIVE ? double(token.i)
+				: token.kind == CborToken::UINT ? double(token.u) : 0.0;
+			switch( type )
+			{
+			case ElementType::STRING:
+				if( token.kind == CborToken::TEXT )
+				{
+					memcpy( m_strings + stringEnd, token.payload, size_t(token.length) );
+					stringEnd += token.length;
+				}
+				((uint64_t*)m_bufferArray)[i] = stringEnd;
+				break;
+			case ElementType::BIT:
+				if( token.kind == CborToken::BOOL && token.b )
+					((uint8_t*)m_bufferArray)[i/8] |= uint8_t(1 << (i & 0x7));
+				break;
+			case ElementType::DOUBLE: ((double*)m_bufferArray)[i] = value; break;
+			case ElementType::FLOAT: ((float*)m_bufferArray)[i] = float(value); break;
+			case ElementType::INT32: ((int32_t*)m_bufferArray)[i] = token.kind == CborToken::NEGATIVE ? int32_t(token.i) : token.kind == CborToken::UINT ? int32_t(token.u) : 0; break;
+			case ElementType::INT64: ((int64_t*)m_bufferArray)[i] = token.kind == CborToken::NEGATIVE ? token.i : token.kind == CborToken::UINT ? int64_t(token.u) : 0; break;
+			case ElementType::UINT64: ((uint64_t*)m_bufferArray)[i] = token.kind == CborToken::UINT ? token.u : 0; break;
+			default: break;
+			}
+		}
+		return _data;
+	}
+
+} // namespace Files
+} // namespace Jo
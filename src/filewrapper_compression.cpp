@@ -0,0 +1,384 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include "platform.hpp"
+#include "../dependencies/zlib128/zlib.h"
+#include <cstring>	// memcpy
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#ifdef JO_SSE2
+#	include <emmintrin.h>
+#endif
+#include <algorithm>
+#include <type_traits>
+
+namespace Jo {
+namespace Files {
+
+	// Codecs of compressed SRAW arrays. The value is stored in the CODEC byte.
+	static const uint8_t CODEC_SHUFFLE_DEFLATE = 1;	///< Byte planes of all elements, then zlib
+	static const uint8_t CODEC_DELTA_VARINT = 2;	///< Zig-zag encoded differences as LEB128
+
+	// ********************************************************************* //
+	// Static helper methods												 //
+	// ********************************************************************* //
+
+	/// \brief Number of bytes of one element (BIT arrays are shuffled
+	///		bytewise).
+	static int ElementBytes( MetaFileWrapper::ElementType _type )
+	{
+		return (int)std::max<int64_t>( 1, MetaFileWrapper::ELEMENT_TYPE_SIZE[(int)_type] / 8 );
+	}
+
+	// ********************************************************************* //
+	// Store byte i of all elements before byte i+1 of all elements. Floats
+	// of similar magnitude have equal exponent bytes which deflate well.
+	static void Shuffle( const uint8_t* _src, uint8_t* _dst, uint64_t _numElements, int _elementSize )
+	{
+		for( int b=0; b<_elementSize; ++b )
+		{
+			uint8_t* plane = _dst + b * _numElements;
+			for( uint64_t i=0; i<_numElements; ++i )
+				plane[i] = _src[i * _elementSize + b];
+		}
+	}
+
+	// Arrays from hosts with the other byte order are swapped on the fly by
+	// writing the byte planes in reverse order.
+	static void Unshuffle( const uint8_t* _src, uint8_t* _dst, uint64_t _numElements, int _elementSize, bool _swap )
+	{
+		for( int b=0; b<_elementSize; ++b )
+		{
+			const uint8_t* plane = _src + b * _numElements;
+			int target = _swap ? _elementSize - 1 - b : b;
+			for( uint64_t i=0; i<_numElements; ++i )
+				_dst[i * _elementSize + target] = plane[i];
+		}
+	}
+
+	// ********************************************************************* //
+	static bool EncodeShuffleDeflate( const uint8_t* _data, uint64_t _size, int _elementSize, std::vector<uint8_t>& _encoded )
+	{
+		// zlib counts with uLong which has 32 bit on some platforms
+		if( _size > 0xffffffffull ) return false;
+
+		std::vector<uint8_t> shuffled;
+		if( _elementSize > 1 )
+		{
+			shuffled.resize( (size_t)_size );
+			Shuffle( _data, shuffled.data(), _size / _elementSize, _elementSize );
+			_data = shuffled.data();
+		}
+
+		uLongf encodedSize = compressBound( uLong(_size) );
+		_encoded.resize( encodedSize );
+		if( compress2( _encoded.data(), &encodedSize, _data, uLong(_size), Z_DEFAULT_COMPRESSION ) != Z_OK )
+			return false;
+		_encoded.resize( encodedSize );
+		return true;
+	}
+
+	// ********************************************************************* //
+	static void DecodeShuffleDeflate( const uint8_t* _encoded, uint64_t _encodedSize, uint8_t* _data, uint64_t _size, int _elementSize, bool _swap )
+	{
+		if( _size > 0xffffffffull || _encodedSize > 0xffffffffull ) throw std::string("[MetaFileWrapper::DecodeArray] Compressed array is too large.");
+
+		std::vector<uint8_t> shuffled;
+		uint8_t* target = _data;
+		if( _elementSize > 1 )
+		{
+			shuffled.resize( (size_t)_size );
+			target = shuffled.data();
+		}
+
+		uLongf size = uLongf(_size);
+		if( uncompress( target, &size, _encoded, uLong(_encodedSize) ) != Z_OK || size != _size )
+			throw std::string("[MetaFileWrapper::DecodeArray] Corrupted deflate stream.");
+
+		if( _elementSize > 1 )
+			Unshuffle( target, _data, _size / _elementSize, _elementSize, _swap );
+	}
+
+	// ********************************************************************* //
+	// Differences are computed modulo 2^bits, so signed and unsigned
+	// arrays of the same width share one implementation.
+	template<typename U>
+	static void EncodeDeltaVarint( const U* _values, uint64_t _numElements, std::vector<uint8_t>& _encoded )
+	{
+		typedef typename std::make_signed<U>::type S;
+		_encoded.clear();
+		_encoded.reserve( (size_t)(_numElements * sizeof(U) / 2) );
+		U previous = 0;
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			int64_t delta = (S)U(_values[i] - previous);
+			previous = _values[i];
+			uint64_t zigZag = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+			while( zigZag >= 0x80 )
+			{
+				_encoded.push_back( uint8_t(zigZag) | 0x80 );
+				zigZag >>= 7;
+			}
+			_encoded.push_back( uint8_t(zigZag) );
+		}
+	}
+
+	// ********************************************************************* //
+	template<typename U>
+	static void DecodeDeltaVarint( const uint8_t* _encoded, uint64_t _encodedSize, U* _values, uint64_t _numElements )
+	{
+		const uint8_t* end = _encoded + _encodedSize;
+		U previous = 0;
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			uint64_t zigZag = 0;
+			int shift = 0;
+			uint8_t byte;
+			do {
+				if( _encoded == end || shift > 63 ) throw std::string("[MetaFileWrapper::DecodeArray] Corrupted varint data.");
+				byte = *_encoded++;
+				zigZag |= uint64_t(byte & 0x7f) << shift;
+				shift += 7;
+			} while( byte & 0x80 );
+			int64_t delta = int64_t(zigZag >> 1) ^ -int64_t(zigZag & 1);
+			previous = U(previous + U(delta));
+			_values[i] = previous;
+		}
+		if( _encoded != end ) throw std::string("[MetaFileWrapper::DecodeArray] Corrupted varint data.");
+	}
+
+	// ********************************************************************* //
+	// Value range of an integer array. The generic version is left to the
+	// auto vectorizer. SSE2 only has unsigned 8 bit and signed 16 bit
+	// min/max: other types are biased into these by flipping the sign bit,
+	// 32 bit values are compared and blended.
+	template<typename T> static void ScanRange( const T* _data, uint64_t _num, T& _min, T& _max )
+	{
+		T lo = _data[0], hi = _data[0];
+		for( uint64_t i=1; i<_num; ++i )
+		{
+			lo = _data[i] < lo ? _data[i] : lo;
+			hi = _data[i] > hi ? _data[i] : hi;
+		}
+		_min = lo;
+		_max = hi;
+	}
+
+#ifdef JO_SSE2
+	// Reduce the lanes of the vector accumulators and the remaining elements.
+	template<typename T> static void FinishRange( __m128i _lo, __m128i _hi, __m128i _bias, const T* _data, uint64_t _first, uint64_t _num, T& _min, T& _max )
+	{
+		T lanes[2][16 / sizeof(T)];
+		_mm_storeu_si128( (__m128i*)lanes[0], _mm_xor_si128(_lo, _bias) );
+		_mm_storeu_si128( (__m128i*)lanes[1], _mm_xor_si128(_hi, _bias) );
+		ScanRange( lanes[0], 16 / sizeof(T), _min, _max );
+		T dummy, max;
+		ScanRange( lanes[1], 16 / sizeof(T), dummy, max );
+		_max = std::max( _max, max );
+		if( _first < _num )
+		{
+			T min;
+			ScanRange( _data + _first, _num - _first, min, max );
+			_min = std::min( _min, min );
+			_max = std::max( _max, max );
+		}
+	}
+
+	template<typename T> static void ScanRange8( const T* _data, uint64_t _num, T& _min, T& _max )
+	{
+		if( _num < 16 ) { ScanRange( _data, _num, _min, _max ); return; }
+		const __m128i bias = _mm_set1_epi8( T(-1) < 0 ? char(0x80) : 0 );
+		__m128i lo = _mm_xor_si128( _mm_loadu_si128((const __m128i*)_data), bias ), hi = lo;
+		uint64_t i = 16;
+		for( ; i+16 <= _num; i+=16 )
+		{
+			__m128i v = _mm_xor_si128( _mm_loadu_si128((const __m128i*)(_data+i)), bias );
+			lo = _mm_min_epu8( lo, v );
+			hi = _mm_max_epu8( hi, v );
+		}
+		FinishRange( lo, hi, bias, _data, i, _num, _min, _max );
+	}
+	static void ScanRange( const int8_t* _data, uint64_t _num, int8_t& _min, int8_t& _max )			{ ScanRange8( _data, _num, _min, _max ); }
+
+	template<typename T> static void ScanRange16( const T* _data, uint64_t _num, T& _min, T& _max )
+	{
+		if( _num < 8 ) { ScanRange( _data, _num, _min, _max ); return; }
+		const __m128i bias = _mm_set1_epi16( T(-1) < 0 ? 0 : short(0x8000) );
+		__m128i lo = _mm_xor_si128( _mm_loadu_si128((const __m128i*)_data), bias ), hi = lo;
+		uint64_t i = 8;
+		for( ; i+8 <= _num; i+=8 )
+		{
+			__m128i v = _mm_xor_si128( _mm_loadu_si128((const __m128i*)(_data+i)), bias );
+			lo = _mm_min_epi16( lo, v );
+			hi = _mm_max_epi16( hi, v );
+		}
+		FinishRange( lo, hi, bias, _data, i, _num, _min, _max );
+	}
+	static void ScanRange( const int16_t* _data, uint64_t _num, int16_t& _min, int16_t& _max )		{ ScanRange16( _data, _num, _min, _max ); }
+	static void ScanRange( const uint16_t* _data, uint64_t _num, uint16_t& _min, uint16_t& _max )	{ ScanRange16( _data, _num, _min, _max ); }
+
+	template<typename T> static void ScanRange32( const T* _data, uint64_t _num, T& _min, T& _max )
+	{
+		if( _num < 4 ) { ScanRange( _data, _num, _min, _max ); return; }
+		const __m128i bias = _mm_set1_epi32( T(-1) < 0 ? 0 : int(0x80000000) );
+		__m128i lo = _mm_xor_si128( _mm_loadu_si128((const __m128i*)_data), bias ), hi = lo;
+		uint64_t i = 4;
+		for( ; i+4 <= _num; i+=4 )
+		{
+			__m128i v = _mm_xor_si128( _mm_loadu_si128((const __m128i*)(_data+i)), bias );
+			__m128i less = _mm_cmpgt_epi32( lo, v );
+			lo = _mm_or_si128( _mm_and_si128(less, v), _mm_andnot_si128(less, lo) );
+			__m128i greater = _mm_cmpgt_epi32( v, hi );
+			hi = _mm_or_si128( _mm_and_si128(greater, v), _mm_andnot_si128(greater, hi) );
+		}
+		FinishRange( lo, hi, bias, _data, i, _num, _min, _max );
+	}
+	static void ScanRange( const int32_t* _data, uint64_t _num, int32_t& _min, int32_t& _max )		{ ScanRange32( _data, _num, _min, _max ); }
+	static void ScanRange( const uint32_t* _data, uint64_t _num, uint32_t& _min, uint32_t& _max )	{ ScanRange32( _data, _num, _min, _max ); }
+#endif
+
+	// ********************************************************************* //
+	// Smallest number of bytes of a signed/unsigned integer which holds
+	// the range.
+	static int SignedBytes( int64_t _min, int64_t _max )
+	{
+		if( _min >= INT8_MIN && _max <= INT8_MAX ) return 1;
+		if( _min >= INT16_MIN && _max <= INT16_MAX ) return 2;
+		if( _min >= INT32_MIN && _max <= INT32_MAX ) return 4;
+		return 8;
+	}
+
+	static int UnsignedBytes( uint64_t _max )
+	{
+		if( _max <= UINT8_MAX ) return 1;
+		if( _max <= UINT16_MAX ) return 2;
+		if( _max <= UINT32_MAX ) return 4;
+		return 8;
+	}
+
+	template<typename T> static MetaFileWrapper::ElementType NarrowType( MetaFileWrapper::ElementType _type, const T* _data, uint64_t _num )
+	{
+		typedef MetaFileWrapper::ElementType ElementType;
+		T min, max;
+		ScanRange( _data, _num, min, max );
+		int bytes = int(sizeof(T));
+		bool isSigned = T(-1) < 0;
+		int signedBytes = isSigned ? SignedBytes( int64_t(min), int64_t(max) ) : 8;
+		int unsignedBytes = !isSigned || int64_t(min) >= 0 ? UnsignedBytes( uint64_t(max) ) : 8;
+		// Keep the signedness if both are equally small
+		if( isSigned ? signedBytes <= unsignedBytes : signedBytes < unsignedBytes )
+		{
+			if( signedBytes >= bytes ) return _type;
+			return signedBytes == 1 ? ElementType::INT8 : (signedBytes == 2 ? ElementType::INT16 : ElementType::INT32);
+		}
+		if( unsignedBytes >= bytes ) return _type;
+		return unsignedBytes == 1 ? ElementType::UINT8 : (unsignedBytes == 2 ? ElementType::UINT16 : ElementType::UINT32);
+	}
+
+	// ********************************************************************* //
+	// MetaFileWrapper														 //
+	// ********************************************************************* //
+
+	uint8_t MetaFileWrapper::EncodeArray( ElementType _type, const void* _data, uint64_t _numElements, std::vector<uint8_t>& _encoded )
+	{
+		uint64_t size = ArraySize( _numElements, _type );
+
+		// Integers with more than one byte: try the delta code first
+		int elementSize = ElementBytes( _type );
+		bool isInt = (_type >= ElementType::INT8 && _type <= ElementType::UINT64);
+		if( isInt && elementSize > 1 )
+		{
+			switch( elementSize )
+			{
+			case 2: EncodeDeltaVarint( (const uint16_t*)_data, _numElements, _encoded ); break;
+			case 4: EncodeDeltaVarint( (const uint32_t*)_data, _numElements, _encoded ); break;
+			default: EncodeDeltaVarint( (const uint64_t*)_data, _numElements, _encoded ); break;
+			}
+			if( _encoded.size() < size ) return CODEC_DELTA_VARINT;
+		}
+
+		if( EncodeShuffleDeflate( (const uint8_t*)_data, size, _type == ElementType::BIT ? 1 : elementSize, _encoded )
+			&& _encoded.size() < size )
+			return CODEC_SHUFFLE_DEFLATE;
+
+		_encoded.clear();
+		return 0;
+	}
+
+	// ********************************************************************* //
+	MetaFileWrapper::ElementType MetaFileWrapper::NarrowestType( ElementType _type, const void* _data, uint64_t _numElements )
+	{
+		if( _numElements == 0 ) return _type;
+		switch( _type )
+		{
+		case ElementType::INT8:		return NarrowType( _type, (const int8_t*)_data, _numElements );
+		case ElementType::INT16:	return NarrowType( _type, (const int16_t*)_data, _numElements );
+		case ElementType::INT32:	return NarrowType( _type, (const int32_t*)_data, _numElements );
+		case ElementType::INT64:	return NarrowType( _type, (const int64_t*)_data, _numElements );
+		case ElementType::UINT8:	return _type;
+		case ElementType::UINT16:	return NarrowType( _type, (const uint16_t*)_data, _numElements );
+		case ElementType::UINT32:	return NarrowType( _type, (const uint32_t*)_data, _numElements );
+		case ElementType::UINT64:	return NarrowType( _type, (const uint64_t*)_data, _numElements );
+		default:					return _type;
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::DecodeArray( uint8_t _codec, ElementType _type, const uint8_t* _encoded, uint64_t _encodedSize, void* _data, uint64_t _numElements, bool _swap )
+	{
+		int elementSize = ElementBytes( _type );
+		if( _codec == CODEC_SHUFFLE_DEFLATE )
+			DecodeShuffleDeflate( _encoded, _encodedSize, (uint8_t*)_data, ArraySize( _numElements, _type ), _type == ElementType::BIT ? 1 : elementSize, _swap );
+		else if( _codec == CODEC_DELTA_VARINT && _type >= ElementType::INT8 && _type <= ElementType::UINT64 )
+		{
+			// The varint code stores values and does not depend on the byte order
+			switch( elementSize )
+			{
+			case 1: DecodeDeltaVarint( _encoded, _encodedSize, (uint8_t*)_data, _numElements ); break;
+			case 2: DecodeDeltaVarint( _encoded, _encodedSize, (uint16_t*)_data, _numElements ); break;
+			case 4: DecodeDeltaVarint( _encoded, _encodedSize, (uint32_t*)_data, _numElements ); break;
+			default: DecodeDeltaVarint( _encoded, _encodedSize, (uint64_t*)_data, _numElements ); break;
+			}
+		} else throw std::string("[MetaFileWrapper::DecodeArray] Unknown codec.");
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::DecodePending( std::vector<PendingArray>& _pending )
+	{
+		if( _pending.empty() ) return;
+		bool swap = ((_pending[0].node->m_file->m_srawFlags & BIG_ENDIAN_FILE) != 0) == IsLittleEndian();
+
+		// The arrays are independent. Each worker takes the next one.
+		std::atomic<size_t> next( 0 );
+		std::mutex errorMutex;
+		std::string error;
+		auto work = [&]() {
+			for( size_t i = next++; i < _pending.size(); i = next++ )
+			{
+				PendingArray& array = _pending[i];
+				try {
+					DecodeArray( array.codec, array.node->m_type, array.encoded.data(), array.encoded.size(), array.node->m_bufferArray, array.node->m_numElements, swap );
+				} catch( const std::string& _message ) {
+					std::lock_guard<std::mutex> lock( errorMutex );
+					error = _message;
+				}
+				// Release the memory early
+				std::vector<uint8_t>().swap( array.encoded );
+			}
+		};
+
+		size_t numThreads = std::min<size_t>( std::thread::hardware_concurrency(), _pending.size() );
+		std::vector<std::thread> threads;
+		for( size_t i=1; i<numThreads; ++i )
+			threads.push_back( std::thread(work) );
+		work();
+		for( size_t i=0; i<threads.size(); ++i )
+			threads[i].join();
+
+		if( !error.empty() ) throw error;
+	}
+
+} // namespace Files
+} // namespace Jo
@@ -0,0 +1,240 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	// ********************************************************************* //
+	// XXH64 by Yann Collet. The hashes are only compared in memory and use
+	// the byte order of the host.
+	static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+	static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+	static const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+	static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+	static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+	static uint64_t RotateLeft( uint64_t _value, int _bits )	{ return (_value << _bits) | (_value >> (64 - _bits)); }
+	static uint64_t Load64( const uint8_t* _data )	{ uint64_t v; memcpy( &v, _data, 8 ); return v; }
+	static uint32_t Load32( const uint8_t* _data )	{ uint32_t v; memcpy( &v, _data, 4 ); return v; }
+
+	static uint64_t HashRound( uint64_t _acc, uint64_t _input )
+	{
+		_acc += _input * PRIME64_2;
+		return RotateLeft( _acc, 31 ) * PRIME64_1;
+	}
+
+	static uint64_t HashMerge( uint64_t _acc, uint64_t _value )
+	{
+		_acc ^= HashRound( 0, _value );
+		return _acc * PRIME64_1 + PRIME64_4;
+	}
+
+	static uint64_t HashBytes( const void* _data, uint64_t _size, uint64_t _seed )
+	{
+		const uint8_t* p = (const uint8_t*)_data;
+		const uint8_t* end = p + _size;
+		uint64_t h;
+		if( _size >= 32 )
+		{
+			uint64_t v1 = _seed + PRIME64_1 + PRIME64_2;
+			uint64_t v2 = _seed + PRIME64_2;
+			uint64_t v3 = _seed;
+			uint64_t v4 = _seed - PRIME64_1;
+			for( ; p + 32 <= end; p += 32 )
+			{
+				v1 = HashRound( v1, Load64(p) );
+				v2 = HashRound( v2, Load64(p+8) );
+				v3 = HashRound( v3, Load64(p+16) );
+				v4 = HashRound( v4, Load64(p+24) );
+			}
+			h = RotateLeft( v1, 1 ) + RotateLeft( v2, 7 ) + RotateLeft( v3, 12 ) + RotateLeft( v4, 18 );
+			h = HashMerge( HashMerge( HashMerge( HashMerge( h, v1 ), v2 ), v3 ), v4 );
+		} else h = _seed + PRIME64_5;
+		h += _size;
+
+		for( ; p + 8 <= end; p += 8 )
+			h = RotateLeft( h ^ HashRound( 0, Load64(p) ), 27 ) * PRIME64_1 + PRIME64_4;
+		if( p + 4 <= end )
+		{
+			h = RotateLeft( h ^ (Load32(p) * PRIME64_1), 23 ) * PRIME64_2 + PRIME64_3;
+			p += 4;
+		}
+		for( ; p < end; ++p )
+			h = RotateLeft( h ^ (*p * PRIME64_5), 11 ) * PRIME64_1;
+
+		h ^= h >> 33;
+		h *= PRIME64_2;
+		h ^= h >> 29;
+		h *= PRIME64_3;
+		return h ^ (h >> 32);
+	}
+
+	// ********************************************************************* //
+	// The unused bits of the last byte of a BIT array are undefined.
+	static uint8_t LastBits( const void* _data, uint64_t _numBits )
+	{
+		return ((const uint8_t*)_data)[_numBits / 8] & uint8_t((1 << (_numBits % 8)) - 1);
+	}
+
+	// ********************************************************************* //
+	uint64_t MetaFileWrapper::Node::GetHash() const
+	{
+		uint64_t hash = m_hash.load( std::memory_order_relaxed );
+		if( hash ) return hash;
+
+		uint64_t seed = (uint64_t(m_type) * PRIME64_1) ^ m_numElements;
+		switch( m_type )
+		{
+		case ElementType::UNKNOWN:
+			hash = HashBytes( nullptr, 0, seed );
+			break;
+		case ElementType::NODE: {
+			// Each child contributes the hash of its name and its content
+			std::vector<uint64_t> children( size_t(m_numElements * 2) );
+			for( uint64_t i=0; i<m_numElements; ++i )
+			{
+				const Node* child = Child(i);
+				children[size_t(i*2)] = HashBytes( child->m_name->data(), child->m_name->length(), 0 );
+				children[size_t(i*2+1)] = child->GetHash();
+			}
+			hash = HashBytes( children.data(), m_numElements * 16, seed );
+			} break;
+		case ElementType::STRING: {
+			const uint64_t* ends = (const uint64_t*)m_bufferArray;
+			hash = HashBytes( ends, m_numElements * 8, seed );
+			hash = HashBytes( m_strings, m_numElements ? ends[m_numElements-1] : 0, hash );
+			} break;
+		case ElementType::BIT:
+			hash = HashBytes( m_bufferArray, m_numElements / 8, seed );
+			if( m_numElements % 8 )
+			{
+				uint8_t last = LastBits( m_bufferArray, m_numElements );
+				hash = HashBytes( &last, 1, hash );
+			}
+			break;
+		default:
+			hash = HashBytes( m_bufferArray, ArraySize( m_numElements, m_type ), seed );
+		}
+
+		// 0 marks an unknown hash. Concurrent readers store the same value.
+		if( hash == 0 ) hash = 1;
+		m_hash.store( hash, std::memory_order_relaxed );
+		return hash;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::InvalidateHash()
+	{
+		// Hashes are computed bottom-up: if a node has no hash, none of its
+		// ancestors has one either.
+		for( Node* node = this; node && node->m_hash.load( std::memory_order_relaxed ); node = node->m_parent )
+			node->m_hash.store( 0, std::memory_order_relaxed );
+	}
+
+	// ********************************************************************* //
+	bool MetaFileWrapper::Node::SameContent( const Node& _other ) const
+	{
+		if( this == &_other ) return true;
+		if( m_type != _other.m_type || m_numElements != _other.m_numElements ) return false;
+		switch( m_type )
+		{
+		case ElementType::UNKNOWN:
+			return true;
+		case ElementType::NODE:
+			for( uint64_t i=0; i<m_numElements; ++i )
+			{
+				const Node* a = Child(i);
+				const Node* b = _other.Child(i);
+				if( (a->m_name != b->m_name && *a->m_name != *b->m_name) || !a->SameContent( *b ) )
+					return false;
+			}
+			return true;
+		case ElementType::STRING: {
+			const uint64_t* ends = (const uint64_t*)m_bufferArray;
+			if( memcmp( ends, _other.m_bufferArray, size_t(m_numElements * 8) ) ) return false;
+			return m_numElements == 0 || ends[m_numElements-1] == 0
+				|| memcmp( m_strings, _other.m_strings, size_t(ends[m_numElements-1]) ) == 0; }
+		case ElementType::BIT:
+			if( memcmp( m_bufferArray, _other.m_bufferArray, size_t(m_numElements / 8) ) ) return false;
+			return m_numElements % 8 == 0 || LastBits( m_bufferArray, m_numElements ) == LastBits( _other.m_bufferArray, m_numElements );
+		default:
+			return memcmp( m_bufferArray, _other.m_bufferArray, size_t(ArraySize( m_numElements, m_type )) ) == 0;
+		}
+	}
+
+	// ********************************************************************* //
+	// Append a reference token of a JSON pointer.
+	static void AppendPathStep( std::string& _path, const std::string& _name, uint64_t _index )
+	{
+		_path += '/';
+		if( _name.empty() ) { _path += std::to_string( _index ); return; }
+		for( size_t i=0; i<_name.length(); ++i )
+		{
+			if( _name[i] == '~' ) _path += "~0";
+			else if( _name[i] == '/' ) _path += "~1";
+			else _path += _name[i];
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::Diff( const Node& _other, std::vector<uint64_t>& _indices, std::string& _path, std::vector<Difference>& _differences ) const
+	{
+		if( GetHash() == _other.GetHash() ) return;
+
+		Difference difference;
+		if( m_type != ElementType::NODE || _other.m_type != ElementType::NODE )
+		{
+			difference.kind = Difference::Kind::CHANGED;
+			difference.path = _path;
+			difference.indices = _indices;
+			_differences.push_back( difference );
+			return;
+		}
+
+		size_t pathLength = _path.length();
+		uint64_t numChildren = std::max( m_numElements, _other.m_numElements );
+		for( uint64_t i=0; i<numChildren; ++i )
+		{
+			const Node* child = i < m_numElements ? Child(i) : nullptr;
+			const Node* otherChild = i < _other.m_numElements ? _other.Child(i) : nullptr;
+			_indices.push_back( i );
+			AppendPathStep( _path, otherChild ? *otherChild->m_name : *child->m_name, i );
+			difference.path = _path;
+			difference.indices = _indices;
+			if( !child )
+			{
+				difference.kind = Difference::Kind::ADDED;
+				_differences.push_back( difference );
+			} else if( !otherChild ) {
+				difference.kind = Difference::Kind::REMOVED;
+				_differences.push_back( difference );
+			} else {
+				// Names of other wrappers are not interned in the same table
+				if( child->m_name != otherChild->m_name && *child->m_name != *otherChild->m_name )
+				{
+					difference.kind = Difference::Kind::RENAMED;
+					_differences.push_back( difference );
+				}
+				child->Diff( *otherChild, _indices, _path, _differences );
+			}
+			_indices.pop_back();
+			_path.resize( pathLength );
+		}
+	}
+
+	// ********************************************************************* //
+	std::vector<MetaFileWrapper::Difference> MetaFileWrapper::Diff( const MetaFileWrapper& _other ) const
+	{
+		std::vector<Difference> differences;
+		std::vector<uint64_t> indices;
+		std::string path;
+		RootNode.Diff( _other.RootNode, indices, path, differences );
+		return differences;
+	}
+
+} // namespace Files
+} // namespace Jo
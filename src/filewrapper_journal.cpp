@@ -0,0 +1,286 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include "platform.hpp"
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	// A journal starts with "SJ" and its version. Each record is
+	//	SIZE (8)		Number of bytes after this field, 0 while the record is written
+	//	OP (1)			One of the JOURNAL_* codes below
+	//	FLAGS (1)		WriteFlags of the SRAW block in the record
+	//	DEPTH (4)		Length of the path
+	//	INDEX (8)*		Child indices from the root to the changed node
+	//	payload			SRAW block, number of children or name (STRING8)
+	// All numbers of the record frame are little-endian.
+	static const uint8_t JOURNAL_MARKER[2] = { 'S', 'J' };
+	static const uint8_t JOURNAL_VERSION = 1;
+	static const uint8_t JOURNAL_SUBTREE = 1;
+	static const uint8_t JOURNAL_CHILD_COUNT = 2;
+	static const uint8_t JOURNAL_NAME = 3;
+	static const uint64_t RECORD_FRAME_SIZE = 1 + 1 + 4;
+
+	// ********************************************************************* //
+	// Static helper methods												 //
+	// ********************************************************************* //
+
+	template<typename T> static void WriteLittleEndian( IFile& _file, T _value )
+	{
+		_value = AsLittleEndian( _value );
+		_file.Write( &_value, sizeof(T) );
+	}
+
+	template<typename T> static T ReadLittleEndian( const IFile& _file )
+	{
+		T value;
+		_file.Read( sizeof(T), &value );
+		return AsLittleEndian( value );
+	}
+
+	// ********************************************************************* //
+	// Write the frame of a record with a placeholder for its size.
+	static uint64_t BeginRecord( IFile& _journal, uint8_t _op, int _flags, const std::vector<uint64_t>& _path )
+	{
+		uint64_t sizePosition = _journal.GetCursor();
+		WriteLittleEndian( _journal, uint64_t(0) );
+		uint8_t code[2] = { _op, uint8_t(_flags) };
+		_journal.Write( code, 2 );
+		WriteLittleEndian( _journal, uint32_t(_path.size()) );
+		for( size_t i=0; i<_path.size(); ++i )
+			WriteLittleEndian( _journal, _path[i] );
+		return sizePosition;
+	}
+
+	// ********************************************************************* //
+	// The size is patched last: a record with size 0 was not completed.
+	static void EndRecord( IFile& _journal, uint64_t _sizePosition )
+	{
+		uint64_t end = _journal.GetCursor();
+		_journal.Seek( _sizePosition );
+		WriteLittleEndian( _journal, end - _sizePosition - 8 );
+		_journal.Seek( end );
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::WriteJournal( IFile& _journal, WriteFlags _flags )
+	{
+		// The byte order of the SRAW blocks is stored per record
+		_flags &= ~BIG_ENDIAN_FILE;
+		if( !IsLittleEndian() ) _flags |= BIG_ENDIAN_FILE;
+
+		_journal.Seek( _journal.GetSize() );
+		if( _journal.GetSize() == 0 )
+		{
+			_journal.Write( JOURNAL_MARKER, 2 );
+			_journal.Write( &JOURNAL_VERSION, 1 );
+		}
+
+		std::vector<uint64_t> path;
+		RootNode.WriteJournalRecords( _journal, _flags, path );
+		RootNode.ClearDirty();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::ReplayJournal( const IFile& _journal )
+	{
+		if( _journal.GetSize() == 0 ) return;
+		_journal.Seek( 0 );
+		uint8_t header[3];
+		_journal.Read( 3, header );
+		if( header[0] != JOURNAL_MARKER[0] || header[1] != JOURNAL_MARKER[1] )
+			throw std::string("[MetaFileWrapper::ReplayJournal] The file is no journal.");
+		if( header[2] > JOURNAL_VERSION ) throw std::string("[MetaFileWrapper::ReplayJournal] Unsupported journal version.");
+
+		while( _journal.GetSize() - _journal.GetCursor() >= 8 )
+		{
+			uint64_t size = ReadLittleEndian<uint64_t>( _journal );
+			uint64_t begin = _journal.GetCursor();
+			// The last record is incomplete if the writer was interrupted
+			if( size < RECORD_FRAME_SIZE || size > _journal.GetSize() - begin ) break;
+
+			uint8_t code[2];
+			_journal.Read( 2, code );
+			uint32_t depth = ReadLittleEndian<uint32_t>( _journal );
+			Node* node = &RootNode;
+			for( uint32_t i=0; i<depth; ++i )
+			{
+				uint64_t index = ReadLittleEndian<uint64_t>( _journal );
+				if( node->m_type != ElementType::NODE || index >= node->m_numElements )
+					throw std::string("[MetaFileWrapper::ReplayJournal] The journal does not belong to this document.");
+				node = node->Child( index );
+			}
+
+			switch( code[0] )
+			{
+			case JOURNAL_SUBTREE:
+				node->ReplaceFromSraw( _journal, code[1] );
+				break;
+			case JOURNAL_CHILD_COUNT:
+				node->Resize( ReadLittleEndian<uint64_t>( _journal ), ElementType::NODE );
+				break;
+			case JOURNAL_NAME: {
+				uint8_t length = _journal.Next();
+				std::string name( length, ' ' );
+				if( length ) _journal.Read( length, &name[0] );
+				node->SetName( name );
+				} break;
+			default:
+				throw std::string("[MetaFileWrapper::ReplayJournal] Unknown record.");
+			}
+			_journal.Seek( begin + size );
+		}
+
+		RootNode.ClearDirty();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::WritePatch( const MetaFileWrapper& _other, IFile& _patch, WriteFlags _flags ) const
+	{
+		_flags &= ~BIG_ENDIAN_FILE;
+		if( !IsLittleEndian() ) _flags |= BIG_ENDIAN_FILE;
+
+		_patch.Seek( _patch.GetSize() );
+		if( _patch.GetSize() == 0 )
+		{
+			_patch.Write( JOURNAL_MARKER, 2 );
+			_patch.Write( &JOURNAL_VERSION, 1 );
+		}
+
+		std::vector<Difference> differences = Diff( _other );
+		std::vector<uint64_t> resized;
+		bool anyResized = false;
+		for( size_t i=0; i<differences.size(); ++i )
+		{
+			const std::vector<uint64_t>& path = differences[i].indices;
+			const Node* node = &_other.RootNode;
+			for( size_t j=0; j+1<path.size(); ++j )
+				node = node->Child( path[j] );
+
+			switch( differences[i].kind )
+			{
+			case Difference::Kind::ADDED:
+			case Difference::Kind::REMOVED: {
+				// All added or removed children of a node follow each other.
+				// The count of the parent comes first and creates them.
+				std::vector<uint64_t> parentPath( path.begin(), path.end() - 1 );
+				if( !anyResized || parentPath != resized )
+				{
+					uint64_t record = BeginRecord( _patch, JOURNAL_CHILD_COUNT, _flags, parentPath );
+					WriteLittleEndian( _patch, node->m_numElements );
+					EndRecord( _patch, record );
+					resized = parentPath;
+					anyResized = true;
+				}
+				if( differences[i].kind == Difference::Kind::ADDED )
+				{
+					uint64_t record = BeginRecord( _patch, JOURNAL_SUBTREE, _flags, path );
+					node->Child( path.back() )->SaveAsSraw( _patch, _flags );
+					EndRecord( _patch, record );
+				}
+				} break;
+			case Difference::Kind::CHANGED: {
+				if( !path.empty() ) node = node->Child( path.back() );
+				uint64_t record = BeginRecord( _patch, JOURNAL_SUBTREE, _flags, path );
+				node->SaveAsSraw( _patch, _flags );
+				EndRecord( _patch, record );
+				} break;
+			case Difference::Kind::RENAMED: {
+				node = node->Child( path.back() );
+				uint64_t record = BeginRecord( _patch, JOURNAL_NAME, _flags, path );
+				uint8_t length = uint8_t(node->m_name->length());
+				_patch.Write( &length, 1 );
+				_patch.Write( node->m_name->data(), length );
+				EndRecord( _patch, record );
+				} break;
+			}
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Compact( IFile& _snapshot, WriteFlags _flags )
+	{
+		Write( _snapshot, Format::SRAW, _flags );
+		RootNode.ClearDirty();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ClearDirty()
+	{
+		m_dirty = 0;
+		// Nodes which were not decoded cannot be changed
+		if( m_type != ElementType::NODE || m_lazy.load(std::memory_order_relaxed) == HEADER_ONLY ) return;
+		Node** children = (Node**)m_bufferArray;
+		for( uint64_t i=0; i<m_numElements; ++i )
+			if( children[i] ) children[i]->ClearDirty();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::WriteJournalRecords( IFile& _journal, WriteFlags _flags, std::vector<uint64_t>& _path ) const
+	{
+		if( m_lazy.load(std::memory_order_relaxed) == HEADER_ONLY ) return;
+
+		if( m_dirty & DIRTY_SUBTREE )
+		{
+			uint64_t record = BeginRecord( _journal, JOURNAL_SUBTREE, _flags, _path );
+			SaveAsSraw( _journal, _flags );
+			EndRecord( _journal, record );
+			return;
+		}
+		if( m_dirty & DIRTY_NAME )
+		{
+			uint64_t record = BeginRecord( _journal, JOURNAL_NAME, _flags, _path );
+			uint8_t length = uint8_t(m_name->length());
+			_journal.Write( &length, 1 );
+			_journal.Write( m_name->data(), length );
+			EndRecord( _journal, record );
+		}
+		if( m_dirty & DIRTY_CHILD_COUNT )
+		{
+			uint64_t record = BeginRecord( _journal, JOURNAL_CHILD_COUNT, _flags, _path );
+			WriteLittleEndian( _journal, m_numElements );
+			EndRecord( _journal, record );
+		}
+
+		// Children are recorded after the count which creates them
+		if( m_type != ElementType::NODE ) return;
+		Node** children = (Node**)m_bufferArray;
+		for( uint64_t i=0; i<m_numElements; ++i )
+			if( children[i] )
+			{
+				_path.push_back( i );
+				children[i]->WriteJournalRecords( _journal, _flags, _path );
+				_path.pop_back();
+			}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ReplaceFromSraw( const IFile& _journal, int _srawFlags )
+	{
+		CheckWritable();
+		MetaFileWrapper* wrapper = m_file;
+		Node* parent = m_parent;
+		this->~Node();
+		new (this) Node( wrapper, "" );
+		m_parent = parent;
+		if( parent ) parent->InvalidateHash();
+
+		// The block is not part of the source file
+		int srawFlags = wrapper->m_srawFlags;
+		const uint8_t* sourceMemory = wrapper->m_sourceMemory;
+		wrapper->m_srawFlags = _srawFlags;
+		wrapper->m_sourceMemory = nullptr;
+		try {
+			ReadSraw( _journal, false );
+		} catch(...) {
+			wrapper->m_srawFlags = srawFlags;
+			wrapper->m_sourceMemory = sourceMemory;
+			throw;
+		}
+		wrapper->m_srawFlags = srawFlags;
+		wrapper->m_sourceMemory = sourceMemory;
+	}
+
+} // namespace Files
+} // namespace Jo
@@ -0,0 +1,486 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include "platform.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	// MessagePack stores all numbers big-endian. The structure is the one of
+	// the JSON writer: NODEs with named children are maps, all others
+	// arrays. Data nodes are scalars if they have a name and one element.
+	// With PACKED_ARRAYS numeric and BIT arrays are ext values whose type is
+	// the ElementType and whose payload are the little-endian elements. BIT
+	// payloads start with the number of unused bits in the last byte.
+
+	// The writer collects small values and writes them in blocks of this
+	// size.
+	static const size_t MSGPACK_BLOCK_SIZE = 65536;
+
+	// ********************************************************************* //
+	struct MetaFileWrapper::MsgpackWriter
+	{
+		IFile& file;
+		std::vector<uint8_t> buffer;
+
+		explicit MsgpackWriter( IFile& _file ) : file( _file )	{ buffer.reserve( MSGPACK_BLOCK_SIZE ); }
+
+		void Flush()
+		{
+			if( !buffer.empty() ) file.Write( buffer.data(), buffer.size() );
+			buffer.clear();
+		}
+
+		void Put( uint8_t _byte )
+		{
+			if( buffer.size() == MSGPACK_BLOCK_SIZE ) Flush();
+			buffer.push_back( _byte );
+		}
+
+		void Put( const void* _data, uint64_t _size )
+		{
+			if( buffer.size() + _size > MSGPACK_BLOCK_SIZE )
+			{
+				Flush();
+				// Large payloads are not copied
+				if( _size > MSGPACK_BLOCK_SIZE ) { file.Write( _data, _size ); return; }
+			}
+			buffer.insert( buffer.end(), (const uint8_t*)_data, (const uint8_t*)_data + _size );
+		}
+
+		template<typename T> void PutBig( uint8_t _code, T _value )
+		{
+			_value = AsBigEndian( _value );
+			Put( _code );
+			Put( &_value, sizeof(T) );
+		}
+
+		/// \brief Header of an array, map, string or binary value with the
+		///		smallest length field.
+		/// \param [in] _fix The code with a 4 or 5 bit length or 0.
+		/// \param [in] _codes Codes with 8, 16 and 32 bit lengths, 0 if
+		///		there is no such code.
+		void Header( uint8_t _fix, uint64_t _fixLimit, const uint8_t* _codes, uint64_t _length )
+		{
+			if( _fix && _length < _fixLimit ) Put( uint8_t(_fix | _length) );
+			else if( _codes[0] && _length <= 0xff ) { Put( _codes[0] ); Put( uint8_t(_length) ); }
+			else if( _length <= 0xffff ) PutBig( _codes[1], uint16_t(_length) );
+			else if( _length <= 0xffffffff ) PutBig( _codes[2], uint32_t(_length) );
+			else throw std::string("[Node::SaveAsMsgpack] Too many elements for MessagePack.");
+		}
+
+		void ArrayHeader( uint64_t _length )	{ static const uint8_t CODES[3] = { 0, 0xdc, 0xdd }; Header( 0x90, 16, CODES, _length ); }
+		void MapHeader( uint64_t _length )		{ static const uint8_t CODES[3] = { 0, 0xde, 0xdf }; Header( 0x80, 16, CODES, _length ); }
+
+		void String( const char* _data, uint64_t _length )
+		{
+			static const uint8_t CODES[3] = { 0xd9, 0xda, 0xdb };
+			Header( 0xa0, 32, CODES, _length );
+			Put( _data, _length );
+		}
+
+		void Unsigned( uint64_t _value )
+		{
+			if( _value < 0x80 ) Put( uint8_t(_value) );
+			else if( _value <= 0xff ) { Put( 0xcc ); Put( uint8_t(_value) ); }
+			else if( _value <= 0xffff ) PutBig( 0xcd, uint16_t(_value) );
+			else if( _value <= 0xffffffff ) PutBig( 0xce, uint32_t(_value) );
+			else PutBig( 0xcf, _value );
+		}
+
+		void Signed( int64_t _value )
+		{
+			if( _value >= 0 ) Unsigned( uint64_t(_value) );
+			else if( _value >= -32 ) Put( uint8_t(_value) );
+			else if( _value >= -128 ) { Put( 0xd0 ); Put( uint8_t(_value) ); }
+			else if( _value >= -32768 ) PutBig( 0xd1, int16_t(_value) );
+			else if( _value >= std::numeric_limits<int32_t>::min() ) PutBig( 0xd2, int32_t(_value) );
+			else PutBig( 0xd3, _value );
+		}
+
+		void Ext( int8_t _type, uint64_t _size )
+		{
+			switch( _size )
+			{
+			case 1: Put( 0xd4 ); break;
+			case 2: Put( 0xd5 ); break;
+			case 4: Put( 0xd6 ); break;
+			case 8: Put( 0xd7 ); break;
+			case 16: Put( 0xd8 ); break;
+			default: {
+				static const uint8_t CODES[3] = { 0xc7, 0xc8, 0xc9 };
+				Header( 0, 0, CODES, _size ); }
+			}
+			Put( uint8_t(_type) );
+		}
+	};
+
+	// ********************************************************************* //
+	// Static helper methods												 //
+	// ********************************************************************* //
+
+	// The header of one value. Strings, binaries and ext values include
+	// their payload, arrays and maps are followed by their elements.
+	struct MsgpackToken
+	{
+		enum Kind { NIL, BOOL, INT, UINT, FLOAT32, FLOAT64, STR, BIN, ARRAY, MAP, EXT };
+		Kind kind;
+		union {
+			bool b;
+			int64_t i;
+			uint64_t u;
+			double d;
+		};
+		uint64_t length;			///< Bytes of STR, BIN and EXT or number of elements
+		int8_t extType;
+		const uint8_t* payload;
+	};
+
+	static void Need( const uint8_t* _data, const uint8_t* _end, uint64_t _size )
+	{
+		if( uint64_t(_end - _data) < _size ) throw std::string("[Node::ReadMsgpack] Unexpected end of file.");
+	}
+
+	template<typename T> static T LoadBig( const uint8_t* _data )
+	{
+		T value;
+		memcpy( &value, _data, sizeof(T) );
+		return AsBigEndian( value );
+	}
+
+	// Read the length field of _size bytes.
+	static uint64_t LoadLength( const uint8_t* _data, int _size )
+	{
+		switch( _size )
+		{
+		case 1: return *_data;
+		case 2: return LoadBig<uint16_t>( _data );
+		default: return LoadBig<uint32_t>( _data );
+		}
+	}
+
+	// ********************************************************************* //
+	// Read the header of the next value.
+	// Returns the position after the header and payload.
+	static const uint8_t* ReadToken( const uint8_t* _data, const uint8_t* _end, MsgpackToken& _token )
+	{
+		Need( _data, _end, 1 );
+		uint8_t code = *_data++;
+		_token.length = 0;
+		if( code < 0x80 ) { _token.kind = MsgpackToken::UINT; _token.u = code; return _data; }
+		if( code >= 0xe0 ) { _token.kind = MsgpackToken::INT; _token.i = int8_t(code); return _data; }
+		if( code < 0x90 ) { _token.kind = MsgpackToken::MAP; _token.length = code & 0x0f; return _data; }
+		if( code < 0xa0 ) { _token.kind = MsgpackToken::ARRAY; _token.length = code & 0x0f; return _data; }
+
+		int lengthSize = 0;
+		if( code < 0xc0 ) { _token.kind = MsgpackToken::STR; _token.length = code & 0x1f; }
+		else switch( code )
+		{
+		case 0xc0: _token.kind = MsgpackToken::NIL; return _data;
+		case 0xc2: case 0xc3: _token.kind = MsgpackToken::BOOL; _token.b = code == 0xc3; return _data;
+		case 0xc4: case 0xc5: case 0xc6: _token.kind = MsgpackToken::BIN; lengthSize = 1 << (code - 0xc4); break;
+		case 0xc7: case 0xc8: case 0xc9: _token.kind = MsgpackToken::EXT; lengthSize = 1 << (code - 0xc7); break;
+		case 0xca: Need( _data, _end, 4 ); { uint32_t bits = LoadBig<uint32_t>( _data ); float f; memcpy( &f, &bits, 4 ); _token.d = f; }
+			_token.kind = MsgpackToken::FLOAT32; return _data + 4;
+		case 0xcb: Need( _data, _end, 8 ); { uint64_t bits = LoadBig<uint64_t>( _data ); memcpy( &_token.d, &bits, 8 ); }
+			_token.kind = MsgpackToken::FLOAT64; return _data + 8;
+		case 0xcc: Need( _data, _end, 1 ); _token.kind = MsgpackToken::UINT; _token.u = *_data; return _data + 1;
+		case 0xcd: Need( _data, _end, 2 ); _token.kind = MsgpackToken::UINT; _token.u = LoadBig<uint16_t>( _data ); return _data + 2;
+		case 0xce: Need( _data, _end, 4 ); _token.kind = MsgpackToken::UINT; _token.u = LoadBig<uint32_t>( _data ); return _data + 4;
+		case 0xcf: Need( _data, _end, 8 ); _token.kind = MsgpackToken::UINT; _token.u = LoadBig<uint64_t>( _data ); return _data + 8;
+		case 0xd0: Need( _data, _end, 1 ); _token.kind = MsgpackToken::INT; _token.i = int8_t(*_data); return _data + 1;
+		case 0xd1: Need( _data, _end, 2 ); _token.kind = MsgpackToken::INT; _token.i = LoadBig<int16_t>( _data ); return _data + 2;
+		case 0xd2: Need( _data, _end, 4 ); _token.kind = MsgpackToken::INT; _token.i = LoadBig<int32_t>( _data ); return _data + 4;
+		case 0xd3: Need( _data, _end, 8 ); _token.kind = MsgpackToken::INT; _token.i = LoadBig<int64_t>( _data ); return _data + 8;
+		case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: _token.kind = MsgpackToken::EXT; _token.length = 1ull << (code - 0xd4); break;
+		case 0xd9: case 0xda: case 0xdb: _token.kind = MsgpackToken::STR; lengthSize = 1 << (code - 0xd9); break;
+		case 0xdc: case 0xdd: _token.kind = MsgpackToken::ARRAY; lengthSize = 2 << (code - 0xdc); break;
+		case 0xde: case 0xdf: _token.kind = MsgpackToken::MAP; lengthSize = 2 << (code - 0xde); break;
+		default: throw std::string("[Node::ReadMsgpack] Invalid type code.");
+		}
+
+		if( lengthSize )
+		{
+			Need( _data, _end, lengthSize );
+			_token.length = LoadLength( _data, lengthSize );
+			_data += lengthSize;
+		}
+		if( _token.kind == MsgpackToken::ARRAY || _token.kind == MsgpackToken::MAP ) return _data;
+		if( _token.kind == MsgpackToken::EXT )
+		{
+			Need( _data, _end, 1 );
+			_token.extType = int8_t(*_data++);
+		}
+		Need( _data, _end, _token.length );
+		_token.payload = _data;
+		return _data + _token.length;
+	}
+
+	// ********************************************************************* //
+	// Integers get the type of the JSON reader (INT32) unless they need
+	// more bits.
+	static MetaFileWrapper::ElementType IntegerType( int64_t _min, uint64_t _max )
+	{
+		if( _min >= std::numeric_limits<int32_t>::min() && _max <= uint64_t(std::numeric_limits<int32_t>::max()) )
+			return MetaFileWrapper::ElementType::INT32;
+		if( _max <= uint64_t(std::numeric_limits<int64_t>::max()) ) return MetaFileWrapper::ElementType::INT64;
+		if( _min >= 0 ) return MetaFileWrapper::ElementType::UINT64;
+		throw std::string("[Node::ReadMsgpack] The integers of an array do not fit into one type.");
+	}
+
+	// ********************************************************************* //
+	// Read and write														 //
+	// ********************************************************************* //
+
+	void MetaFileWrapper::Node::SaveAsMsgpack( IFile& _file, WriteFlags _flags ) const
+	{
+		// An empty wrapper produces an empty file
+		if( m_type == ElementType::UNKNOWN && this == &m_file->RootNode ) return;
+
+		MsgpackWriter writer( _file );
+		WriteMsgpack( writer, _flags );
+		writer.Flush();
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::WriteMsgpack( MsgpackWriter& _out, WriteFlags _flags ) const
+	{
+		if( m_type == ElementType::UNKNOWN ) { _out.Put( uint8_t(0xc0) ); return; }
+
+		if( m_type == ElementType::NODE )
+		{
+			// Node arrays have unnamed children
+			bool nodeArray = m_numElements == 0 || Child(0)->m_name->empty();
+			if( nodeArray ) _out.ArrayHeader( m_numElements );
+			else _out.MapHeader( m_numElements );
+			for( uint64_t i=0; i<m_numElements; ++i )
+			{
+				const Node* child = Child(i);
+				if( !nodeArray ) _out.String( child->m_name->data(), child->m_name->length() );
+				child->WriteMsgpack( _out, _flags );
+			}
+			return;
+		}
+
+		bool isArray = m_name->empty() || m_numElements != 1;
+		if( isArray && (_flags & PACKED_ARRAYS) && m_type != ElementType::STRING )
+		{
+			if( m_type == ElementType::BIT )
+			{
+				uint64_t numBytes = ArraySize( m_numElements, m_type );
+				_out.Ext( int8_t(m_type), numBytes + 1 );
+				_out.Put( uint8_t((8 - m_numElements % 8) % 8) );
+				_out.Put( m_bufferArray, m_numElements / 8 );
+				// The unused bits are undefined
+				if( m_numElements % 8 )
+					_out.Put( uint8_t(((const uint8_t*)m_bufferArray)[m_numElements / 8] & ((1 << (m_numElements % 8)) - 1)) );
+				return;
+			}
+			uint64_t size = ArraySize( m_numElements, m_type );
+			_out.Ext( int8_t(m_type), size );
+			if( IsLittleEndian() ) _out.Put( m_bufferArray, size );
+			else {
+				std::vector<uint8_t> swapped( (size_t)size );
+				SwapBytes( m_bufferArray, swapped.data(), m_numElements, int(ELEMENT_TYPE_SIZE[(int)m_type] / 8) );
+				_out.Put( swapped.data(), size );
+			}
+			return;
+		}
+
+		if( isArray ) _out.ArrayHeader( m_numElements );
+		for( uint64_t i=0; i<m_numElements; ++i )
+		{
+			switch( m_type )
+			{
+			case ElementType::BIT:		_out.Put( uint8_t(BitElement(i) ? 0xc3 : 0xc2) ); break;
+			case ElementType::FLOAT:	{ float f = Element<float>(i); uint32_t bits; memcpy( &bits, &f, 4 ); _out.PutBig( 0xca, bits ); } break;
+			case ElementType::DOUBLE:	{ double d = Element<double>(i); uint64_t bits; memcpy( &bits, &d, 8 ); _out.PutBig( 0xcb, bits ); } break;
+			case ElementType::INT8:		_out.Signed( Element<int8_t>(i) ); break;
+			case ElementType::INT16:	_out.Signed( Element<int16_t>(i) ); break;
+			case ElementType::INT32:	_out.Signed( Element<int32_t>(i) ); break;
+			case ElementType::INT64:	_out.Signed( Element<int64_t>(i) ); break;
+			case ElementType::UINT8:	_out.Unsigned( Element<uint8_t>(i) ); break;
+			case ElementType::UINT16:	_out.Unsigned( Element<uint16_t>(i) ); break;
+			case ElementType::UINT32:	_out.Unsigned( Element<uint32_t>(i) ); break;
+			case ElementType::UINT64:	_out.Unsigned( Element<uint64_t>(i) ); break;
+			case ElementType::STRING: {
+				StringView view = GetStringView( i );
+				_out.String( view.data, view.length );
+				} break;
+			default: break;
+			}
+		}
+	}
+
+	// ********************************************************************* //
+	const uint8_t* MetaFileWrapper::Node::ParseMsgpack( const uint8_t* _data, const uint8_t* _end )
+	{
+		MsgpackToken token;
+		const uint8_t* data = ReadToken( _data, _end, token );
+		switch( token.kind )
+		{
+		case MsgpackToken::NIL:
+			// The node remains untyped
+			break;
+		case MsgpackToken::BOOL:
+			*this = token.b;
+			break;
+		case MsgpackToken::INT:
+		case MsgpackToken::UINT: {
+			int64_t minValue = token.kind == MsgpackToken::INT ? token.i : 0;
+			uint64_t maxValue = token.kind == MsgpackToken::UINT ? token.u : 0;
+			switch( IntegerType( minValue, maxValue ) )
+			{
+			case ElementType::INT32: *this = int32_t(token.i); break;
+			case ElementType::INT64: *this = token.i; break;
+			default: *this = token.u;
+			}
+			} break;
+		case MsgpackToken::FLOAT32:
+			*this = float(token.d);
+			break;
+		case MsgpackToken::FLOAT64:
+			*this = token.d;
+			break;
+		case MsgpackToken::STR:
+			*this = std::string( (const char*)token.payload, size_t(token.length) );
+			break;
+		case MsgpackToken::BIN:
+			Resize( token.length, ElementType::UINT8 );
+			memcpy( m_bufferArray, token.payload, size_t(token.length) );
+			break;
+		case MsgpackToken::EXT: {
+			if( token.extType < int8_t(ElementType::BIT) || token.extType > int8_t(ElementType::DOUBLE) )
+				throw std::string("[Node::ReadMsgpack] Unsupported ext type.");
+			ElementType type = ElementType(token.extType);
+			if( type == ElementType::BIT )
+			{
+				if( token.length == 0 || token.payload[0] > 7 || (token.length == 1 && token.payload[0]) )
+					throw std::string("[Node::ReadMsgpack] Invalid BIT array.");
+				Resize( (token.length - 1) * 8 - token.payload[0], type );
+				memcpy( m_bufferArray, token.payload + 1, size_t(token.length - 1) );
+				break;
+			}
+			int elementSize = int(ELEMENT_TYPE_SIZE[(int)type] / 8);
+			if( token.length % elementSize ) throw std::string("[Node::ReadMsgpack] Invalid numeric array.");
+			Resize( token.length / elementSize, type );
+			if( IsLittleEndian() ) memcpy( m_bufferArray, token.payload, size_t(token.length) );
+			else SwapBytes( token.payload, m_bufferArray, m_numElements, elementSize );
+			} break;
+		case MsgpackToken::MAP: {
+			// All children are created at once
+			Resize( token.length, ElementType::NODE );
+			for( uint64_t i=0; i<token.length; ++i )
+			{
+				MsgpackToken key;
+				data = ReadToken( data, _end, key );
+				if( key.kind != MsgpackToken::STR ) throw std::string("[Node::ReadMsgpack] Map keys must be strings.");
+				Node* child = ((Node**)m_bufferArray)[i];
+				child->SetName( std::string( (const char*)key.payload, size_t(key.length) ) );
+				data = child->ParseMsgpack( data, _end );
+			}
+			} break;
+		case MsgpackToken::ARRAY:
+			data = ParseMsgpackArray( data, _end, token.length );
+			break;
+		}
+		return data;
+	}
+
+	// ********************************************************************* //
+	const uint8_t* MetaFileWrapper::Node::ParseMsgpackArray( const uint8_t* _data, const uint8_t* _end, uint64_t _numElements )
+	{
+		// Empty arrays remain untyped like in JSON
+		if( _numElements == 0 ) return _data;
+
+		// Arrays of arrays or maps are NODEs with unnamed children
+		MsgpackToken token;
+		ReadToken( _data, _end, token );
+		if( token.kind == MsgpackToken::ARRAY || token.kind == MsgpackToken::MAP )
+		{
+			Resize( _numElements, ElementType::NODE );
+			for( uint64_t i=0; i<_numElements; ++i )
+				_data = ((Node**)m_bufferArray)[i]->ParseMsgpack( _data, _end );
+			return _data;
+		}
+
+		// First pass: find the type which holds all values
+		bool anyBool = false, anyString = false, anyInteger = false, anyFloat32 = false, anyFloat64 = false;
+		int64_t minValue = 0;
+		uint64_t maxValue = 0;
+		uint64_t numChars = 0;
+		const uint8_t* data = _data;
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			data = ReadToken( data, _end, token );
+			switch( token.kind )
+			{
+			case MsgpackToken::NIL: break;
+			case MsgpackToken::BOOL: anyBool = true; break;
+			case MsgpackToken::INT: anyInteger = true; minValue = std::min( minValue, token.i ); break;
+			case MsgpackToken::UINT: anyInteger = true; maxValue = std::max( maxValue, token.u ); break;
+			case MsgpackToken::FLOAT32: anyFloat32 = true; break;
+			case MsgpackToken::FLOAT64: anyFloat64 = true; break;
+			case MsgpackToken::STR: anyString = true; numChars += token.length; break;
+			default: throw std::string("[Node::ReadMsgpack] Arrays must have the same type everywhere!");
+			}
+		}
+		bool anyNumber = anyInteger || anyFloat32 || anyFloat64;
+		if( int(anyBool) + int(anyString) + int(anyNumber) > 1 )
+			throw std::string("[Node::ReadMsgpack] Arrays must have the same type everywhere!");
+		ElementType type;
+		if( anyString ) type = ElementType::STRING;
+		else if( anyBool ) type = ElementType::BIT;
+		else if( anyFloat64 || (anyFloat32 && anyInteger) ) type = ElementType::DOUBLE;
+		else if( anyFloat32 ) type = ElementType::FLOAT;
+		else if( anyInteger ) type = IntegerType( minValue, maxValue );
+		// Only nil
+		else return data;
+
+		// Second pass: store the values. Missing ones (nil) are 0.
+		Resize( _numElements, type );
+		if( type == ElementType::BIT ) memset( m_bufferArray, 0, size_t(ArraySize( _numElements, type )) );
+		if( type == ElementType::STRING )
+		{
+			m_strings = (char*)malloc( size_t(numChars ? numChars : 1) );
+			m_stringCapacity = numChars;
+		}
+		uint64_t stringEnd = 0;
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			_data = ReadToken( _data, _end, token );
+			double value = token.kind == MsgpackToken::FLOAT32 || token.kind == MsgpackToken::FLOAT64 ? token.d
+				: token.kind == MsgpackToken::INT ? double(token.i)
+				: token.kind == MsgpackToken::UINT ? double(token.u) : 0.0;
+			switch( type )
+			{
+			case ElementType::STRING:
+				if( token.kind == MsgpackToken::STR )
+				{
+					memcpy( m_strings + stringEnd, token.payload, size_t(token.length) );
+					stringEnd += token.length;
+				}
+				((uint64_t*)m_bufferArray)[i] = stringEnd;
+				break;
+			case ElementType::BIT:
+				if( token.kind == MsgpackToken::BOOL && token.b )
+					((uint8_t*)m_bufferArray)[i/8] |= uint8_t(1 << (i & 0x7));
+				break;
+			case ElementType::DOUBLE: ((double*)m_bufferArray)[i] = value; break;
+			case ElementType::FLOAT: ((float*)m_bufferArray)[i] = float(value); break;
+			// Negative values are INT, all others UINT
+			case ElementType::INT32: ((int32_t*)m_bufferArray)[i] = token.kind == MsgpackToken::INT ? int32_t(token.i) : token.kind == MsgpackToken::UINT ? int32_t(token.u) : 0; break;
+			case ElementType::INT64: ((int64_t*)m_bufferArray)[i] = token.kind == MsgpackToken::INT ? token.i : token.kind == MsgpackToken::UINT ? int64_t(token.u) : 0; break;
+			case ElementType::UINT64: ((uint64_t*)m_bufferArray)[i] = token.kind == MsgpackToken::UINT ? token.u : 0; break;
+			default: break;
+			}
+		}
+		return _data;
+	}
+
+} // namespace Files
+} // namespace Jo
@@ -0,0 +1,216 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Jo {
+namespace Files {
+
+	// The snapshot nodes point to the buffers of the document. When the
+	// document changes or deletes a shared buffer the old memory is moved
+	// into the share and freed after the save.
+	struct MetaFileWrapper::SnapshotShare
+	{
+		std::mutex mutex;
+		std::condition_variable releasedCondition;
+		bool released;
+		std::vector<void*> retired;
+
+		SnapshotShare() : released( false ) {}
+
+		/// \brief Free the retired buffers. The document owns all others
+		///		again.
+		void Release()
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			for( size_t i=0; i<retired.size(); ++i )
+				free( retired[i] );
+			retired.clear();
+			released = true;
+			releasedCondition.notify_all();
+		}
+
+		void WaitReleased()
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			while( !released ) releasedCondition.wait( lock );
+		}
+	};
+
+	// Forwards everything to the target file and counts the written bytes.
+	class ProgressFile: public IFile
+	{
+		IFile& m_target;
+		std::atomic<uint64_t>& m_written;
+
+		void Update() const		{ m_cursor = m_target.GetCursor(); }
+	public:
+		ProgressFile( IFile& _target, std::atomic<uint64_t>& _written ) :
+			IFile( _target.GetSize(), _target.CanRead(), _target.CanWrite() ),
+			m_target( _target ),
+			m_written( _written )
+		{
+			Update();
+		}
+
+		virtual void Read( uint64_t _numBytes, void* _to ) const override	{ m_target.Read( _numBytes, _to ); Update(); }
+		virtual uint8_t Next() const override		{ uint8_t value = m_target.Next(); Update(); return value; }
+		virtual void Seek( uint64_t _numBytes, SeekMode _mode ) const override	{ m_target.Seek( _numBytes, _mode ); Update(); }
+		virtual std::string Name() const override	{ return m_target.Name(); }
+
+		virtual void Write( const void* _from, uint64_t _numBytes ) override
+		{
+			m_target.Write( _from, _numBytes );
+			Update();
+			m_size = m_target.GetSize();
+			m_written.store( m_size, std::memory_order_relaxed );
+		}
+	};
+
+	// ********************************************************************* //
+	std::unique_ptr<BackgroundSave> MetaFileWrapper::SaveInBackground( IFile& _file, Format _format, WriteFlags _flags,
+		std::function<void(const std::string&)> _onComplete )
+	{
+		// The nodes can only remember one snapshot
+		if( m_share ) m_share->WaitReleased();
+		if( ++m_snapshotGeneration == 0 ) m_snapshotGeneration = 1;
+		m_share = std::make_shared<SnapshotShare>();
+
+		std::unique_ptr<BackgroundSave> save( new BackgroundSave );
+		save->m_share = m_share;
+		save->m_snapshot = new MetaFileWrapper;
+		RootNode.ShareInto( save->m_snapshot->RootNode, m_snapshotGeneration );
+
+		BackgroundSave* task = save.get();
+		IFile* file = &_file;
+		save->m_thread = std::thread( [task, file, _format, _flags, _onComplete]()
+		{
+			std::string error;
+			try {
+				const Node& root = task->m_snapshot->RootNode;
+				uint64_t headerSize = root.GetHeaderSize();
+				task->m_estimate.store( headerSize + root.GetDataSize( nullptr, _flags & ~COMPRESS, headerSize ), std::memory_order_relaxed );
+				ProgressFile progressFile( *file, task->m_written );
+				task->m_snapshot->Write( progressFile, _format, _flags );
+			} catch( const std::string& _message ) {
+				error = _message;
+			} catch( const char* _message ) {
+				error = _message;
+			} catch( ... ) {
+				error = "[MetaFileWrapper::SaveInBackground] Unknown error.";
+			}
+			// Stop reading before the buffers are freed
+			delete task->m_snapshot;
+			task->m_snapshot = nullptr;
+			task->m_share->Release();
+
+			task->m_error = error;
+			if( _onComplete ) _onComplete( task->m_error );
+			task->m_done.store( true, std::memory_order_release );
+		} );
+		return save;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::ShareInto( Node& _copy, uint32_t _generation )
+	{
+		_copy.m_name = _copy.m_file->InternName( *m_name );
+		if( m_type == ElementType::NODE )
+		{
+			_copy.Resize( m_numElements, ElementType::NODE );
+			for( uint64_t i=0; i<m_numElements; ++i )
+				Child( i )->ShareInto( *((Node**)_copy.m_bufferArray)[i], _generation );
+			return;
+		}
+
+		_copy.m_type = m_type;
+		_copy.m_numElements = m_numElements;
+		_copy.m_lastAccessed = m_lastAccessed;
+		if( m_type == ElementType::UNKNOWN ) return;
+
+		bool shared = false;
+		if( m_bufferArray == m_buffer )
+			memcpy( _copy.m_buffer, m_buffer, sizeof(m_buffer) );
+		else {
+			_copy.m_bufferArray = m_bufferArray;
+			shared = true;
+		}
+		if( m_strings )
+		{
+			_copy.m_strings = m_strings;
+			shared = true;
+		}
+		// The snapshot does not own the buffers
+		_copy.m_inPlace = shared;
+		if( shared ) m_shareGeneration = _generation;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::Unshare( bool _keepContent )
+	{
+		m_shareGeneration = 0;
+		SnapshotShare& share = *m_file->m_share;
+		std::lock_guard<std::mutex> lock( share.mutex );
+		// The save is done: the buffers belong to this node alone
+		if( share.released ) return;
+
+		// Memory of the source file is not owned by the node anyway
+		if( m_bufferArray != m_buffer && !m_inPlace )
+		{
+			share.retired.push_back( m_bufferArray );
+			if( _keepContent )
+			{
+				uint64_t size = ArraySize( m_numElements, m_type );
+				void* data = malloc( size_t(size) );
+				memcpy( data, share.retired.back(), size_t(size) );
+				m_bufferArray = data;
+			} else m_bufferArray = m_buffer;
+		}
+		if( m_strings )
+		{
+			share.retired.push_back( m_strings );
+			if( _keepContent )
+			{
+				m_strings = (char*)malloc( size_t(m_stringCapacity) );
+				memcpy( m_strings, share.retired.back(), size_t(m_stringCapacity) );
+			} else m_strings = nullptr;
+		}
+	}
+
+	// ********************************************************************* //
+	// BackgroundSave														 //
+	// ********************************************************************* //
+
+	BackgroundSave::BackgroundSave() :
+		m_snapshot( nullptr ),
+		m_written( 0 ),
+		m_estimate( 0 ),
+		m_done( false )
+	{
+	}
+
+	BackgroundSave::~BackgroundSave()
+	{
+		Wait();
+	}
+
+	float BackgroundSave::GetProgress() const
+	{
+		if( IsDone() ) return 1.0f;
+		uint64_t estimate = m_estimate.load( std::memory_order_relaxed );
+		if( estimate == 0 ) return 0.0f;
+		// The estimate can be too small
+		return std::min( 0.99f, float(m_written.load( std::memory_order_relaxed )) / float(estimate) );
+	}
+
+	void BackgroundSave::Wait()
+	{
+		if( m_thread.joinable() ) m_thread.join();
+	}
+
+} // namespace Files
+} // namespace Jo
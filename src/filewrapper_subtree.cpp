@@ -0,0 +1,187 @@
+#include "jofilelib.hpp"
+#include "filewrapper.hpp"
+#include <cstring>
+#include <string>
+
+namespace Jo {
+namespace Files {
+
+	// Subtrees move within a wrapper by moving the child pointer. Nodes
+	// cannot change their pool, so a move into another wrapper creates new
+	// nodes which take the arrays and strings of the old ones over.
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::CopyFrom( const Node& _source )
+	{
+		if( this == &_source ) return;
+		// Clearing would destroy the source or the copy would contain
+		// itself
+		for( const Node* node = m_parent; node; node = node->m_parent )
+			if( node == &_source ) throw std::string("[Node::CopyFrom] Source and target overlap.");
+		for( const Node* node = _source.m_parent; node; node = node->m_parent )
+			if( node == this ) throw std::string("[Node::CopyFrom] Source and target overlap.");
+
+		Clear();
+		CopySubtree( _source );
+	}
+
+	// ********************************************************************* //
+	MetaFileWrapper::Node& MetaFileWrapper::Node::Splice( Node& _child )
+	{
+		if( m_type != ElementType::NODE && m_type != ElementType::UNKNOWN )
+			throw "It is not possible to add a child node to '" + *m_name + "'. It has the wrong type.";
+		CheckWritable();
+		_child.Resolve();
+		Node* parent = _child.m_parent;
+		if( parent ) parent->CheckWritable();
+
+		if( _child.m_file == m_file )
+		{
+			// This also excludes the root which is an ancestor of all nodes
+			for( const Node* node = this; node; node = node->m_parent )
+				if( node == &_child ) throw std::string("[Node::Splice] A node cannot be moved into its own subtree.");
+			parent->RemoveChild( &_child );
+
+			// Replace the new slot by the subtree
+			Resize( m_numElements + 1, ElementType::NODE );
+			Node*& slot = ((Node**)m_bufferArray)[m_numElements - 1];
+			m_file->DeleteNode( slot );
+			slot = &_child;
+			_child.m_parent = this;
+			// The content and therefore the hash stay the same
+			_child.m_dirty |= DIRTY_SUBTREE;
+			return _child;
+		}
+
+		Node& adopted = Add( *_child.m_name, ElementType::UNKNOWN, 0 );
+		adopted.AdoptFrom( _child );
+		if( parent )
+		{
+			parent->RemoveChild( &_child );
+			_child.m_file->DeleteNode( &_child );
+		} else _child.Clear();
+		return adopted;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::Clear()
+	{
+		CheckWritable();
+		// The new node has no hash which would stop the invalidation
+		InvalidateHash();
+		MetaFileWrapper* wrapper = m_file;
+		Node* parent = m_parent;
+		NameId name = m_name;
+		this->~Node();
+		new (this) Node( wrapper, "" );
+		m_parent = parent;
+		m_name = name;
+		m_dirty = DIRTY_SUBTREE;
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::RemoveChild( const Node* _child )
+	{
+		CheckWritable();
+		ResolveChildren();
+		Node** children = (Node**)m_bufferArray;
+		uint64_t index = 0;
+		while( index < m_numElements && children[index] != _child ) ++index;
+		if( index == m_numElements ) throw std::string("[Node::RemoveChild] The node is no child of its parent.");
+
+		// The later children change their index -> a journal must record
+		// the whole node
+		MarkDirty( index + 1 == m_numElements ? DIRTY_CHILD_COUNT : DIRTY_SUBTREE );
+		memmove( children + index, children + index + 1, size_t(m_numElements - index - 1) * sizeof(Node*) );
+		--m_numElements;
+		m_lastAccessed = m_lastAccessed >= m_numElements ? 0 : m_lastAccessed;
+
+		// Return to the internal buffer like Resize()
+		uint64_t size = ArraySize( m_numElements, m_type );
+		if( m_bufferArray != m_buffer && size <= sizeof(m_buffer) )
+		{
+			memcpy( m_buffer, children, size_t(size) );
+			free( children );
+			m_bufferArray = m_buffer;
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::CopySubtree( const Node& _source )
+	{
+		if( _source.m_type == ElementType::NODE )
+		{
+			Resize( _source.m_numElements, ElementType::NODE );
+			for( uint64_t i=0; i<m_numElements; ++i )
+			{
+				const Node* sourceChild = _source.Child( i );
+				Node* child = ((Node**)m_bufferArray)[i];
+				child->m_name = m_file->InternName( *sourceChild->m_name );
+				child->CopySubtree( *sourceChild );
+			}
+		} else CopyData( _source );
+		m_hash.store( _source.m_hash.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::CopyData( const Node& _source )
+	{
+		m_type = _source.m_type;
+		m_numElements = _source.m_numElements;
+		if( m_type == ElementType::UNKNOWN ) return;
+
+		uint64_t size = ArraySize( m_numElements, m_type );
+		if( size > sizeof(m_buffer) ) m_bufferArray = malloc( size_t(size) );
+		memcpy( m_bufferArray, _source.m_bufferArray, size_t(size) );
+		if( m_type == ElementType::STRING )
+		{
+			// Only the used characters
+			uint64_t numChars = m_numElements ? ((const uint64_t*)m_bufferArray)[m_numElements-1] : 0;
+			m_strings = (char*)malloc( size_t(numChars ? numChars : 1) );
+			m_stringCapacity = numChars;
+			memcpy( m_strings, _source.m_strings, size_t(numChars) );
+		}
+	}
+
+	// ********************************************************************* //
+	void MetaFileWrapper::Node::AdoptFrom( Node& _source )
+	{
+		if( _source.m_type == ElementType::NODE )
+		{
+			Resize( _source.m_numElements, ElementType::NODE );
+			for( uint64_t i=0; i<m_numElements; ++i )
+			{
+				Node* sourceChild = _source.Child( i );
+				Node* child = ((Node**)m_bufferArray)[i];
+				child->m_name = m_file->InternName( *sourceChild->m_name );
+				child->AdoptFrom( *sourceChild );
+			}
+			m_hash.store( _source.m_hash.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+			return;
+		}
+
+		m_hash.store( _source.m_hash.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+		// Buffers which the old wrapper does not own alone are copied
+		if( _source.m_inPlace || _source.IsShared() || _source.m_readOnly )
+		{
+			CopyData( _source );
+			return;
+		}
+		m_type = _source.m_type;
+		m_numElements = _source.m_numElements;
+		if( _source.m_bufferArray == _source.m_buffer )
+			memcpy( m_buffer, _source.m_buffer, sizeof(m_buffer) );
+		else m_bufferArray = _source.m_bufferArray;
+		m_strings = _source.m_strings;
+		m_stringCapacity = _source.m_stringCapacity;
+
+		// The old node is destroyed without freeing anything
+		_source.m_bufferArray = _source.m_buffer;
+		_source.m_strings = nullptr;
+		_source.m_stringCapacity = 0;
+		_source.m_numElements = 0;
+		_source.m_type = ElementType::UNKNOWN;
+	}
+
+} // namespace Files
+} // namespace Jo
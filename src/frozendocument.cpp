@@ -0,0 +1,417 @@
+#include "jofilelib.hpp"
+#include "frozendocument.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace Jo {
+namespace Files {
+
+	// A tape starts with this header, followed by the entry of the root. The
+	// name table is stored behind the last entry: the end offset of each name
+	// and the characters of all names (sorted). All entries and payloads
+	// start at multiples of 8 bytes.
+	struct TapeHeader
+	{
+		uint8_t marker[2];			///< "ST"
+		uint8_t version;
+		uint8_t reserved;
+		uint32_t byteOrder;			///< TAPE_BYTE_ORDER in the order of the writer
+		uint32_t numNames;
+		uint32_t reserved2;
+		uint64_t nameTable;			///< Offset of the name table
+		uint64_t size;				///< Size of the whole tape
+	};
+	static const uint8_t TAPE_MARKER[2] = { 'S', 'T' };
+	static const uint8_t TAPE_VERSION = 1;
+	static const uint32_t TAPE_BYTE_ORDER = 0x01020304;
+
+	static uint64_t Pad8( uint64_t _size )		{ return (_size + 7) & ~uint64_t(7); }
+
+	const FrozenDocument::Entry FrozenDocument::UndefinedEntry[2] = {
+		{ uint8_t(ElementType::UNKNOWN), {0, 0, 0}, 0xffffffff, 0, sizeof(Entry) },
+		{ 0, {0, 0, 0}, 0, 0, 0 }
+	};
+
+	// ********************************************************************* //
+	std::unique_ptr<FrozenDocument> MetaFileWrapper::Freeze() const
+	{
+		return std::unique_ptr<FrozenDocument>( new FrozenDocument( *this ) );
+	}
+
+	// ********************************************************************* //
+	FrozenDocument::FrozenDocument( const MetaFileWrapper& _wrapper ) :
+		m_memory( nullptr )
+	{
+		NameIndex names;
+		uint64_t treeSize = Measure( _wrapper.RootNode, names );
+
+		// Ids in the order of the names allow a binary search
+		std::vector<const std::string*> sorted;
+		for( auto it = names.begin(); it != names.end(); ++it )
+			sorted.push_back( it->first );
+		std::sort( sorted.begin(), sorted.end(), []( const std::string* _a, const std::string* _b ) { return *_a < *_b; } );
+		uint64_t numCharacters = 0;
+		for( size_t i=0; i<sorted.size(); ++i )
+		{
+			names[sorted[i]] = uint32_t(i);
+			numCharacters += sorted[i]->length();
+		}
+
+		TapeHeader header;
+		memcpy( header.marker, TAPE_MARKER, 2 );
+		header.version = TAPE_VERSION;
+		header.reserved = 0;
+		header.byteOrder = TAPE_BYTE_ORDER;
+		header.numNames = uint32_t(sorted.size());
+		header.reserved2 = 0;
+		header.nameTable = sizeof(TapeHeader) + treeSize;
+		header.size = header.nameTable + sorted.size() * 8 + Pad8( numCharacters );
+
+		// Padding stays zero -> equal documents give equal tapes
+		uint8_t* tape = (uint8_t*)calloc( size_t(header.size), 1 );
+		if( !tape ) throw std::string("[FrozenDocument] Out of memory.");
+		m_memory = tape;
+		m_tape = tape;
+		memcpy( tape, &header, sizeof(TapeHeader) );
+		Flatten( _wrapper.RootNode, tape + sizeof(TapeHeader), names );
+
+		uint64_t* ends = (uint64_t*)(tape + header.nameTable);
+		char* characters = (char*)(ends + sorted.size());
+		uint64_t end = 0;
+		for( size_t i=0; i<sorted.size(); ++i )
+		{
+			memcpy( characters + end, sorted[i]->data(), sorted[i]->length() );
+			end += sorted[i]->length();
+			ends[i] = end;
+			m_names.push_back( *sorted[i] );
+		}
+		m_root = (const Entry*)(tape + sizeof(TapeHeader));
+	}
+
+	// ********************************************************************* //
+	FrozenDocument::FrozenDocument( const IFile& _file ) :
+		m_memory( nullptr )
+	{
+		uint64_t start = _file.GetCursor();
+		if( _file.GetSize() - start < sizeof(TapeHeader) ) throw std::string("[FrozenDocument] The file is no tape.");
+		TapeHeader header;
+		_file.Read( sizeof(TapeHeader), &header );
+		if( header.marker[0] != TAPE_MARKER[0] || header.marker[1] != TAPE_MARKER[1] )
+			throw std::string("[FrozenDocument] The file is no tape.");
+		if( header.version > TAPE_VERSION ) throw std::string("[FrozenDocument] Unsupported tape version.");
+		if( header.byteOrder != TAPE_BYTE_ORDER ) throw std::string("[FrozenDocument] The tape was written by a host with another byte order.");
+		if( header.size < sizeof(TapeHeader) + sizeof(Entry) || header.size > _file.GetSize() - start )
+			throw std::string("[FrozenDocument] The tape is truncated.");
+
+		// Use the file buffer if the entries are aligned there
+		const uint8_t* buffer = (const uint8_t*)_file.GetBuffer();
+		if( buffer && (uintptr_t(buffer + start) & 7) == 0 )
+		{
+			m_tape = buffer + start;
+			_file.Seek( start + header.size );
+		} else {
+			uint8_t* tape = (uint8_t*)malloc( size_t(header.size) );
+			if( !tape ) throw std::string("[FrozenDocument] Out of memory.");
+			m_memory = tape;
+			m_tape = tape;
+			memcpy( tape, &header, sizeof(TapeHeader) );
+			_file.Read( header.size - sizeof(TapeHeader), tape + sizeof(TapeHeader) );
+		}
+
+		try {
+			Open();
+		} catch(...) {
+			free( m_memory );
+			throw;
+		}
+	}
+
+	// ********************************************************************* //
+	FrozenDocument::~FrozenDocument()
+	{
+		free( m_memory );
+	}
+
+	// ********************************************************************* //
+	void FrozenDocument::Write( IFile& _file ) const
+	{
+		_file.Write( m_tape, GetSize() );
+	}
+
+	// ********************************************************************* //
+	uint64_t FrozenDocument::GetSize() const
+	{
+		return ((const TapeHeader*)m_tape)->size;
+	}
+
+	// ********************************************************************* //
+	uint64_t FrozenDocument::Measure( const MetaFileWrapper::Node& _node, NameIndex& _names )
+	{
+		_names.insert( std::make_pair( _node.m_name, 0 ) );
+		uint64_t size = sizeof(Entry);
+		switch( _node.m_type )
+		{
+		case ElementType::NODE:
+			size += _node.m_numElements * 8;
+			for( uint64_t i=0; i<_node.m_numElements; ++i )
+				size += Measure( *_node.Child( i ), _names );
+			break;
+		case ElementType::STRING:
+			size += _node.m_numElements * 8;
+			if( _node.m_numElements )
+				size += Pad8( ((const uint64_t*)_node.m_bufferArray)[_node.m_numElements-1] );
+			break;
+		case ElementType::UNKNOWN:
+			break;
+		default:
+			size += Pad8( MetaFileWrapper::ArraySize( _node.m_numElements, _node.m_type ) );
+		}
+		return size;
+	}
+
+	// ********************************************************************* //
+	uint8_t* FrozenDocument::Flatten( const MetaFileWrapper::Node& _node, uint8_t* _entry, const NameIndex& _names )
+	{
+		Entry* entry = (Entry*)_entry;
+		entry->type = uint8_t(_node.m_type);
+		entry->name = _names.find( _node.m_name )->second;
+		entry->numElements = _node.m_numElements;
+		uint8_t* payload = (uint8_t*)(entry + 1);
+		uint8_t* end = payload;
+
+		switch( _node.m_type )
+		{
+		case ElementType::NODE: {
+			uint64_t* offsets = (uint64_t*)payload;
+			end += _node.m_numElements * 8;
+			for( uint64_t i=0; i<_node.m_numElements; ++i )
+			{
+				offsets[i] = end - _entry;
+				end = Flatten( *_node.Child( i ), end, _names );
+			}
+			} break;
+		case ElementType::STRING:
+			if( _node.m_numElements )
+			{
+				const uint64_t* ends = (const uint64_t*)_node.m_bufferArray;
+				uint64_t numCharacters = ends[_node.m_numElements-1];
+				memcpy( end, ends, size_t(_node.m_numElements * 8) );
+				end += _node.m_numElements * 8;
+				memcpy( end, _node.m_strings, size_t(numCharacters) );
+				end += Pad8( numCharacters );
+			}
+			break;
+		case ElementType::UNKNOWN:
+			break;
+		default: {
+			uint64_t size = MetaFileWrapper::ArraySize( _node.m_numElements, _node.m_type );
+			memcpy( end, _node.m_bufferArray, size_t(size) );
+			end += Pad8( size );
+			}
+		}
+
+		entry->size = end - _entry;
+		return end;
+	}
+
+	// ********************************************************************* //
+	void FrozenDocument::Open()
+	{
+		const TapeHeader& header = *(const TapeHeader*)m_tape;
+		if( header.nameTable < sizeof(TapeHeader) + sizeof(Entry) || (header.nameTable & 7) != 0
+			|| header.nameTable > header.size || (header.size - header.nameTable) / 8 < header.numNames )
+			throw std::string("[FrozenDocument] Corrupted name table.");
+
+		const uint64_t* ends = (const uint64_t*)(m_tape + header.nameTable);
+		const char* characters = (const char*)(ends + header.numNames);
+		uint64_t available = header.size - header.nameTable - header.numNames * 8;
+		uint64_t begin = 0;
+		m_names.reserve( header.numNames );
+		for( uint32_t i=0; i<header.numNames; ++i )
+		{
+			if( ends[i] < begin || ends[i] > available ) throw std::string("[FrozenDocument] Corrupted name table.");
+			m_names.push_back( std::string( characters + begin, size_t(ends[i] - begin) ) );
+			begin = ends[i];
+		}
+
+		m_root = (const Entry*)(m_tape + sizeof(TapeHeader));
+		Validate( m_root, header.nameTable - sizeof(TapeHeader) );
+	}
+
+	// ********************************************************************* //
+	void FrozenDocument::Validate( const Entry* _entry, uint64_t _available ) const
+	{
+		static const std::string CORRUPTED("[FrozenDocument] Corrupted entry in the tape.");
+		if( _available < sizeof(Entry) || _entry->size < sizeof(Entry) || _entry->size > _available || (_entry->size & 7) != 0 )
+			throw CORRUPTED;
+		if( _entry->name >= m_names.size() ) throw CORRUPTED;
+		uint64_t payload = _entry->size - sizeof(Entry);
+		uint64_t numElements = _entry->numElements;
+
+		switch( ElementType(_entry->type) )
+		{
+		case ElementType::NODE: {
+			if( numElements > payload / 8 ) throw CORRUPTED;
+			const uint64_t* offsets = (const uint64_t*)(_entry + 1);
+			uint64_t next = sizeof(Entry) + numElements * 8;
+			// The children are stored in order and without gaps
+			for( uint64_t i=0; i<numElements; ++i )
+			{
+				if( offsets[i] != next ) throw CORRUPTED;
+				const Entry* child = (const Entry*)((const uint8_t*)_entry + next);
+				Validate( child, _entry->size - next );
+				next += child->size;
+			}
+			if( next != _entry->size ) throw CORRUPTED;
+			} break;
+		case ElementType::STRING: {
+			if( numElements > payload / 8 ) throw CORRUPTED;
+			const uint64_t* ends = (const uint64_t*)(_entry + 1);
+			uint64_t numCharacters = payload - numElements * 8;
+			for( uint64_t i=0; i<numElements; ++i )
+				if( (i > 0 && ends[i] < ends[i-1]) || ends[i] > numCharacters ) throw CORRUPTED;
+			} break;
+		case ElementType::UNKNOWN:
+			break;
+		case ElementType::BIT:
+		case ElementType::INT8: case ElementType::INT16: case ElementType::INT32: case ElementType::INT64:
+		case ElementType::UINT8: case ElementType::UINT16: case ElementType::UINT32: case ElementType::UINT64:
+		case ElementType::FLOAT: case ElementType::DOUBLE:
+			if( numElements > payload * 8 || MetaFileWrapper::ArraySize( numElements, ElementType(_entry->type) ) > payload ) throw CORRUPTED;
+			break;
+		default:
+			throw CORRUPTED;
+		}
+	}
+
+	// ********************************************************************* //
+	// FrozenDocument::Node													 //
+	// ********************************************************************* //
+
+	const std::string& FrozenDocument::Node::GetName() const
+	{
+		if( m_entry->name < m_document->m_names.size() )
+			return m_document->m_names[m_entry->name];
+		return MetaFileWrapper::EmptyName;
+	}
+
+	// ********************************************************************* //
+	MetaFileWrapper::StringView FrozenDocument::Node::GetStringView( uint64_t _index ) const
+	{
+		if( GetType() != ElementType::STRING ) throw "Node '" + GetName() + "' is no string node.";
+		if( _index >= Size() ) throw "Out of bounds in node '" + GetName() + "'";
+		const uint64_t* ends = (const uint64_t*)Payload();
+		uint64_t begin = _index ? ends[_index-1] : 0;
+		MetaFileWrapper::StringView view = { (const char*)(ends + Size()) + begin, ends[_index] - begin };
+		return view;
+	}
+
+	// ********************************************************************* //
+	FrozenDocument::Node FrozenDocument::Node::operator[]( const std::string& _name ) const
+	{
+		Node child( m_document, UndefinedEntry );
+		HasChild( _name, &child );
+		return child;
+	}
+
+	// ********************************************************************* //
+	FrozenDocument::Node FrozenDocument::Node::operator[]( uint64_t _index ) const
+	{
+		if( _index >= Size() ) throw "Out of bounds in node '" + GetName() + "'";
+		if( GetType() == ElementType::NODE )
+		{
+			uint64_t offset = ((const uint64_t*)Payload())[_index];
+			return Node( m_document, (const Entry*)((const uint8_t*)m_entry + offset) );
+		}
+		return Node( m_document, m_entry, _index );
+	}
+
+	// ********************************************************************* //
+	bool FrozenDocument::Node::HasChild( const std::string& _name, Node* _child ) const
+	{
+		if( GetType() == ElementType::UNKNOWN ) return false;
+		if( GetType() != ElementType::NODE ) throw "Node '" + GetName() + "' is of an elementary type and has no named children.";
+
+		// A name which is not in the table cannot be the name of a child.
+		const std::vector<std::string>& names = m_document->m_names;
+		auto name = std::lower_bound( names.begin(), names.end(), _name );
+		if( name == names.end() || *name != _name ) return false;
+		uint32_t id = uint32_t(name - names.begin());
+
+		const uint64_t* offsets = (const uint64_t*)Payload();
+		for( uint64_t i=0; i<Size(); ++i )
+		{
+			const Entry* child = (const Entry*)((const uint8_t*)m_entry + offsets[i]);
+			if( child->name == id )
+			{
+				if( _child ) *_child = Node( m_document, child );
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// ********************************************************************* //
+	const void* FrozenDocument::Node::GetData() const
+	{
+		if( GetType() == ElementType::NODE ) throw "Cannot access data from intermediate node '" + GetName() + "'";
+		if( GetType() == ElementType::STRING ) throw "Cannot access data from string node '" + GetName() + "'";
+		return Payload();
+	}
+
+	void FrozenDocument::Node::CheckSpanType( ElementType _type ) const
+	{
+		if( GetType() != _type ) throw "Node '" + GetName() + "' does not contain the requested element type.";
+	}
+
+	void FrozenDocument::Node::CopyTo( void* _dst, ElementType _dstType, uint64_t _first, uint64_t _count ) const
+	{
+		if( _first + _count > Size() || _first + _count < _first ) throw "Out of bounds in node '" + GetName() + "'";
+		if( !IsInt() && !IsUnsignedInt() && !IsFloat() ) throw "Node '" + GetName() + "' does not contain numeric data.";
+
+		const uint8_t* first = (const uint8_t*)Payload() + _first * (MetaFileWrapper::ELEMENT_TYPE_SIZE[(int)GetType()] / 8);
+		MetaFileWrapper::ConvertElements( first, GetType(), _dst, _dstType, _count );
+	}
+
+	// ********************************************************************* //
+	// Floating point values convert into each other, integers into integers
+	// of at least the same size.
+	template<typename T> static T ConvertElement( FrozenDocument::ElementType _type, const void* _data, uint64_t _index, T _default )
+	{
+		typedef FrozenDocument::ElementType ElementType;
+		if( std::is_floating_point<T>::value )
+		{
+			if( _type == ElementType::FLOAT ) return T(((const float*)_data)[_index]);
+			if( _type == ElementType::DOUBLE ) return T(((const double*)_data)[_index]);
+			return _default;
+		}
+		if( _type < ElementType::INT8 || _type > ElementType::UINT64
+			|| MetaFileWrapper::ELEMENT_TYPE_SIZE[(int)_type] > int64_t(sizeof(T) * 8) )
+			return _default;
+		switch( _type )
+		{
+		case ElementType::INT8: return T(((const int8_t*)_data)[_index]);
+		case ElementType::INT16: return T(((const int16_t*)_data)[_index]);
+		case ElementType::INT32: return T(((const int32_t*)_data)[_index]);
+		case ElementType::INT64: return T(((const int64_t*)_data)[_index]);
+		case ElementType::UINT8: return T(((const uint8_t*)_data)[_index]);
+		case ElementType::UINT16: return T(((const uint16_t*)_data)[_index]);
+		case ElementType::UINT32: return T(((const uint32_t*)_data)[_index]);
+		default: return T(((const uint64_t*)_data)[_index]);
+		}
+	}
+
+	float FrozenDocument::Node::GetAt( uint64_t _index, float _default ) const			{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	double FrozenDocument::Node::GetAt( uint64_t _index, double _default ) const		{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	int8_t FrozenDocument::Node::GetAt( uint64_t _index, int8_t _default ) const		{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	uint8_t FrozenDocument::Node::GetAt( uint64_t _index, uint8_t _default ) const		{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	int16_t FrozenDocument::Node::GetAt( uint64_t _index, int16_t _default ) const		{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	uint16_t FrozenDocument::Node::GetAt( uint64_t _index, uint16_t _default ) const	{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	int32_t FrozenDocument::Node::GetAt( uint64_t _index, int32_t _default ) const		{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	uint32_t FrozenDocument::Node::GetAt( uint64_t _index, uint32_t _default ) const	{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	int64_t FrozenDocument::Node::GetAt( uint64_t _index, int64_t _default ) const		{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+	uint64_t FrozenDocument::Node::GetAt( uint64_t _index, uint64_t _default ) const	{ return ConvertElement( GetType(), Payload(), _index, _default ); }
+
+} // namespace Files
+} // namespace Jo
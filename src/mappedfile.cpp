@@ -0,0 +1,93 @@
+#include "mappedfile.hpp"
+#include "platform.hpp"
+
+#ifdef JO_WINDOWS
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace Jo {
+namespace Files {
+
+	MappedFile::MappedFile( const std::string& _name, ModeFlags _flags ) :
+		MemFile( nullptr, 0 ),
+		m_name( _name )
+	{
+		m_writeAccess = (_flags & WRITE) != 0;
+		uint64_t size = 0;
+		void* memory = nullptr;
+#ifdef JO_WINDOWS
+		HANDLE file = CreateFileA( _name.c_str(), GENERIC_READ | (m_writeAccess ? GENERIC_WRITE : 0),
+			FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if( file == INVALID_HANDLE_VALUE ) throw "Failed to open file '" + _name + "'";
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx( file, &fileSize );
+		size = fileSize.QuadPart;
+		// Empty files cannot be mapped
+		if( size )
+		{
+			// The view keeps the mapping alive after the handles are closed
+			HANDLE mapping = CreateFileMappingA( file, nullptr, m_writeAccess ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr );
+			if( mapping )
+			{
+				memory = MapViewOfFile( mapping, m_writeAccess ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0 );
+				CloseHandle( mapping );
+			}
+		}
+		CloseHandle( file );
+#else
+		int file = open( _name.c_str(), m_writeAccess ? O_RDWR : O_RDONLY );
+		if( file == -1 ) throw "Failed to open file '" + _name + "'";
+		struct stat status;
+		fstat( file, &status );
+		size = status.st_size;
+		if( size )
+		{
+			memory = mmap( nullptr, size_t(size), PROT_READ | (m_writeAccess ? PROT_WRITE : 0), MAP_SHARED, file, 0 );
+			if( memory == MAP_FAILED ) memory = nullptr;
+		}
+		close( file );
+#endif
+		if( size && !memory ) throw "Failed to map file '" + _name + "'";
+
+		m_buffer = memory;
+		m_size = size;
+		m_capacity = size;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if( m_buffer )
+		{
+#ifdef JO_WINDOWS
+			UnmapViewOfFile( m_buffer );
+#else
+			munmap( m_buffer, size_t(m_capacity) );
+#endif
+		}
+		// The MemFile does not own the memory
+		m_buffer = nullptr;
+	}
+
+	void MappedFile::Write( const void* _from, uint64_t _numBytes )
+	{
+		if( m_cursor + _numBytes > m_capacity ) throw "Cannot write behind the end of the mapped file '" + m_name + "'";
+		MemFile::Write( _from, _numBytes );
+	}
+
+	void MappedFile::Flush()
+	{
+		if( !m_buffer || !m_writeAccess ) return;
+#ifdef JO_WINDOWS
+		FlushViewOfFile( m_buffer, 0 );
+#else
+		msync( m_buffer, size_t(m_capacity), MS_SYNC );
+#endif
+	}
+
+} // namespace Files
+} // namespace Jo
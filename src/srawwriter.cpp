@@ -0,0 +1,233 @@
+#include "jofilelib.hpp"
+#include "srawwriter.hpp"
+#include "platform.hpp"
+
+namespace Jo {
+namespace Files {
+
+	// NELEMS of all blocks are stored with 8 bytes (code 0x30) such that
+	// they can be patched without moving data.
+	static const uint8_t NELEM_SIZE_CODE = 0x30;
+
+	// ********************************************************************* //
+	SrawWriter::SrawWriter( IFile& _file, MetaFileWrapper::WriteFlags _flags ) :
+		m_file( _file ),
+		m_flags( _flags )
+	{
+		if( _flags & MetaFileWrapper::CHILD_DIRECTORY ) throw std::string("[SrawWriter] Child directories are not supported by the streaming writer.");
+		if( _flags & MetaFileWrapper::VARINT_SIZES ) throw std::string("[SrawWriter] Variable length sizes are not supported by the streaming writer.");
+		if( _flags & MetaFileWrapper::DEDUPLICATE ) throw std::string("[SrawWriter] Deduplication is not supported by the streaming writer.");
+
+		m_flags &= ~MetaFileWrapper::BIG_ENDIAN_FILE;
+		if( !IsLittleEndian() ) m_flags |= MetaFileWrapper::BIG_ENDIAN_FILE;
+		MetaFileWrapper::WriteFlags fileFlags = m_flags & ~(MetaFileWrapper::NARROW_INTEGERS | MetaFileWrapper::PACKED_ARRAYS);
+		if( fileFlags )
+		{
+			uint8_t preamble[3] = { MetaFileWrapper::SRAW_V2_MARKER, MetaFileWrapper::SRAW_VERSION, uint8_t(fileFlags) };
+			m_file.Write( preamble, 3 );
+		}
+
+		OpenNode( "Root" );
+	}
+
+	// ********************************************************************* //
+	SrawWriter::~SrawWriter()
+	{
+		// Leave a valid file behind
+		try {
+			while( !m_open.empty() )
+			{
+				PatchHeader( m_open.back() );
+				m_open.pop_back();
+			}
+		} catch(...) {}
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::BeginNode( const std::string& _name )
+	{
+		CheckNodeOpen();
+		OpenNode( _name );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::EndNode()
+	{
+		CheckNodeOpen();
+		if( m_open.size() == 1 ) throw std::string("[SrawWriter::EndNode] The root node is closed by Finish().");
+		PatchHeader( m_open.back() );
+		m_open.pop_back();
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::WriteArray( const std::string& _name, ElementType _type, const void* _data, uint64_t _numElements )
+	{
+		// Complete arrays can be narrowed and compressed like in
+		// MetaFileWrapper::Write
+		std::vector<uint8_t> narrowed;
+		if( (m_flags & MetaFileWrapper::NARROW_INTEGERS) && _type >= ElementType::INT8 && _type <= ElementType::UINT64 )
+		{
+			ElementType narrowType = MetaFileWrapper::NarrowestType( _type, _data, _numElements );
+			if( narrowType != _type )
+			{
+				narrowed.resize( size_t(MetaFileWrapper::ArraySize( _numElements, narrowType )) );
+				MetaFileWrapper::ConvertElements( _data, _type, narrowed.data(), narrowType, _numElements );
+				_data = narrowed.data();
+				_type = narrowType;
+			}
+		}
+
+		if( (m_flags & MetaFileWrapper::COMPRESS) && _type > ElementType::STRING && _type != ElementType::UNKNOWN
+			&& MetaFileWrapper::ArraySize( _numElements, _type ) >= MetaFileWrapper::COMPRESSION_THRESHOLD )
+		{
+			CheckNodeOpen();
+			std::vector<uint8_t> encoded;
+			uint8_t codec = MetaFileWrapper::EncodeArray( _type, _data, _numElements, encoded );
+			if( codec )
+			{
+				WriteHeader( _name, _type, _numElements, MetaFileWrapper::SRAW_COMPRESSED );
+				m_file.Write( &codec, 1 );
+				uint64_t dataSize = encoded.size();
+				m_file.Write( &dataSize, 8 );
+				m_file.Write( encoded.data(), dataSize );
+				return;
+			}
+		}
+
+		BeginArray( _name, _type );
+		AppendArray( _data, _numElements );
+		EndArray();
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::WriteString( const std::string& _name, const std::string& _value )
+	{
+		WriteStrings( _name, &_value, 1 );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::WriteStrings( const std::string& _name, const std::string* _values, uint64_t _numElements )
+	{
+		CheckNodeOpen();
+		// Always use 8 byte length prefixes (STRING64)
+		WriteHeader( _name, ElementType((int)ElementType::STRING + 3), _numElements );
+		uint64_t dataSize = 8 * _numElements;
+		for( uint64_t i=0; i<_numElements; ++i )
+			dataSize += _values[i].length();
+		m_file.Write( &dataSize, 8 );
+		for( uint64_t i=0; i<_numElements; ++i )
+		{
+			uint64_t length = _values[i].length();
+			m_file.Write( &length, 8 );
+			m_file.Write( _values[i].data(), length );
+		}
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::BeginArray( const std::string& _name, ElementType _type )
+	{
+		CheckNodeOpen();
+		if( _type <= ElementType::STRING || _type == ElementType::UNKNOWN ) throw std::string("[SrawWriter::BeginArray] Only numeric and BIT arrays can be streamed.");
+		WriteHeader( _name, _type, 0 );
+		uint64_t numElementsPosition = m_file.GetCursor() - 8;
+		// The final size is unknown -> always align
+		WritePadding( ~0ull );
+
+		OpenBlock block = { _type, numElementsPosition, m_file.GetCursor(), 0 };
+		m_open.push_back( block );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::AppendArray( const void* _data, uint64_t _numElements )
+	{
+		if( m_open.empty() || m_open.back().type == ElementType::NODE ) throw std::string("[SrawWriter::AppendArray] No array is open.");
+		OpenBlock& block = m_open.back();
+		if( block.type == ElementType::BIT && (block.numElements % 8) != 0 ) throw std::string("[SrawWriter::AppendArray] Only the last chunk of a BIT array can have an incomplete byte.");
+
+		m_file.Write( _data, MetaFileWrapper::ArraySize( _numElements, block.type ) );
+		block.numElements += _numElements;
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::EndArray()
+	{
+		if( m_open.empty() || m_open.back().type == ElementType::NODE ) throw std::string("[SrawWriter::EndArray] No array is open.");
+		PatchHeader( m_open.back() );
+		m_open.pop_back();
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::Finish()
+	{
+		if( m_open.size() != 1 ) throw std::string("[SrawWriter::Finish] All nodes and arrays must be closed before.");
+		PatchHeader( m_open.back() );
+		m_open.pop_back();
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::OpenNode( const std::string& _name )
+	{
+		WriteHeader( _name, ElementType::NODE, 0 );
+		// [SIZE] placeholder
+		uint64_t dataSize = 0;
+		m_file.Write( &dataSize, 8 );
+
+		OpenBlock block = { ElementType::NODE, m_file.GetCursor() - 16, m_file.GetCursor(), 0 };
+		m_open.push_back( block );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::WriteHeader( const std::string& _name, ElementType _type, uint64_t _numElements, uint8_t _codeFlags )
+	{
+		if( _name.length() > 255 ) throw "[SrawWriter] The name '" + _name + "' is too long.";
+		// Count the new child (the root has no parent)
+		if( !m_open.empty() ) ++m_open.back().numElements;
+
+		// TYPE
+		uint8_t code = NELEM_SIZE_CODE | uint8_t(_type) | _codeFlags;
+		m_file.Write( &code, 1 );
+
+		// IDENTIFIER
+		uint8_t length = uint8_t(_name.length());
+		m_file.Write( &length, 1 );
+		m_file.Write( _name.data(), length );
+
+		// NELEMS
+		m_file.Write( &_numElements, 8 );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::WritePadding( uint64_t _payloadSize )
+	{
+		if( !(m_flags & (MetaFileWrapper::ALIGN_16 | MetaFileWrapper::ALIGN_64)) ) return;
+
+		static const uint8_t ZEROS[64] = {0};
+		uint8_t padding = MetaFileWrapper::PaddingSize( m_flags, m_file.GetCursor(), _payloadSize );
+		m_file.Write( &padding, 1 );
+		m_file.Write( ZEROS, padding );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::PatchHeader( const OpenBlock& _block )
+	{
+		uint64_t end = m_file.GetCursor();
+		m_file.Seek( _block.numElementsPosition );
+		m_file.Write( &_block.numElements, 8 );
+		if( _block.type == ElementType::NODE )
+		{
+			uint64_t dataSize = end - _block.dataPosition;
+			m_file.Write( &dataSize, 8 );
+		}
+		m_file.Seek( end );
+	}
+
+	// ********************************************************************* //
+	void SrawWriter::CheckNodeOpen() const
+	{
+		if( m_open.empty() ) throw std::string("[SrawWriter] The file is already finished.");
+		if( m_open.back().type != ElementType::NODE )
+			throw std::string("[SrawWriter] An array is open. Close it with EndArray() first.");
+	}
+
+} // namespace Files
+} // namespace Jo